@@ -0,0 +1,169 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+// Minimal headless benchmark harness; results are written as JSON so runs of
+// different versions can be compared by a script.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+/// Keeps the compiler from optimizing away a computed value.
+template<class T> inline void DoNotOptimize(T const& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct Result
+{
+    std::string name;
+    size_t      iterations = 0;
+    double      ns_per_op = 0.0;
+    std::vector<std::pair<std::string, double>> counters; // Extra per-op metrics, e.g. refcount operations.
+};
+
+/// Runs benchmark cases and collects their results.
+///
+/// Command line: [--json <file>] [--filter <substring>] [--min-time <seconds>] [--repetitions <n>]
+/// Without `--json` the report is written to stdout.
+class Runner
+{
+public:
+    Runner(const char* suite, int argc, char** argv)
+        : m_suite(suite)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const bool has_value = (i + 1 < argc);
+            if (!strcmp(argv[i], "--json") && has_value)             { m_json_path = argv[++i]; }
+            else if (!strcmp(argv[i], "--filter") && has_value)      { m_filter = argv[++i]; }
+            else if (!strcmp(argv[i], "--min-time") && has_value)    { m_min_time = atof(argv[++i]); }
+            else if (!strcmp(argv[i], "--repetitions") && has_value) { m_repetitions = atoi(argv[++i]); }
+            else { fprintf(stderr, "%s: unknown argument '%s'\n", m_suite, argv[i]); }
+        }
+    }
+
+    /// `body(n)` must perform the measured operation `n` times.
+    /// Iteration count is calibrated to `--min-time`, the best of `--repetitions` runs is reported.
+    template<class F> bool Run(const char* name, F&& body)
+    {
+        if (!IsSelected(name))
+            return false;
+
+        size_t n = 1;
+        for (;;)
+        {
+            const double secs = Measure(body, n);
+            if (secs >= m_min_time || n >= (size_t(1) << 40))
+                break;
+            // Aim slightly past the target to avoid another round
+            const double scale = (secs > 0.0) ? (m_min_time * 1.2 / secs) : 100.0;
+            n = size_t(double(n) * std::min(std::max(scale, 2.0), 100.0));
+        }
+
+        double best = Measure(body, n);
+        for (int r = 1; r < m_repetitions; r++)
+            best = std::min(best, Measure(body, n));
+
+        Result res;
+        res.name = name;
+        res.iterations = n;
+        res.ns_per_op = best * 1e9 / double(n);
+        m_results.push_back(res);
+        fprintf(stderr, "%-48s %12.2f ns/op  (%zu iterations)\n", name, res.ns_per_op, n);
+        return true;
+    }
+
+    /// Whether the case passes `--filter`, for cases that need setup before Run().
+    bool IsSelected(const char* name) const
+    {
+        return m_filter.empty() || std::string(name).find(m_filter) != std::string::npos;
+    }
+
+    /// ns/op of the case that ran last, e.g. to derive a throughput counter.
+    double LastNsPerOp() const
+    {
+        return m_results.empty() ? 0.0 : m_results.back().ns_per_op;
+    }
+
+    /// Attaches an extra metric to the case that ran last.
+    void AddCounter(const char* name, double value)
+    {
+        if (!m_results.empty())
+            m_results.back().counters.push_back(std::make_pair(std::string(name), value));
+    }
+
+    /// Writes the report; returns the process exit code.
+    int Finish()
+    {
+        FILE* f = m_json_path.empty() ? stdout : fopen(m_json_path.c_str(), "w");
+        if (!f)
+        {
+            fprintf(stderr, "%s: cannot open '%s' for writing\n", m_suite, m_json_path.c_str());
+            return 1;
+        }
+
+        fprintf(f, "{\n  \"suite\": \"%s\",\n  \"compiler\": \"%s\",\n  \"results\": [", m_suite, CompilerName());
+        for (size_t i = 0; i < m_results.size(); i++)
+        {
+            const Result& res = m_results[i];
+            fprintf(f, "%s\n    {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.3f",
+                (i > 0) ? "," : "", res.name.c_str(), res.iterations, res.ns_per_op);
+            for (const auto& counter : res.counters)
+                fprintf(f, ", \"%s\": %.3f", counter.first.c_str(), counter.second);
+            fprintf(f, "}");
+        }
+        fprintf(f, "\n  ]\n}\n");
+
+        if (f != stdout)
+            fclose(f);
+        return 0;
+    }
+
+private:
+    template<class F> static double Measure(F& body, size_t n)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        body(n);
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    static const char* CompilerName()
+    {
+#if defined(__clang__)
+        return "clang " __clang_version__;
+#elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        return "msvc";
+#else
+        return "unknown";
+#endif
+    }
+
+    const char*         m_suite;
+    std::string         m_json_path;
+    std::string         m_filter;
+    double              m_min_time = 0.2;
+    int                 m_repetitions = 5;
+    std::vector<Result> m_results;
+};
+
+} // namespace bench
@@ -0,0 +1,339 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+// Cost of passing RefCountingObject instances across the script/C++ boundary,
+// one case per handle passing style used in Example.as. Every case reports
+// nanoseconds per call (script loop included, see `empty_call` for the
+// baseline) and AddRef()/Release() calls per call.
+//
+// The `nocount` and `scoped` cases do the same with objects registered by
+// NoCountObject and ScopedObject, which the engine never refcounts; compare
+// them with the `native_handle` cases for the overhead saved.
+
+#include "bench.h"
+
+#include "../RefCountingObject.h"
+#include "../RefCountingObjectPtr.h"
+
+#include <angelscript.h>
+#include <cstring>
+
+// -------------------------- Test subjects ----------------------------
+
+static size_t g_addref_count = 0;
+static size_t g_release_count = 0;
+
+/// Horse which counts its refcount operations. The counting methods hide the
+/// inherited ones, so both the script engine and RefCountingObjectPtr use them.
+class BenchHorse: public RefCountingObject<BenchHorse>
+{
+public:
+    void AddRef()
+    {
+        g_addref_count++;
+        RefCountingObject<BenchHorse>::AddRef();
+    }
+
+    void Release()
+    {
+        g_release_count++;
+        RefCountingObject<BenchHorse>::Release();
+    }
+};
+
+typedef RefCountingObjectPtr<BenchHorse> BenchHorsePtr;
+
+static BenchHorsePtr g_stable;
+
+BenchHorse* HorseFactory() { return new BenchHorse(); }
+
+void Noop() {}
+
+// `Horse@` parameter: the engine passes in a reference we must release.
+void TakeNative(BenchHorse* horse)
+{
+    bench::DoNotOptimize(horse);
+    if (horse)
+        horse->Release();
+}
+
+// `HorsePtr@` parameter, as `PutToStable()` in Example.cpp.
+void TakeCustomized(BenchHorsePtr horse)
+{
+    bench::DoNotOptimize(horse);
+}
+
+// `HorsePtr@` return, as `FetchFromStable()` in Example.cpp.
+BenchHorsePtr FetchFromStable()
+{
+    return g_stable;
+}
+
+// `Horse@` return: the reference handed to the script must be added by us.
+BenchHorse* FetchNative()
+{
+    BenchHorse* horse = g_stable.GetRef();
+    if (horse)
+        horse->AddRef();
+    return horse;
+}
+
+/// App-owned singleton, as the stable itself would be.
+class BenchStable: public NoCountObject<BenchStable>
+{
+};
+
+static BenchStable g_stable_singleton;
+
+// `Stable@` return: nothing to add.
+BenchStable* FetchNoCount()
+{
+    return &g_stable_singleton;
+}
+
+// `Stable@` parameter: nothing to release.
+void TakeNoCount(BenchStable* stable)
+{
+    bench::DoNotOptimize(stable);
+}
+
+/// Helper living in a single script scope.
+class BenchSaddle: public ScopedObject<BenchSaddle>
+{
+};
+
+BenchSaddle* SaddleFactory() { return new BenchSaddle(); }
+
+// `Saddle &` parameter
+void TakeScoped(BenchSaddle& saddle)
+{
+    bench::DoNotOptimize(&saddle);
+}
+
+// ---------------------------- Script ---------------------------------
+
+static const char* BENCH_SCRIPT = R"(
+void Bench_EmptyCall(uint n)
+{
+    for (uint i = 0; i < n; i++) Noop();
+}
+
+void Bench_NativeHandleParam(uint n)
+{
+    Horse@ ho = Horse();
+    for (uint i = 0; i < n; i++) TakeNative(ho);
+}
+
+void Bench_CustomizedHandleParam(uint n)
+{
+    HorsePtr@ ho = Horse();
+    for (uint i = 0; i < n; i++) TakeCustomized(ho);
+}
+
+void Bench_ImplicitConversionParam(uint n)
+{
+    Horse@ ho = Horse(); // As `PutToStable(ho)` in AppInterfaceNativePtrTest()
+    for (uint i = 0; i < n; i++) TakeCustomized(ho);
+}
+
+void Bench_ExplicitConstructParam(uint n)
+{
+    Horse@ ho = Horse(); // As `PutToStable(HorsePtr(Horse()))`, minus the creation
+    for (uint i = 0; i < n; i++) TakeCustomized(HorsePtr(ho));
+}
+
+void Bench_ReturnCustomized(uint n)
+{
+    HorsePtr@ ho;
+    for (uint i = 0; i < n; i++) @ho = FetchFromStable();
+}
+
+void Bench_ReturnCustomizedToNative(uint n)
+{
+    Horse@ ho; // Goes through opImplCast()
+    for (uint i = 0; i < n; i++) @ho = FetchFromStable();
+}
+
+void Bench_ReturnNative(uint n)
+{
+    Horse@ ho;
+    for (uint i = 0; i < n; i++) @ho = FetchNative();
+}
+
+void Bench_NativeHandleAssign(uint n)
+{
+    Horse@ ref1 = Horse();
+    Horse@ ref2;
+    for (uint i = 0; i < n; i++) { @ref2 = ref1; @ref2 = null; }
+}
+
+void Bench_CustomizedHandleAssign(uint n)
+{
+    HorsePtr@ ref1 = Horse();
+    HorsePtr@ ref2;
+    for (uint i = 0; i < n; i++) { @ref2 = ref1; @ref2 = null; }
+}
+
+void Bench_CreateNative(uint n)
+{
+    for (uint i = 0; i < n; i++) { Horse@ ho = Horse(); }
+}
+
+void Bench_CreateCustomized(uint n)
+{
+    for (uint i = 0; i < n; i++) { HorsePtr@ ho = Horse(); }
+}
+
+void Bench_NoCountParam(uint n)
+{
+    Stable@ st = FetchNoCount();
+    for (uint i = 0; i < n; i++) TakeNoCount(st);
+}
+
+void Bench_ReturnNoCount(uint n)
+{
+    Stable@ st;
+    for (uint i = 0; i < n; i++) @st = FetchNoCount();
+}
+
+void Bench_NoCountAssign(uint n)
+{
+    Stable@ ref1 = FetchNoCount();
+    Stable@ ref2;
+    for (uint i = 0; i < n; i++) { @ref2 = ref1; @ref2 = null; }
+}
+
+void Bench_ScopedParam(uint n)
+{
+    Saddle sa;
+    for (uint i = 0; i < n; i++) TakeScoped(sa);
+}
+
+void Bench_CreateScoped(uint n)
+{
+    for (uint i = 0; i < n; i++) { Saddle sa; }
+}
+)";
+
+struct Scenario
+{
+    const char* name;
+    const char* func_decl;
+};
+
+static const Scenario SCENARIOS[] =
+{
+    { "empty_call",                        "void Bench_EmptyCall(uint)" },
+    { "param/native_handle",               "void Bench_NativeHandleParam(uint)" },
+    { "param/customized_handle",           "void Bench_CustomizedHandleParam(uint)" },
+    { "param/implicit_conversion",         "void Bench_ImplicitConversionParam(uint)" },
+    { "param/explicit_construct",          "void Bench_ExplicitConstructParam(uint)" },
+    { "return/customized_handle",          "void Bench_ReturnCustomized(uint)" },
+    { "return/customized_to_native",       "void Bench_ReturnCustomizedToNative(uint)" },
+    { "return/native_handle",              "void Bench_ReturnNative(uint)" },
+    { "script_assign/native_handle",       "void Bench_NativeHandleAssign(uint)" },
+    { "script_assign/customized_handle",   "void Bench_CustomizedHandleAssign(uint)" },
+    { "create/native_handle",              "void Bench_CreateNative(uint)" },
+    { "create/customized_handle",          "void Bench_CreateCustomized(uint)" },
+    { "param/nocount",                     "void Bench_NoCountParam(uint)" },
+    { "return/nocount",                    "void Bench_ReturnNoCount(uint)" },
+    { "script_assign/nocount",             "void Bench_NoCountAssign(uint)" },
+    { "param/scoped",                      "void Bench_ScopedParam(uint)" },
+    { "create/scoped",                     "void Bench_CreateScoped(uint)" },
+};
+
+// ---------------------------- Engine ---------------------------------
+
+static void MessageCallback(const asSMessageInfo* msg, void* /*param*/)
+{
+    const char* type = "ERR ";
+    if (msg->type == asMSGTYPE_WARNING)
+        type = "WARN";
+    else if (msg->type == asMSGTYPE_INFORMATION)
+        type = "INFO";
+
+    fprintf(stderr, "%s (%d, %d) : %s : %s\n", msg->section, msg->row, msg->col, type, msg->message);
+}
+
+static void ConfigureEngine(asIScriptEngine* engine)
+{
+    int r;
+
+    BenchHorse::RegisterRefCountingObject("Horse", engine);
+    r = engine->RegisterObjectBehaviour("Horse", asBEHAVE_FACTORY, "Horse@ f()", asFUNCTION(HorseFactory), asCALL_CDECL); assert( r >= 0 );
+    BenchHorsePtr::RegisterRefCountingObjectPtr("HorsePtr", "Horse", engine);
+
+    BenchStable::RegisterNoCountObject("Stable", engine);
+    BenchSaddle::RegisterScopedObject("Saddle", engine);
+    r = engine->RegisterObjectBehaviour("Saddle", asBEHAVE_FACTORY, "Saddle@ f()", asFUNCTION(SaddleFactory), asCALL_CDECL); assert( r >= 0 );
+
+    r = engine->RegisterGlobalFunction("void Noop()", asFUNCTION(Noop), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("void TakeNative(Horse@ h)", asFUNCTION(TakeNative), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("void TakeCustomized(HorsePtr@ h)", asFUNCTION(TakeCustomized), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("HorsePtr@ FetchFromStable()", asFUNCTION(FetchFromStable), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("Horse@ FetchNative()", asFUNCTION(FetchNative), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("Stable@ FetchNoCount()", asFUNCTION(FetchNoCount), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("void TakeNoCount(Stable@ s)", asFUNCTION(TakeNoCount), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("void TakeScoped(Saddle &s)", asFUNCTION(TakeScoped), asCALL_CDECL); assert( r >= 0 );
+    (void)r;
+}
+
+static void ExecuteScenario(asIScriptContext* ctx, asIScriptFunction* func, size_t n)
+{
+    ctx->Prepare(func);
+    ctx->SetArgDWord(0, asDWORD(n));
+    int r = ctx->Execute();
+    if (r != asEXECUTION_FINISHED)
+    {
+        fprintf(stderr, "%s: execution failed (%d)\n", func->GetDeclaration(), r);
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::Runner runner("boundary", argc, argv);
+
+    asIScriptEngine* engine = asCreateScriptEngine();
+    engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+    ConfigureEngine(engine);
+
+    asIScriptModule* mod = engine->GetModule("bench", asGM_ALWAYS_CREATE);
+    mod->AddScriptSection("bench_boundary", BENCH_SCRIPT, strlen(BENCH_SCRIPT));
+    if (mod->Build() < 0)
+    {
+        fprintf(stderr, "Build() failed\n");
+        return 1;
+    }
+
+    g_stable = HorseFactory();
+    asIScriptContext* ctx = engine->CreateContext();
+
+    const size_t COUNTER_CALLS = 10000;
+    for (const Scenario& scenario: SCENARIOS)
+    {
+        asIScriptFunction* func = mod->GetFunctionByDecl(scenario.func_decl);
+        assert(func);
+
+        // The execution is capped to 32-bit iteration counts by the script signature
+        if (!runner.Run(scenario.name, [&](size_t n) { ExecuteScenario(ctx, func, std::min<size_t>(n, 0xFFFFFFFFu)); }))
+            continue;
+
+        // Count separately so the counting run isn't mixed with calibration runs.
+        // Setup done by the script function itself (creating the local horse) is amortized away.
+        g_addref_count = 0;
+        g_release_count = 0;
+        ExecuteScenario(ctx, func, COUNTER_CALLS);
+        runner.AddCounter("addref_per_op", double(g_addref_count) / COUNTER_CALLS);
+        runner.AddCounter("release_per_op", double(g_release_count) / COUNTER_CALLS);
+        runner.AddCounter("refcount_ops_per_op", double(g_addref_count + g_release_count) / COUNTER_CALLS);
+    }
+
+    ctx->Release();
+    g_stable = nullptr;
+    engine->ShutDownAndRelease();
+
+    return runner.Finish();
+}
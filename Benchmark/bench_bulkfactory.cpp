@@ -0,0 +1,168 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+// Spawning horses from script in batches of 64 into an `array<Horse@>`, as
+// scripts spawning entities do, then dropping the array:
+//
+//   create/new_loop    - `Horse()` in a loop, each horse from the heap
+//   create/pooled_loop - `Horse()` in a loop, each horse from the pool of
+//                        PooledRefCountingObject
+//   create/bulk        - `CreateHorses(n)`, all of the batch in one call
+//
+// One op is one horse created and released. Each case also reports the
+// pool's slabs, which stay the same once the pool has warmed up.
+
+#include "bench.h"
+
+#include "../RefCountingObject.h"
+#include "../RefCountingObjectPool.h"
+
+#include <angelscript.h>
+#include "scriptarray.h"
+
+#include <cassert>
+#include <cstring>
+
+// -------------------------- Test subjects ----------------------------
+
+class HeapHorse: public RefCountingObject<HeapHorse>
+{
+public:
+    float position[3] = {};
+};
+
+class PooledHorse: public PooledRefCountingObject<PooledHorse>
+{
+public:
+    float position[3] = {};
+};
+
+HeapHorse* HeapHorseFactory() { return new HeapHorse(); }
+
+PooledHorse* PooledHorseFactory() { return new PooledHorse(); }
+
+// ---------------------------- Script ---------------------------------
+
+static const char* BENCH_SCRIPT = R"(
+uint Batch(uint left)
+{
+    return left < 64 ? left : 64;
+}
+
+void Bench_NewLoop(uint n)
+{
+    for (uint i = 0; i < n; i += 64)
+    {
+        array<HeapHorse@> horses(Batch(n - i));
+        for (uint k = 0; k < horses.length(); k++)
+            @horses[k] = HeapHorse();
+    }
+}
+
+void Bench_PooledLoop(uint n)
+{
+    for (uint i = 0; i < n; i += 64)
+    {
+        array<Horse@> horses(Batch(n - i));
+        for (uint k = 0; k < horses.length(); k++)
+            @horses[k] = Horse();
+    }
+}
+
+void Bench_Bulk(uint n)
+{
+    for (uint i = 0; i < n; i += 64)
+    {
+        array<Horse@>@ horses = CreateHorses(Batch(n - i));
+    }
+}
+)";
+
+struct Scenario
+{
+    const char* name;
+    const char* func_decl;
+};
+
+static const Scenario SCENARIOS[] =
+{
+    { "create/new_loop",    "void Bench_NewLoop(uint)" },
+    { "create/pooled_loop", "void Bench_PooledLoop(uint)" },
+    { "create/bulk",        "void Bench_Bulk(uint)" },
+};
+
+// ---------------------------- Engine ---------------------------------
+
+static void MessageCallback(const asSMessageInfo* msg, void* /*param*/)
+{
+    const char* type = "ERR ";
+    if (msg->type == asMSGTYPE_WARNING)
+        type = "WARN";
+    else if (msg->type == asMSGTYPE_INFORMATION)
+        type = "INFO";
+
+    fprintf(stderr, "%s (%d, %d) : %s : %s\n", msg->section, msg->row, msg->col, type, msg->message);
+}
+
+static void ConfigureEngine(asIScriptEngine* engine)
+{
+    int r;
+
+    RegisterScriptArray(engine, true);
+
+    HeapHorse::RegisterRefCountingObject("HeapHorse", engine);
+    r = engine->RegisterObjectBehaviour("HeapHorse", asBEHAVE_FACTORY, "HeapHorse@ f()", asFUNCTION(HeapHorseFactory), asCALL_CDECL); assert( r >= 0 );
+
+    PooledHorse::RegisterRefCountingObject("Horse", engine);
+    r = engine->RegisterObjectBehaviour("Horse", asBEHAVE_FACTORY, "Horse@ f()", asFUNCTION(PooledHorseFactory), asCALL_CDECL); assert( r >= 0 );
+    PooledHorse::RegisterBulkFactory<CScriptArray>("array<Horse@>@ CreateHorses(uint n)", engine);
+    (void)r;
+}
+
+static void ExecuteScenario(asIScriptContext* ctx, asIScriptFunction* func, size_t n)
+{
+    ctx->Prepare(func);
+    ctx->SetArgDWord(0, asDWORD(n));
+    int r = ctx->Execute();
+    if (r != asEXECUTION_FINISHED)
+    {
+        fprintf(stderr, "%s: execution failed (%d)\n", func->GetDeclaration(), r);
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::Runner runner("bulkfactory", argc, argv);
+
+    asIScriptEngine* engine = asCreateScriptEngine();
+    engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+    ConfigureEngine(engine);
+
+    asIScriptModule* mod = engine->GetModule("bench", asGM_ALWAYS_CREATE);
+    mod->AddScriptSection("bench_bulkfactory", BENCH_SCRIPT, strlen(BENCH_SCRIPT));
+    if (mod->Build() < 0)
+    {
+        fprintf(stderr, "Build() failed\n");
+        return 1;
+    }
+
+    asIScriptContext* ctx = engine->CreateContext();
+
+    for (const Scenario& scenario: SCENARIOS)
+    {
+        asIScriptFunction* func = mod->GetFunctionByDecl(scenario.func_decl);
+        assert(func);
+
+        // The execution is capped to 32-bit iteration counts by the script signature
+        if (runner.Run(scenario.name, [&](size_t n) { ExecuteScenario(ctx, func, std::min<size_t>(n, 0xFFFFFFFFu)); }))
+            runner.AddCounter("pool_slabs", double(RefCountingObjectPool<PooledHorse>::GetStats().slabs));
+    }
+
+    ctx->Release();
+    engine->ShutDownAndRelease();
+
+    return runner.Finish();
+}
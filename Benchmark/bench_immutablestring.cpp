@@ -0,0 +1,211 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+// Copy-heavy string workloads, run from script with the std::string based
+// `string` and with the immutable `istring` (Testbed/scriptimmutablestring.cpp):
+//   pass_by_value  calling `uint Take(T s)`
+//   assign         `b = a`
+//   record_copy    copying a script object with two string members
+//   return         returning a stored string from a function
+//   concat         `s = a + b`, where the immutable string must allocate too
+// each with a short (inline for `istring`) and a long value. `literal/*` assigns
+// a long string literal, with `istring` registered next to `string` (converted
+// from the std::string constant) and registered as `string` itself.
+// Each case reports the heap allocations per iteration as `allocs_per_op`.
+
+#include "bench.h"
+
+#include <angelscript.h>
+#include "scriptimmutablestring.h"
+#include "scriptstdstring.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+// -------------------------- Allocation counting ----------------------
+
+// Both string types allocate with operator new, the engine's own memory isn't counted
+static std::atomic<size_t> g_alloc_count(0);
+
+void* operator new(size_t size)
+{
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// ---------------------------- Workloads ------------------------------
+
+struct Workload
+{
+    const char* name;
+    const char* loop_body; // `a` and `b` are strings of the measured length, `total` a uint
+};
+
+static const Workload WORKLOADS[] =
+{
+    { "pass_by_value", "total += Take(a);" },
+    { "assign",        "b = a; total += b.length();" },
+    { "record_copy",   "r2 = r1; total += r2.name.length();" },
+    { "return",        "total += Get(r1).length();" },
+    { "concat",        "b = a + a; total += b.length();" },
+};
+
+struct Length
+{
+    const char* name;
+    size_t      chars;
+};
+
+static const Length LENGTHS[] =
+{
+    { "short", 12 }, // Fits inline, see CImmutableString::INLINE_CAPACITY
+    { "long",  64 },
+};
+
+static const char* LONG_LITERAL = "\"A long string literal that needs a heap buffer when copied\"";
+
+static std::string MakeScript(const char* type)
+{
+    const std::string t = type;
+    std::string code;
+    code += "class Record_" + t + " { " + t + " name; " + t + " value; }\n";
+    code += "uint Take_" + t + "(" + t + " s) { return s.length(); }\n";
+    code += t + " Get_" + t + "(const Record_" + t + " &in r) { return r.value; }\n";
+    for (const Length& len : LENGTHS)
+    {
+        for (const Workload& w : WORKLOADS)
+        {
+            std::string body = w.loop_body;
+            for (std::string::size_type p; (p = body.find("Take(")) != std::string::npos; )
+                body.replace(p, 4, "Take_" + t);
+            for (std::string::size_type p; (p = body.find("Get(")) != std::string::npos; )
+                body.replace(p, 3, "Get_" + t);
+
+            code += std::string("uint Bench_") + w.name + "_" + len.name + "_" + t + "(uint n)\n{\n";
+            code += "    " + t + " a = " + t + "(\"" + std::string(len.chars, 'x') + "\");\n";
+            code += "    " + t + " b;\n";
+            code += "    Record_" + t + " r1, r2;\n";
+            code += "    r1.name = a; r1.value = a;\n";
+            code += "    uint total = 0;\n";
+            code += "    for (uint i = 0; i < n; i++) { " + body + " }\n";
+            code += "    return total;\n}\n";
+        }
+    }
+    code += "uint Bench_literal_" + t + "(uint n)\n{\n    " + t + " s;\n    uint total = 0;\n";
+    code += std::string("    for (uint i = 0; i < n; i++) { s = ") + LONG_LITERAL + "; total += s.length(); }\n";
+    code += "    return total;\n}\n";
+    return code;
+}
+
+// ---------------------------- Engine ---------------------------------
+
+static void MessageCallback(const asSMessageInfo* msg, void* /*param*/)
+{
+    const char* type = "ERR ";
+    if (msg->type == asMSGTYPE_WARNING)
+        type = "WARN";
+    else if (msg->type == asMSGTYPE_INFORMATION)
+        type = "INFO";
+
+    fprintf(stderr, "%s (%d, %d) : %s : %s\n", msg->section, msg->row, msg->col, type, msg->message);
+}
+
+static void ExecuteScenario(asIScriptContext* ctx, asIScriptFunction* func, size_t n)
+{
+    ctx->Prepare(func);
+    ctx->SetArgDWord(0, asDWORD(n));
+    int r = ctx->Execute();
+    if (r != asEXECUTION_FINISHED)
+    {
+        fprintf(stderr, "%s: execution failed (%d)\n", func->GetDeclaration(), r);
+        exit(1);
+    }
+    bench::DoNotOptimize(ctx->GetReturnDWord());
+}
+
+static asIScriptModule* BuildModule(asIScriptEngine* engine, const std::string& code)
+{
+    asIScriptModule* mod = engine->GetModule("bench", asGM_ALWAYS_CREATE);
+    mod->AddScriptSection("bench_immutablestring", code.c_str(), code.length());
+    if (mod->Build() < 0)
+    {
+        fprintf(stderr, "Build() failed\n");
+        exit(1);
+    }
+    return mod;
+}
+
+static void RunCase(bench::Runner& runner, const std::string& name, asIScriptContext* ctx, asIScriptFunction* func)
+{
+    assert(func);
+    // The execution is capped to 32-bit iteration counts by the script signature
+    if (!runner.Run(name.c_str(), [&](size_t n) { ExecuteScenario(ctx, func, std::min<size_t>(n, 0xFFFFFFFFu)); }))
+        return;
+
+    const size_t calls = 10000;
+    const size_t allocs_before = g_alloc_count.load();
+    ExecuteScenario(ctx, func, calls);
+    runner.AddCounter("allocs_per_op", double(g_alloc_count.load() - allocs_before) / calls);
+}
+
+int main(int argc, char** argv)
+{
+    bench::Runner runner("immutablestring", argc, argv);
+
+    // `istring` next to `string`
+    {
+        asIScriptEngine* engine = asCreateScriptEngine();
+        engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+        RegisterStdString(engine);
+        RegisterImmutableString(engine);
+
+        asIScriptModule* mod = BuildModule(engine, MakeScript("string") + MakeScript("istring"));
+        asIScriptContext* ctx = engine->CreateContext();
+
+        for (const Length& len : LENGTHS)
+        {
+            for (const Workload& w : WORKLOADS)
+            {
+                for (const char* type : { "string", "istring" })
+                {
+                    const std::string func_name = std::string("Bench_") + w.name + "_" + len.name + "_" + type;
+                    const std::string name = std::string(w.name) + "/" + len.name + "/" + type;
+                    RunCase(runner, name, ctx, mod->GetFunctionByName(func_name.c_str()));
+                }
+            }
+        }
+
+        RunCase(runner, "literal/string", ctx, mod->GetFunctionByName("Bench_literal_string"));
+        RunCase(runner, "literal/istring", ctx, mod->GetFunctionByName("Bench_literal_istring"));
+
+        ctx->Release();
+        engine->ShutDownAndRelease();
+    }
+
+    // `istring` registered as `string`, with literals taken from the shared constant cache
+    {
+        asIScriptEngine* engine = asCreateScriptEngine();
+        engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+        RegisterImmutableString(engine, true);
+
+        asIScriptModule* mod = BuildModule(engine, MakeScript("string"));
+        asIScriptContext* ctx = engine->CreateContext();
+
+        RunCase(runner, "literal/istring_as_string", ctx, mod->GetFunctionByName("Bench_literal_string"));
+
+        ctx->Release();
+        engine->ShutDownAndRelease();
+    }
+
+    return runner.Finish();
+}
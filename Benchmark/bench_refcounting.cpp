@@ -0,0 +1,257 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+// C++-only microbenchmarks of RefCountingObject/RefCountingObjectPtr,
+// mirroring the steps of `ExampleCpp()`, against std::shared_ptr and a
+// bare intrusive pointer. No script engine is created.
+//
+// The `handle_param` and `handle_return` cases are the C++ half of passing
+// a `Horse@` between script and a native function: the AddRef()/Release()
+// pair that the engine and the function make per call, against a
+// NoCountObject, where neither does anything. bench_boundary measures the
+// whole call from script.
+
+#include "bench.h"
+
+#include "../RefCountingObject.h"
+#include "../RefCountingObjectPtr.h"
+
+#include <memory>
+#include <vector>
+
+#if defined(__GNUC__) || defined(__clang__)
+#   define BENCH_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#   define BENCH_NOINLINE __declspec(noinline)
+#else
+#   define BENCH_NOINLINE
+#endif
+
+// -------------------------- Test subjects ----------------------------
+
+class BenchHorse: public RefCountingObject<BenchHorse>
+{
+public:
+    int m_hooves = 4;
+};
+
+typedef RefCountingObjectPtr<BenchHorse> BenchHorsePtr;
+
+/// Same payload without any refcounting, for std::shared_ptr.
+class PlainHorse
+{
+public:
+    virtual ~PlainHorse() {}
+    int m_hooves = 4;
+};
+
+/// Minimal non-virtual intrusive refcount, the cheapest possible baseline.
+class IntrusiveHorse
+{
+public:
+    void AddRef() { m_refcount++; }
+    void Release() { if (--m_refcount == 0) delete this; }
+
+    int m_refcount = 1;
+    int m_hooves = 4;
+};
+
+template<class T> class IntrusivePtr
+{
+public:
+    IntrusivePtr(): m_ref(nullptr) {}
+    IntrusivePtr(T* ref): m_ref(ref) {} // Adopts the initial reference, like RefCountingObjectPtr.
+    IntrusivePtr(const IntrusivePtr& o): m_ref(o.m_ref) { if (m_ref) m_ref->AddRef(); }
+    ~IntrusivePtr() { if (m_ref) m_ref->Release(); }
+    IntrusivePtr& operator=(const IntrusivePtr& o)
+    {
+        if (o.m_ref) o.m_ref->AddRef();
+        if (m_ref) m_ref->Release();
+        m_ref = o.m_ref;
+        return *this;
+    }
+    T* GetRef() const { return m_ref; }
+
+private:
+    T* m_ref;
+};
+
+typedef std::shared_ptr<PlainHorse> SharedHorsePtr;
+typedef IntrusivePtr<IntrusiveHorse> IntrusiveHorsePtr;
+
+// Same shape as `ExampleCppFunctionCall()` in Example.cpp, minus the printing.
+BENCH_NOINLINE BenchHorsePtr PassThrough(BenchHorsePtr argPtr) { return argPtr; }
+BENCH_NOINLINE SharedHorsePtr PassThrough(SharedHorsePtr argPtr) { return argPtr; }
+BENCH_NOINLINE IntrusiveHorsePtr PassThrough(IntrusiveHorsePtr argPtr) { return argPtr; }
+
+/// App-owned, as registered with NoCountObject.
+class BenchStable: public NoCountObject<BenchStable>
+{
+public:
+    int m_stalls = 8;
+};
+
+// Same as the registered functions of bench_boundary.
+BENCH_NOINLINE void TakeNative(BenchHorse* horse)
+{
+    bench::DoNotOptimize(horse);
+    if (horse)
+        horse->Release();
+}
+
+BENCH_NOINLINE BenchHorse* FetchNative(BenchHorse* horse)
+{
+    bench::DoNotOptimize(horse);
+    if (horse)
+        horse->AddRef();
+    return horse;
+}
+
+BENCH_NOINLINE void TakeNoCount(BenchStable* stable)
+{
+    bench::DoNotOptimize(stable);
+}
+
+BENCH_NOINLINE BenchStable* FetchNoCount(BenchStable* stable)
+{
+    bench::DoNotOptimize(stable);
+    return stable;
+}
+
+BenchHorsePtr MakeHorse(BenchHorsePtr*) { return new BenchHorse(); }
+SharedHorsePtr MakeHorse(SharedHorsePtr*) { return std::make_shared<PlainHorse>(); }
+IntrusiveHorsePtr MakeHorse(IntrusiveHorsePtr*) { return new IntrusiveHorse(); }
+
+// ---------------------------- Cases ----------------------------------
+
+template<class P> void CreateDestroy(size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        P ptr = MakeHorse((P*)nullptr);
+        bench::DoNotOptimize(ptr);
+    }
+}
+
+template<class P> void CopyAssign(size_t n)
+{
+    P ptr1 = MakeHorse((P*)nullptr);
+    P ptr2;
+    for (size_t i = 0; i < n; i++)
+    {
+        P copy = ptr1; // copy-construct: add ref
+        ptr2 = copy;   // assign: add ref
+        bench::DoNotOptimize(ptr2);
+        ptr2 = P();    // release ref
+    }
+}
+
+template<class P> void VectorPushPop(size_t n)
+{
+    P ptr = MakeHorse((P*)nullptr);
+    std::vector<P> horses;
+    horses.reserve(1);
+    for (size_t i = 0; i < n; i++)
+    {
+        horses.push_back(ptr);
+        bench::DoNotOptimize(horses.data());
+        horses.pop_back();
+    }
+}
+
+template<class P> void VectorFill(size_t n)
+{
+    // Push/pop of many distinct objects, including reallocation of the vector
+    const size_t BATCH = 1000;
+    std::vector<P> horses;
+    for (size_t done = 0; done < n; done += BATCH)
+    {
+        const size_t count = std::min(BATCH, n - done);
+        for (size_t i = 0; i < count; i++)
+            horses.push_back(MakeHorse((P*)nullptr));
+        bench::DoNotOptimize(horses.data());
+        while (!horses.empty())
+            horses.pop_back();
+        horses.shrink_to_fit();
+    }
+}
+
+template<class P> void FunctionCall(size_t n)
+{
+    P ptr = MakeHorse((P*)nullptr);
+    for (size_t i = 0; i < n; i++)
+    {
+        ptr = PassThrough(ptr);
+        bench::DoNotOptimize(ptr);
+    }
+}
+
+// `TakeNative(horse)`: the engine adds the reference which the function releases
+void HandleParamNative(size_t n)
+{
+    BenchHorse* horse = new BenchHorse();
+    for (size_t i = 0; i < n; i++)
+    {
+        horse->AddRef();
+        TakeNative(horse);
+    }
+    horse->Release();
+}
+
+void HandleParamNoCount(size_t n)
+{
+    BenchStable stable;
+    for (size_t i = 0; i < n; i++)
+        TakeNoCount(&stable);
+}
+
+// `@h = FetchNative()`: the function adds the reference which the engine releases
+// when the handle is overwritten
+void HandleReturnNative(size_t n)
+{
+    BenchHorse* horse = new BenchHorse();
+    for (size_t i = 0; i < n; i++)
+    {
+        BenchHorse* result = FetchNative(horse);
+        bench::DoNotOptimize(result);
+        result->Release();
+    }
+    horse->Release();
+}
+
+void HandleReturnNoCount(size_t n)
+{
+    BenchStable stable;
+    for (size_t i = 0; i < n; i++)
+    {
+        BenchStable* result = FetchNoCount(&stable);
+        bench::DoNotOptimize(result);
+    }
+}
+
+template<class P> void RunCases(bench::Runner& runner, const std::string& kind)
+{
+    runner.Run(("create_destroy/" + kind).c_str(), CreateDestroy<P>);
+    runner.Run(("copy_assign/" + kind).c_str(), CopyAssign<P>);
+    runner.Run(("vector_push_pop/" + kind).c_str(), VectorPushPop<P>);
+    runner.Run(("vector_fill_1000/" + kind).c_str(), VectorFill<P>);
+    runner.Run(("function_call/" + kind).c_str(), FunctionCall<P>);
+}
+
+int main(int argc, char** argv)
+{
+    bench::Runner runner("refcounting", argc, argv);
+
+    RunCases<BenchHorsePtr>(runner, "RefCountingObjectPtr");
+    RunCases<SharedHorsePtr>(runner, "std::shared_ptr");
+    RunCases<IntrusiveHorsePtr>(runner, "intrusive_ptr");
+
+    runner.Run("handle_param/native_handle", HandleParamNative);
+    runner.Run("handle_param/nocount", HandleParamNoCount);
+    runner.Run("handle_return/native_handle", HandleReturnNative);
+    runner.Run("handle_return/nocount", HandleReturnNoCount);
+
+    return runner.Finish();
+}
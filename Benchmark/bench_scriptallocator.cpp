@@ -0,0 +1,250 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+// Script object heavy workloads with the engine's memory functions from
+// Testbed/scriptallocator.cpp, which is installed before the engine is created:
+//
+//   temp_objects - 1000 script objects created and destroyed one after the other
+//   linked_list  - a list of 1000 garbage collected nodes, built and dropped
+//   tree         - a binary tree of 1023 garbage collected nodes, built and dropped
+//
+// each with all requests sent to malloc (`malloc`, the allocator's pass-through
+// mode, so the same engine can be used), with the size classes (`sizeclass`),
+// and with a bump arena attached to the context (`arena`). The `threads4` cases
+// run the tree on 4 threads at once, each with a context of its own. Besides
+// ns/op each case reports the engine's allocation requests as `allocs_per_op`.
+
+#include "bench.h"
+
+#include <angelscript.h>
+#include "scriptallocator.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ------------------------------ Script -------------------------------
+
+static const char* SCRIPT = R"(
+class Particle
+{
+    Particle(int i) { x = i; y = i * 2; z = i * 3; }
+    float x;
+    float y;
+    float z;
+}
+
+class Node
+{
+    int value;
+    Node@ next;
+}
+
+class Tree
+{
+    Tree@ left;
+    Tree@ right;
+}
+
+uint TempObjects()
+{
+    float sum = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        Particle p(i);
+        sum += p.x + p.y + p.z;
+    }
+    return uint(sum);
+}
+
+uint LinkedList()
+{
+    Node@ head;
+    for (int i = 0; i < 1000; i++)
+    {
+        Node n;
+        n.value = i;
+        @n.next = head;
+        @head = n;
+    }
+
+    uint count = 0;
+    for (Node@ n = head; n !is null; @n = n.next)
+        count++;
+    return count;
+}
+
+Tree@ Build(int depth)
+{
+    Tree t;
+    if (depth > 0)
+    {
+        @t.left = Build(depth - 1);
+        @t.right = Build(depth - 1);
+    }
+    return t;
+}
+
+uint Count(Tree@ t)
+{
+    return t is null ? 0 : 1 + Count(t.left) + Count(t.right);
+}
+
+uint BuildTree()
+{
+    return Count(Build(9));
+}
+)";
+
+struct Workload
+{
+    const char* name;
+    const char* function;
+};
+
+static const Workload WORKLOADS[] =
+{
+    { "temp_objects", "TempObjects" },
+    { "linked_list",  "LinkedList" },
+    { "tree",         "BuildTree" },
+};
+
+enum Mode
+{
+    MODE_MALLOC,
+    MODE_SIZECLASS,
+    MODE_ARENA,
+};
+
+static const char* MODE_NAMES[] = { "malloc", "sizeclass", "arena" };
+
+static const int THREADS = 4;
+
+// ---------------------------- Engine ---------------------------------
+
+static void MessageCallback(const asSMessageInfo* msg, void* /*param*/)
+{
+    const char* type = "ERR ";
+    if (msg->type == asMSGTYPE_WARNING)
+        type = "WARN";
+    else if (msg->type == asMSGTYPE_INFORMATION)
+        type = "INFO";
+
+    fprintf(stderr, "%s (%d, %d) : %s : %s\n", msg->section, msg->row, msg->col, type, msg->message);
+}
+
+static void Execute(asIScriptContext* ctx, asIScriptFunction* func)
+{
+    ctx->Prepare(func);
+    // Sends the requests to the context's arena, if it has one
+    CScriptContextArenaScope scope(ctx);
+    int r = ctx->Execute();
+    if (r != asEXECUTION_FINISHED)
+    {
+        fprintf(stderr, "%s: execution failed (%d)\n", func->GetDeclaration(), r);
+        exit(1);
+    }
+    bench::DoNotOptimize(ctx->GetReturnDWord());
+}
+
+static asQWORD TotalAllocations()
+{
+    SScriptAllocatorStats stats;
+    GetScriptAllocatorStats(stats);
+
+    asQWORD total = stats.largeAllocations + stats.passThroughAllocations + stats.arenaAllocations;
+    for (asUINT n = 0; n < SCRIPTALLOCATOR_CLASS_COUNT; n++)
+        total += stats.classes[n].allocations;
+    return total;
+}
+
+static asIScriptContext* CreateContext(asIScriptEngine* engine, Mode mode)
+{
+    SetScriptAllocatorPassThrough(mode == MODE_MALLOC);
+    asIScriptContext* ctx = engine->CreateContext();
+    if (mode == MODE_ARENA)
+        CScriptContextArena::Attach(ctx);
+    return ctx;
+}
+
+// Runs `func` `n` times on each of THREADS threads at once
+static void RunThreads(asIScriptEngine* engine, asIScriptFunction* func, Mode mode, size_t n)
+{
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++)
+    {
+        threads.push_back(std::thread([=]()
+        {
+            asIScriptContext* ctx = CreateContext(engine, mode);
+            for (size_t i = 0; i < n; i++)
+                Execute(ctx, func);
+            ctx->Release();
+            asThreadCleanup();
+        }));
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+int main(int argc, char** argv)
+{
+    bench::Runner runner("scriptallocator", argc, argv);
+
+    // Before the engine allocates anything
+    InstallScriptAllocator();
+
+    asIScriptEngine* engine = asCreateScriptEngine();
+    engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+
+    asIScriptModule* mod = engine->GetModule("bench", asGM_ALWAYS_CREATE);
+    mod->AddScriptSection("bench_scriptallocator", SCRIPT);
+    if (mod->Build() < 0)
+    {
+        fprintf(stderr, "Build() failed\n");
+        return 1;
+    }
+
+    for (const Workload& workload : WORKLOADS)
+    {
+        asIScriptFunction* func = mod->GetFunctionByName(workload.function);
+        assert(func);
+
+        for (int mode = MODE_MALLOC; mode <= MODE_ARENA; mode++)
+        {
+            const std::string name = std::string(workload.name) + "/" + MODE_NAMES[mode];
+            if (!runner.IsSelected(name.c_str()))
+                continue;
+
+            asIScriptContext* ctx = CreateContext(engine, Mode(mode));
+            runner.Run(name.c_str(), [&](size_t n) { for (size_t i = 0; i < n; i++) Execute(ctx, func); });
+
+            const asQWORD allocs_before = TotalAllocations();
+            Execute(ctx, func);
+            runner.AddCounter("allocs_per_op", double(TotalAllocations() - allocs_before));
+
+            ctx->Release();
+            engine->GarbageCollect();
+        }
+    }
+
+    asIScriptFunction* tree = mod->GetFunctionByName("BuildTree");
+    for (int mode = MODE_MALLOC; mode <= MODE_ARENA; mode++)
+    {
+        const std::string name = std::string("threads4/tree/") + MODE_NAMES[mode];
+        if (!runner.IsSelected(name.c_str()))
+            continue;
+
+        // One op is a tree on each thread
+        runner.Run(name.c_str(), [&](size_t n) { RunThreads(engine, tree, Mode(mode), n); });
+        engine->GarbageCollect();
+    }
+
+    SetScriptAllocatorPassThrough(false);
+    engine->ShutDownAndRelease();
+
+    return runner.Finish();
+}
@@ -0,0 +1,151 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+// Building strings from script with operator chains vs the StringBuilder
+// add-on (Testbed/scriptstringbuilder.cpp) and format() (Testbed/scriptstringformat.cpp):
+//   log_line  `"(ref2 == ref1): " + b + "\n"`, the Print() line of Example.as
+//   record    five fields with labels, numbers of each type
+//   join_100  100 numbers separated by commas, `+=` in a loop
+// `*/operators` use the string operators, `*/builder` a builder reused between
+// iterations, `*/builder_new` a new builder per iteration, reserved up front, and
+// `*/format` a single format() call.
+// Each case reports the heap allocations per iteration as `allocs_per_op`.
+
+#include "bench.h"
+
+#include <angelscript.h>
+#include "scriptstdstring.h"
+#include "scriptstringbuilder.h"
+#include "scriptstringformat.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+// -------------------------- Allocation counting ----------------------
+
+static std::atomic<size_t> g_alloc_count(0);
+
+void* operator new(size_t size)
+{
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// ---------------------------- Workloads ------------------------------
+
+struct Workload
+{
+    const char* name;
+    const char* loop_body; // Leaves the result in `s`; `sb` is a StringBuilder declared before the loop
+};
+
+static const Workload WORKLOADS[] =
+{
+    { "log_line/operators",    "s = \"(ref2 == ref1): \" + b + \"\\n\";" },
+    { "log_line/builder",      "sb.clear(); sb.append(\"(ref2 == ref1): \").append(b).append(\"\\n\"); s = sb.str();" },
+    { "log_line/builder_new",  "StringBuilder t(32); t.append(\"(ref2 == ref1): \").append(b).append(\"\\n\"); s = t.str();" },
+    { "log_line/format",       "s = format(\"(ref2 == ref1): {}\\n\", b);" },
+    { "record/operators",      "s = \"id=\" + id + \" name=\" + name + \" x=\" + x + \" y=\" + y + \" alive=\" + b + \"\\n\";" },
+    { "record/builder",        "sb.clear(); sb.append(\"id=\").append(id).append(\" name=\").append(name).append(\" x=\").append(x)"
+                               ".append(\" y=\").append(y).append(\" alive=\").append(b).append(\"\\n\"); s = sb.str();" },
+    { "record/builder_new",    "StringBuilder t(96); t.append(\"id=\").append(id).append(\" name=\").append(name).append(\" x=\").append(x)"
+                               ".append(\" y=\").append(y).append(\" alive=\").append(b).append(\"\\n\"); s = t.str();" },
+    { "record/format",         "s = format(\"id={} name={} x={} y={} alive={}\\n\", id, name, x, y, b);" },
+    { "join_100/operators",    "s = \"\"; for (int j = 0; j < 100; j++) { s += j + \",\"; }" },
+    { "join_100/builder",      "sb.clear(); for (int j = 0; j < 100; j++) { sb.append(j).append(\",\"); } s = sb.str();" },
+    { "join_100/builder_new",  "StringBuilder t(400); for (int j = 0; j < 100; j++) { t.append(j).append(\",\"); } s = t.str();" },
+};
+
+static std::string MakeScript()
+{
+    std::string code;
+    for (size_t i = 0; i < sizeof(WORKLOADS) / sizeof(WORKLOADS[0]); i++)
+    {
+        code += "uint Bench_" + std::to_string(i) + "(uint n)\n{\n";
+        code += "    string s;\n    StringBuilder sb;\n";
+        code += "    bool b = true;\n    int64 id = 123456;\n    string name = \"Horse\";\n";
+        code += "    double x = 12.75;\n    float y = -0.5f;\n    uint total = 0;\n";
+        code += std::string("    for (uint i = 0; i < n; i++) { ") + WORKLOADS[i].loop_body + " total += s.length(); }\n";
+        code += "    return total;\n}\n";
+    }
+    return code;
+}
+
+// ---------------------------- Engine ---------------------------------
+
+static void MessageCallback(const asSMessageInfo* msg, void* /*param*/)
+{
+    const char* type = "ERR ";
+    if (msg->type == asMSGTYPE_WARNING)
+        type = "WARN";
+    else if (msg->type == asMSGTYPE_INFORMATION)
+        type = "INFO";
+
+    fprintf(stderr, "%s (%d, %d) : %s : %s\n", msg->section, msg->row, msg->col, type, msg->message);
+}
+
+static void ExecuteScenario(asIScriptContext* ctx, asIScriptFunction* func, size_t n)
+{
+    ctx->Prepare(func);
+    ctx->SetArgDWord(0, asDWORD(n));
+    int r = ctx->Execute();
+    if (r != asEXECUTION_FINISHED)
+    {
+        fprintf(stderr, "%s: execution failed (%d)\n", func->GetDeclaration(), r);
+        exit(1);
+    }
+    bench::DoNotOptimize(ctx->GetReturnDWord());
+}
+
+int main(int argc, char** argv)
+{
+    bench::Runner runner("stringbuilder", argc, argv);
+
+    asIScriptEngine* engine = asCreateScriptEngine();
+    engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+    RegisterStdString(engine);
+    RegisterScriptStringBuilder(engine);
+    RegisterStringFormat(engine);
+
+    const std::string code = MakeScript();
+    asIScriptModule* mod = engine->GetModule("bench", asGM_ALWAYS_CREATE);
+    mod->AddScriptSection("bench_stringbuilder", code.c_str(), code.length());
+    if (mod->Build() < 0)
+    {
+        fprintf(stderr, "Build() failed\n");
+        return 1;
+    }
+
+    asIScriptContext* ctx = engine->CreateContext();
+
+    for (size_t i = 0; i < sizeof(WORKLOADS) / sizeof(WORKLOADS[0]); i++)
+    {
+        const std::string func_name = "Bench_" + std::to_string(i);
+        asIScriptFunction* func = mod->GetFunctionByName(func_name.c_str());
+        assert(func);
+
+        // The execution is capped to 32-bit iteration counts by the script signature
+        if (!runner.Run(WORKLOADS[i].name, [&](size_t n) { ExecuteScenario(ctx, func, std::min<size_t>(n, 0xFFFFFFFFu)); }))
+            continue;
+
+        const size_t calls = 10000;
+        const size_t allocs_before = g_alloc_count.load();
+        ExecuteScenario(ctx, func, calls);
+        runner.AddCounter("allocs_per_op", double(g_alloc_count.load() - allocs_before) / calls);
+    }
+
+    ctx->Release();
+    engine->ShutDownAndRelease();
+
+    return runner.Finish();
+}
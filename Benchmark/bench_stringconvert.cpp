@@ -0,0 +1,190 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+// Number to string conversions of the `string` add-on (Testbed/scriptstdstring.cpp),
+// one case per conversion operator and value type, measured from script:
+//   assign      `s = value`
+//   add_assign  `s += value`
+//   add         `s = prefix + value`
+//   add_r       `s = value + suffix`
+//   log_line    `s = "x: " + value + "\n"`, the typical logging expression
+// `format/*` cases call formatInt(), formatUInt() and formatFloat() with
+// the various option flags, `parse/*` cases parseInt(), parseUInt() and
+// parseFloat() with short and long fields.
+// `empty_loop` is the cost of the script loop alone.
+
+#include "bench.h"
+
+#include <angelscript.h>
+#include "scriptstdstring.h"
+
+#include <cassert>
+#include <string>
+#include <vector>
+
+struct ValueType
+{
+    const char* type;
+    const char* value;
+};
+
+static const ValueType VALUE_TYPES[] =
+{
+    { "int64",  "-123456789" },
+    { "uint64", "1234567890123" },
+    { "double", "3.14159265358979" },
+    { "float",  "2.71828f" },
+    { "bool",   "true" },
+};
+
+struct Operation
+{
+    const char* name;
+    const char* loop_body; // `s` is the result, `v` the value
+};
+
+static const Operation OPERATIONS[] =
+{
+    { "assign",     "s = v;" },
+    { "add_assign", "s += v; if (s.length() > 4096) s.resize(0);" },
+    { "add",        "s = prefix + v;" },
+    { "add_r",      "s = v + prefix;" },
+    { "log_line",   "s = \"x: \" + v + \"\\n\";" },
+};
+
+struct LibraryCall
+{
+    const char* name;
+    const char* expression;
+};
+
+static const LibraryCall LIBRARY_CALLS[] =
+{
+    { "format/int",                "formatInt(-123456789)" },
+    { "format/int_width",          "formatInt(-123456789, \"\", 15)" },
+    { "format/int_left",           "formatInt(-123456789, \"l\", 15)" },
+    { "format/int_zero_sign",      "formatInt(123456789, \"0+\", 15)" },
+    { "format/int_space",          "formatInt(123456789, \" \", 15)" },
+    { "format/int_hex",            "formatInt(0xBEEF, \"h\")" },
+    { "format/int_hex_upper_zero", "formatInt(0xBEEF, \"0H\", 8)" },
+    { "format/uint",               "formatUInt(1234567890123)" },
+    { "format/uint_zero",          "formatUInt(1234567890123, \"0\", 20)" },
+    { "format/uint_hex",           "formatUInt(0xDEADBEEF, \"H\", 16)" },
+    { "format/float",              "formatFloat(3.14159265358979, \"\", 0, 3)" },
+    { "format/float_width",        "formatFloat(3.14159265358979, \"\", 12, 6)" },
+    { "format/float_zero_sign",    "formatFloat(3.14159265358979, \"0+\", 12, 6)" },
+    { "format/float_left",         "formatFloat(-3.14159265358979, \"l\", 12, 2)" },
+    { "format/float_exp",          "formatFloat(6.02214076e23, \"e\", 0, 4)" },
+    { "format/float_exp_upper",    "formatFloat(6.02214076e23, \"E\", 15, 4)" },
+    { "format/float_large",        "formatFloat(1.5e300, \"\", 0, 2)" },
+    { "parse/int",                 "formatInt(parseInt(\"-1234567\"))" },
+    { "parse/int_long",            "formatInt(parseInt(\"-123456789012345678\"))" },
+    { "parse/int_hex",             "formatInt(parseInt(\"7fffABCD\", 16))" },
+    { "parse/uint_long",           "formatUInt(parseUInt(\"18446744073709551615\"))" },
+    { "parse/float",               "formatFloat(parseFloat(\"3.14159\"))" },
+    { "parse/float_long",          "formatFloat(parseFloat(\"-3.14159265358979323846\"))" },
+    { "parse/float_exp",           "formatFloat(parseFloat(\"6.02214076e23\"))" },
+};
+
+static std::string FunctionName(const Operation& op, const ValueType& vt)
+{
+    return std::string("Bench_") + op.name + "_" + vt.type;
+}
+
+static std::string MakeScript()
+{
+    std::string code = "void Bench_EmptyLoop(uint n)\n{\n    for (uint i = 0; i < n; i++) {}\n}\n";
+    for (const ValueType& vt : VALUE_TYPES)
+    {
+        for (const Operation& op : OPERATIONS)
+        {
+            code += "void " + FunctionName(op, vt) + "(uint n)\n{\n";
+            code += std::string("    string s;\n    string prefix = \"value: \";\n    ") + vt.type + " v = " + vt.value + ";\n";
+            code += std::string("    for (uint i = 0; i < n; i++) { ") + op.loop_body + " }\n}\n";
+        }
+    }
+    // The parse cases format the result to keep the loops alike, see format/int and format/float
+    for (size_t i = 0; i < sizeof(LIBRARY_CALLS) / sizeof(LIBRARY_CALLS[0]); i++)
+    {
+        code += "void Bench_Call" + std::to_string(i) + "(uint n)\n{\n    string s;\n";
+        code += std::string("    for (uint i = 0; i < n; i++) { s = ") + LIBRARY_CALLS[i].expression + "; }\n}\n";
+    }
+    return code;
+}
+
+// ---------------------------- Engine ---------------------------------
+
+static void MessageCallback(const asSMessageInfo* msg, void* /*param*/)
+{
+    const char* type = "ERR ";
+    if (msg->type == asMSGTYPE_WARNING)
+        type = "WARN";
+    else if (msg->type == asMSGTYPE_INFORMATION)
+        type = "INFO";
+
+    fprintf(stderr, "%s (%d, %d) : %s : %s\n", msg->section, msg->row, msg->col, type, msg->message);
+}
+
+static void ExecuteScenario(asIScriptContext* ctx, asIScriptFunction* func, size_t n)
+{
+    ctx->Prepare(func);
+    ctx->SetArgDWord(0, asDWORD(n));
+    int r = ctx->Execute();
+    if (r != asEXECUTION_FINISHED)
+    {
+        fprintf(stderr, "%s: execution failed (%d)\n", func->GetDeclaration(), r);
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::Runner runner("stringconvert", argc, argv);
+
+    asIScriptEngine* engine = asCreateScriptEngine();
+    engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+    RegisterStdString(engine);
+
+    const std::string code = MakeScript();
+    asIScriptModule* mod = engine->GetModule("bench", asGM_ALWAYS_CREATE);
+    mod->AddScriptSection("bench_stringconvert", code.c_str(), code.length());
+    if (mod->Build() < 0)
+    {
+        fprintf(stderr, "Build() failed\n");
+        return 1;
+    }
+
+    asIScriptContext* ctx = engine->CreateContext();
+
+    // The execution is capped to 32-bit iteration counts by the script signature
+    asIScriptFunction* empty = mod->GetFunctionByName("Bench_EmptyLoop");
+    runner.Run("empty_loop", [&](size_t n) { ExecuteScenario(ctx, empty, std::min<size_t>(n, 0xFFFFFFFFu)); });
+
+    for (const ValueType& vt : VALUE_TYPES)
+    {
+        for (const Operation& op : OPERATIONS)
+        {
+            const std::string func_name = FunctionName(op, vt);
+            asIScriptFunction* func = mod->GetFunctionByName(func_name.c_str());
+            assert(func);
+
+            const std::string name = std::string(op.name) + "/" + vt.type;
+            runner.Run(name.c_str(), [&](size_t n) { ExecuteScenario(ctx, func, std::min<size_t>(n, 0xFFFFFFFFu)); });
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(LIBRARY_CALLS) / sizeof(LIBRARY_CALLS[0]); i++)
+    {
+        const std::string func_name = "Bench_Call" + std::to_string(i);
+        asIScriptFunction* func = mod->GetFunctionByName(func_name.c_str());
+        assert(func);
+        runner.Run(LIBRARY_CALLS[i].name, [&](size_t n) { ExecuteScenario(ctx, func, std::min<size_t>(n, 0xFFFFFFFFu)); });
+    }
+
+    ctx->Release();
+    engine->ShutDownAndRelease();
+
+    return runner.Finish();
+}
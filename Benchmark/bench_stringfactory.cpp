@@ -0,0 +1,295 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+// Contention on the string constant cache of the `string` add-on
+// (Testbed/scriptstdstring.cpp). The cache is shared by every engine, so
+// modules built on several threads at once all go through it.
+//
+// `intern/*` cases request and release constants from N threads at once,
+// comparing the sharded cache against the previous design (one map guarded
+// by the engine-wide exclusive lock), kept here as `legacy`.
+// `build/*` cases build a literal-heavy module on N threads, each with its own engine.
+// `lookup/*` and `populate/*` cases are single threaded and also report heap
+// allocations, for finding existing constants and for filling the cache with
+// as many distinct literals as a large script base has.
+// Reported times are wall-clock per operation, i.e. lower is better throughput.
+
+#include "bench.h"
+
+#include <angelscript.h>
+#include "scriptstdstring.h"
+
+#include <atomic>
+#include <cassert>
+#include <new>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// ------------------------ Allocation counting -------------------------
+
+static std::atomic<size_t> g_alloc_count(0);
+static std::atomic<size_t> g_alloc_bytes(0);
+
+void* operator new(size_t size)
+{
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// --------------------------- Baselines -------------------------------
+
+/// The string factory before sharding: one cache, one global lock.
+class LegacyStringFactory: public asIStringFactory
+{
+public:
+    const void* GetStringConstant(const char* data, asUINT length) override
+    {
+        asAcquireExclusiveLock();
+        auto it = m_cache.find(std::string(data, length));
+        if (it != m_cache.end())
+            it->second++;
+        else
+            it = m_cache.insert(std::make_pair(std::string(data, length), 1)).first;
+        asReleaseExclusiveLock();
+        return &it->first;
+    }
+
+    int ReleaseStringConstant(const void* str) override
+    {
+        int ret = asSUCCESS;
+        asAcquireExclusiveLock();
+        auto it = m_cache.find(*static_cast<const std::string*>(str));
+        if (it == m_cache.end())
+            ret = asERROR;
+        else if (--it->second == 0)
+            m_cache.erase(it);
+        asReleaseExclusiveLock();
+        return ret;
+    }
+
+    int GetRawStringData(const void* str, char* data, asUINT* length) const override
+    {
+        const std::string* s = static_cast<const std::string*>(str);
+        if (length)
+            *length = asUINT(s->length());
+        if (data)
+            memcpy(data, s->c_str(), s->length());
+        return asSUCCESS;
+    }
+
+private:
+    std::unordered_map<std::string, int> m_cache;
+};
+
+// ---------------------------- Workload -------------------------------
+
+static const size_t LITERAL_COUNT = 512;
+static const size_t THREAD_COUNTS[] = { 1, 2, 4, 8 };
+
+static std::vector<std::string> MakeLiterals()
+{
+    std::vector<std::string> literals;
+    for (size_t i = 0; i < LITERAL_COUNT; i++)
+    {
+        // A mix of short keys and longer messages, like typical script code
+        if (i % 4 == 0)
+            literals.push_back("Message number " + std::to_string(i) + " printed by the script");
+        else
+            literals.push_back("key_" + std::to_string(i));
+    }
+    return literals;
+}
+
+/// Runs `body(thread_index, count)` on `threads` threads, splitting `n` between them.
+template<class F> static void RunOnThreads(size_t threads, size_t n, F&& body)
+{
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; t++)
+    {
+        const size_t count = n / threads + ((t < n % threads) ? 1 : 0);
+        pool.emplace_back([&body, t, count]() { body(t, count); });
+    }
+    for (std::thread& th : pool)
+        th.join();
+}
+
+/// Each operation requests a constant and releases it again; half of the
+/// requests find it already cached by an outstanding reference of the same thread.
+static void InternLoop(asIStringFactory* factory, const std::vector<std::string>& literals, size_t thread_index, size_t count)
+{
+    const void* held = nullptr;
+    for (size_t i = 0; i < count; i++)
+    {
+        const std::string& lit = literals[(i * 7 + thread_index * 131) % literals.size()];
+        const void* str = factory->GetStringConstant(lit.data(), asUINT(lit.length()));
+        bench::DoNotOptimize(str);
+        if (held)
+            factory->ReleaseStringConstant(held);
+        held = str;
+    }
+    if (held)
+        factory->ReleaseStringConstant(held);
+}
+
+/// Requests every literal once, then releases them all.
+/// `held` is passed in so its allocation isn't counted.
+static void Populate(asIStringFactory* factory, const std::vector<std::string>& literals, std::vector<const void*>& held)
+{
+    held.clear();
+    for (const std::string& lit : literals)
+        held.push_back(factory->GetStringConstant(lit.data(), asUINT(lit.length())));
+    for (const void* str : held)
+        factory->ReleaseStringConstant(str);
+}
+
+static std::string MakeLiteralScript(size_t literals_per_func)
+{
+    std::string code = "string Concat(uint seed)\n{\n    string s;\n";
+    for (size_t i = 0; i < literals_per_func; i++)
+        code += "    if (seed == " + std::to_string(i) + ") s += \"literal value " + std::to_string(i) + "\";\n";
+    code += "    return s;\n}\n";
+    return code;
+}
+
+// ---------------------------- Engine ---------------------------------
+
+static void MessageCallback(const asSMessageInfo* msg, void* /*param*/)
+{
+    if (msg->type == asMSGTYPE_ERROR)
+        fprintf(stderr, "%s (%d, %d) : ERR  : %s\n", msg->section, msg->row, msg->col, msg->message);
+}
+
+static asIScriptEngine* CreateEngine()
+{
+    asIScriptEngine* engine = asCreateScriptEngine();
+    engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+    RegisterStdString(engine);
+    return engine;
+}
+
+static void BuildModule(asIScriptEngine* engine, const std::string& code)
+{
+    asIScriptModule* mod = engine->GetModule("bench", asGM_ALWAYS_CREATE);
+    mod->AddScriptSection("bench_stringfactory", code.c_str(), code.length());
+    if (mod->Build() < 0)
+    {
+        fprintf(stderr, "Build() failed\n");
+        exit(1);
+    }
+    mod->Discard();
+}
+
+int main(int argc, char** argv)
+{
+    bench::Runner runner("stringfactory", argc, argv);
+
+    // The factory of the add-on is a process-wide singleton, reachable through any engine using it.
+    // Keep one engine alive for the whole run so the singleton isn't torn down between cases.
+    asIScriptEngine* engine = CreateEngine();
+    asIStringFactory* sharded = engine->GetStringFactory();
+    assert(sharded);
+    LegacyStringFactory legacy;
+
+    const std::vector<std::string> literals = MakeLiterals();
+    char name[64];
+
+    for (size_t threads : THREAD_COUNTS)
+    {
+        snprintf(name, sizeof(name), "intern/legacy/threads:%zu", threads);
+        runner.Run(name, [&](size_t n) {
+            RunOnThreads(threads, n, [&](size_t t, size_t count) { InternLoop(&legacy, literals, t, count); });
+        });
+
+        snprintf(name, sizeof(name), "intern/sharded/threads:%zu", threads);
+        runner.Run(name, [&](size_t n) {
+            RunOnThreads(threads, n, [&](size_t t, size_t count) { InternLoop(sharded, literals, t, count); });
+        });
+    }
+
+    // Single threaded lookups of constants already in the cache, as when many modules use the same literals
+    struct { const char* name; asIStringFactory* factory; } factories[] = { { "legacy", &legacy }, { "sharded", sharded } };
+    for (const auto& f : factories)
+    {
+        std::vector<const void*> held;
+        for (const std::string& lit : literals)
+            held.push_back(f.factory->GetStringConstant(lit.data(), asUINT(lit.length())));
+
+        snprintf(name, sizeof(name), "lookup/hit/%s", f.name);
+        if (runner.Run(name, [&](size_t n) { InternLoop(f.factory, literals, 0, n); }))
+        {
+            const size_t calls = 10000;
+            const size_t allocs_before = g_alloc_count.load();
+            InternLoop(f.factory, literals, 0, calls);
+            runner.AddCounter("allocs_per_op", double(g_alloc_count.load() - allocs_before) / calls);
+        }
+
+        for (const void* str : held)
+            f.factory->ReleaseStringConstant(str);
+    }
+
+    // Filling the cache from empty; the counters come from the first fill, before any memory is reused
+    const size_t POPULATE_COUNTS[] = { 10000, 100000, 500000 };
+    for (size_t count : POPULATE_COUNTS)
+    {
+        std::vector<std::string> distinct;
+        distinct.reserve(count);
+        for (size_t i = 0; i < count; i++)
+            distinct.push_back(((i % 4 == 0) ? "populate message number " : "populate_") + std::to_string(count) + "_" + std::to_string(i));
+
+        for (const auto& f : factories)
+        {
+            snprintf(name, sizeof(name), "populate/%s/constants:%zu", f.name, count);
+            if (!runner.IsSelected(name))
+                continue;
+
+            std::vector<const void*> held;
+            held.reserve(count);
+            const size_t allocs_before = g_alloc_count.load();
+            const size_t bytes_before = g_alloc_bytes.load();
+            Populate(f.factory, distinct, held);
+            const double allocs = double(g_alloc_count.load() - allocs_before);
+            const double bytes = double(g_alloc_bytes.load() - bytes_before);
+
+            runner.Run(name, [&](size_t n) {
+                for (size_t i = 0; i < n; i++)
+                    Populate(f.factory, distinct, held);
+            });
+            runner.AddCounter("allocs_per_constant", allocs / count);
+            runner.AddCounter("bytes_per_constant", bytes / count);
+        }
+    }
+
+    // Building is much slower than interning, one engine per thread reused across builds
+    const std::string code = MakeLiteralScript(LITERAL_COUNT);
+    for (size_t threads : THREAD_COUNTS)
+    {
+        std::vector<asIScriptEngine*> engines;
+        for (size_t t = 0; t < threads; t++)
+            engines.push_back(CreateEngine());
+
+        snprintf(name, sizeof(name), "build/threads:%zu", threads);
+        runner.Run(name, [&](size_t n) {
+            RunOnThreads(threads, n, [&](size_t t, size_t count) {
+                for (size_t i = 0; i < count; i++)
+                    BuildModule(engines[t], code);
+            });
+        });
+
+        for (asIScriptEngine* e : engines)
+            e->ShutDownAndRelease();
+    }
+
+    engine->ShutDownAndRelease();
+
+    return runner.Finish();
+}
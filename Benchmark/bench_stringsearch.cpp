@@ -0,0 +1,175 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+// Throughput of the search functions behind the find family of the `string`
+// add-on (Testbed/scriptstringsearch.cpp), per implementation level against
+// std::string_view, on generated text of 1 KB, 64 KB and 4 MB. The needles and
+// sets don't occur in the text, so each call scans the whole haystack, except
+// `tokenize`, which splits the text into words with findFirstNotOf()/findFirstOf()
+// like a script tokenizer does. Each case reports `gb_per_s`.
+// No script engine is created.
+
+#include "bench.h"
+
+#include "scriptstringsearch.h"
+
+#include <string>
+#include <string_view>
+
+// ---------------------------- Haystacks ------------------------------
+
+/// Lowercase words separated by spaces, commas and newlines.
+static std::string MakeText(size_t length)
+{
+    std::string text;
+    text.reserve(length);
+    unsigned seed = 12345;
+    while (text.size() < length)
+    {
+        seed = seed * 1103515245u + 12345u;
+        const size_t word_length = 2 + (seed >> 16) % 9;
+        for (size_t i = 0; i < word_length && text.size() < length; i++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            text += char('a' + (seed >> 16) % 26);
+        }
+        if (text.size() < length)
+            text += ((seed >> 8) % 16 == 0) ? '\n' : ((seed >> 8) % 8 == 0 ? ',' : ' ');
+    }
+    return text;
+}
+
+struct Haystack
+{
+    const char* name;
+    size_t      length;
+};
+
+static const Haystack HAYSTACKS[] =
+{
+    { "1KB",  1024 },
+    { "64KB", 64 * 1024 },
+    { "4MB",  4 * 1024 * 1024 },
+};
+
+static const char NEEDLE[]      = "quantum!";                 // '!' never occurs
+static const char SET_SMALL[]   = "#$%&";                     // Fits the SSE2 byte compares
+static const char SET_LARGE[]   = "0123456789#$%&*@+-=<>";    // Needs the bitmap
+static const char SET_TEXT[]    = "abcdefghijklmnopqrstuvwxyz ,\n";
+static const char DELIMITERS[]  = " ,\n";
+
+// -------------------------- Implementations --------------------------
+
+struct Search
+{
+    size_t (*find)(const char*, size_t, const char*, size_t, size_t);
+    size_t (*find_last)(const char*, size_t, const char*, size_t, size_t);
+    size_t (*find_first_of)(const char*, size_t, const char*, size_t, size_t);
+    size_t (*find_first_not_of)(const char*, size_t, const char*, size_t, size_t);
+    size_t (*find_last_of)(const char*, size_t, const char*, size_t, size_t);
+};
+
+static size_t StdFind(const char* s, size_t n, const char* sub, size_t sub_n, size_t start)
+{
+    return std::string_view(s, n).find(std::string_view(sub, sub_n), start);
+}
+
+static size_t StdFindLast(const char* s, size_t n, const char* sub, size_t sub_n, size_t start)
+{
+    return std::string_view(s, n).rfind(std::string_view(sub, sub_n), start);
+}
+
+static size_t StdFindFirstOf(const char* s, size_t n, const char* set, size_t set_n, size_t start)
+{
+    return std::string_view(s, n).find_first_of(std::string_view(set, set_n), start);
+}
+
+static size_t StdFindFirstNotOf(const char* s, size_t n, const char* set, size_t set_n, size_t start)
+{
+    return std::string_view(s, n).find_first_not_of(std::string_view(set, set_n), start);
+}
+
+static size_t StdFindLastOf(const char* s, size_t n, const char* set, size_t set_n, size_t start)
+{
+    return std::string_view(s, n).find_last_of(std::string_view(set, set_n), start);
+}
+
+static const Search STD_SEARCH = { StdFind, StdFindLast, StdFindFirstOf, StdFindFirstNotOf, StdFindLastOf };
+static const Search ADDON_SEARCH = { StringSearchFind, StringSearchFindLast, StringSearchFindFirstOf,
+                                     StringSearchFindFirstNotOf, StringSearchFindLastOf };
+
+struct Implementation
+{
+    const char* name;
+    int         level; // -1 for std::string_view
+};
+
+static const Implementation IMPLEMENTATIONS[] =
+{
+    { "std",    -1 },
+    { "scalar", STRING_SEARCH_SCALAR },
+    { "sse2",   STRING_SEARCH_SSE2 },
+    { "avx2",   STRING_SEARCH_AVX2 },
+};
+
+// ------------------------------ Cases --------------------------------
+
+template<class F>
+static void RunCase(bench::Runner& runner, const std::string& name, size_t bytes, F&& call)
+{
+    if (!runner.Run(name.c_str(), [&](size_t n) { for (size_t i = 0; i < n; i++) bench::DoNotOptimize(call()); }))
+        return;
+    runner.AddCounter("gb_per_s", double(bytes) / runner.LastNsPerOp());
+}
+
+static void RunCases(bench::Runner& runner, const Implementation& impl, const Search& search, const Haystack& haystack)
+{
+    const std::string text = MakeText(haystack.length);
+    const char* s = text.data();
+    const size_t n = text.size();
+    const std::string suffix = std::string("/") + haystack.name + "/" + impl.name;
+
+    RunCase(runner, "find" + suffix, n, [&] { return search.find(s, n, NEEDLE, sizeof(NEEDLE) - 1, 0); });
+    RunCase(runner, "find_last" + suffix, n, [&] { return search.find_last(s, n, NEEDLE, sizeof(NEEDLE) - 1, std::string::npos); });
+    RunCase(runner, "first_of_small" + suffix, n, [&] { return search.find_first_of(s, n, SET_SMALL, sizeof(SET_SMALL) - 1, 0); });
+    RunCase(runner, "first_of_large" + suffix, n, [&] { return search.find_first_of(s, n, SET_LARGE, sizeof(SET_LARGE) - 1, 0); });
+    RunCase(runner, "first_not_of" + suffix, n, [&] { return search.find_first_not_of(s, n, SET_TEXT, sizeof(SET_TEXT) - 1, 0); });
+    RunCase(runner, "last_of_small" + suffix, n, [&] { return search.find_last_of(s, n, SET_SMALL, sizeof(SET_SMALL) - 1, std::string::npos); });
+
+    RunCase(runner, "tokenize" + suffix, n, [&] {
+        size_t tokens = 0;
+        for (size_t pos = search.find_first_not_of(s, n, DELIMITERS, sizeof(DELIMITERS) - 1, 0); pos != std::string::npos; )
+        {
+            const size_t end = search.find_first_of(s, n, DELIMITERS, sizeof(DELIMITERS) - 1, pos);
+            tokens++;
+            if (end == std::string::npos)
+                break;
+            pos = search.find_first_not_of(s, n, DELIMITERS, sizeof(DELIMITERS) - 1, end);
+        }
+        return tokens;
+    });
+}
+
+int main(int argc, char** argv)
+{
+    bench::Runner runner("stringsearch", argc, argv);
+
+    fprintf(stderr, "supported level: %d\n", int(GetSupportedStringSearchLevel()));
+    for (const Haystack& haystack : HAYSTACKS)
+    {
+        for (const Implementation& impl : IMPLEMENTATIONS)
+        {
+            if (impl.level >= 0)
+            {
+                SetStringSearchLevel(EStringSearchLevel(impl.level));
+                if (GetStringSearchLevel() != impl.level)
+                    continue; // Not supported by this CPU
+            }
+            RunCases(runner, impl, impl.level < 0 ? STD_SEARCH : ADDON_SEARCH, haystack);
+        }
+    }
+
+    return runner.Finish();
+}
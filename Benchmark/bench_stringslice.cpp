@@ -0,0 +1,211 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+// A log parsing script run on 5k generated lines such as
+//   2022-05-01T12:34:56 WARN worker=17 latency=123.45 bytes=4096 path=/api/items/42
+// which counts the errors and sums up the `latency` and `bytes` fields. The same
+// script is run with `string` and substr(), which creates a string for every
+// line, key and value, and with `string_slice` (Testbed/scriptstringslice.cpp),
+// which copies the text once per run. Each case parses the whole text once per
+// iteration and reports `mb_per_s` and the heap allocations as `allocs_per_op`.
+
+#include "bench.h"
+
+#include <angelscript.h>
+#include "scriptstdstring.h"
+#include "scriptstringslice.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+// -------------------------- Allocation counting ----------------------
+
+// Both types allocate with operator new, the engine's own memory isn't counted
+static std::atomic<size_t> g_alloc_count(0);
+
+void* operator new(size_t size)
+{
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// ------------------------------ Input --------------------------------
+
+static const int LINES = 5000;
+
+static std::string MakeLog()
+{
+    static const char* LEVELS[] = { "INFO", "INFO", "INFO", "WARN", "ERROR" };
+
+    std::string text;
+    unsigned seed = 12345;
+    for (int line = 0; line < LINES; line++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        char buf[160];
+        snprintf(buf, sizeof(buf), "2022-05-01T%02u:%02u:%02u %s worker=%u latency=%u.%02u bytes=%u path=/api/items/%u\n",
+            (seed >> 4) % 24, (seed >> 9) % 60, (seed >> 15) % 60, LEVELS[(seed >> 20) % 5],
+            (seed >> 3) % 32, (seed >> 7) % 1000, (seed >> 11) % 100, (seed >> 13) % 65536, (seed >> 17) % 1000);
+        text += buf;
+    }
+    return text;
+}
+
+// ------------------------------ Script -------------------------------
+
+// The same parser for either type, TYPE being `string` or `string_slice`
+static std::string MakeScript(const std::string& type)
+{
+    std::string script = R"(
+double NAME_latency;
+int64 NAME_bytes;
+
+uint Parse_NAME()
+{
+    TYPE all = text;
+    uint errors = 0;
+    NAME_latency = 0;
+    NAME_bytes = 0;
+
+    uint pos = 0;
+    while (pos < all.length())
+    {
+        int end = all.findFirst("\n", pos);
+        if (end < 0)
+            end = int(all.length());
+        TYPE line = all.substr(pos, end - int(pos));
+        pos = uint(end) + 1;
+
+        // Timestamp and level
+        int levelStart = line.findFirst(" ") + 1;
+        int levelEnd = line.findFirst(" ", uint(levelStart));
+        TYPE level = line.substr(uint(levelStart), levelEnd - levelStart);
+        if (level == "ERROR")
+            errors++;
+
+        // key=value fields
+        uint field = uint(levelEnd) + 1;
+        while (field < line.length())
+        {
+            int fieldEnd = line.findFirst(" ", field);
+            if (fieldEnd < 0)
+                fieldEnd = int(line.length());
+            int eq = line.findFirst("=", field);
+            TYPE key = line.substr(field, eq - int(field));
+            TYPE value = line.substr(uint(eq) + 1, fieldEnd - eq - 1);
+            if (key == "latency")
+                NAME_latency += parseFloat(value);
+            else if (key == "bytes")
+                NAME_bytes += parseInt(value);
+            field = uint(fieldEnd) + 1;
+        }
+    }
+    return errors;
+}
+)";
+
+    const std::string name = type == "string" ? "substr" : "slice";
+    for (size_t pos; (pos = script.find("NAME")) != std::string::npos; )
+        script.replace(pos, 4, name);
+    for (size_t pos; (pos = script.find("TYPE")) != std::string::npos; )
+        script.replace(pos, 4, type);
+    return script;
+}
+
+static const char* CASES[] =
+{
+    "substr",
+    "slice",
+};
+
+// ---------------------------- Engine ---------------------------------
+
+static void MessageCallback(const asSMessageInfo* msg, void* /*param*/)
+{
+    const char* type = "ERR ";
+    if (msg->type == asMSGTYPE_WARNING)
+        type = "WARN";
+    else if (msg->type == asMSGTYPE_INFORMATION)
+        type = "INFO";
+
+    fprintf(stderr, "%s (%d, %d) : %s : %s\n", msg->section, msg->row, msg->col, type, msg->message);
+}
+
+static void Execute(asIScriptContext* ctx, asIScriptFunction* func)
+{
+    ctx->Prepare(func);
+    int r = ctx->Execute();
+    if (r != asEXECUTION_FINISHED)
+    {
+        fprintf(stderr, "%s: execution failed (%d)\n", func->GetDeclaration(), r);
+        exit(1);
+    }
+    bench::DoNotOptimize(ctx->GetReturnDWord());
+}
+
+int main(int argc, char** argv)
+{
+    bench::Runner runner("stringslice", argc, argv);
+
+    asIScriptEngine* engine = asCreateScriptEngine();
+    engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+    RegisterStdString(engine);
+    RegisterStringSlice(engine);
+
+    const std::string script = "string text;\n" + MakeScript("string") + MakeScript("string_slice");
+    asIScriptModule* mod = engine->GetModule("bench", asGM_ALWAYS_CREATE);
+    mod->AddScriptSection("bench_stringslice", script.c_str(), script.size());
+    if (mod->Build() < 0)
+    {
+        fprintf(stderr, "Build() failed\n");
+        return 1;
+    }
+
+    const std::string log = MakeLog();
+    *static_cast<std::string*>(mod->GetAddressOfGlobalVar(mod->GetGlobalVarIndexByName("text"))) = log;
+
+    asIScriptContext* ctx = engine->CreateContext();
+
+    for (const char* name : CASES)
+    {
+        asIScriptFunction* func = mod->GetFunctionByName((std::string("Parse_") + name).c_str());
+        assert(func);
+
+        if (!runner.Run(name, [&](size_t n) { for (size_t i = 0; i < n; i++) Execute(ctx, func); }))
+            continue;
+        runner.AddCounter("mb_per_s", double(log.size()) / runner.LastNsPerOp() * 1e3);
+
+        const size_t allocs_before = g_alloc_count.load();
+        Execute(ctx, func);
+        runner.AddCounter("allocs_per_op", double(g_alloc_count.load() - allocs_before));
+    }
+
+    // Both parsers must agree
+    double latency[2];
+    asINT64 bytes[2];
+    for (int n = 0; n < 2; n++)
+    {
+        latency[n] = *static_cast<double*>(mod->GetAddressOfGlobalVar(mod->GetGlobalVarIndexByName(n ? "slice_latency" : "substr_latency")));
+        bytes[n] = *static_cast<asINT64*>(mod->GetAddressOfGlobalVar(mod->GetGlobalVarIndexByName(n ? "slice_bytes" : "substr_bytes")));
+    }
+    if (runner.IsSelected("substr") && runner.IsSelected("slice") && (latency[0] != latency[1] || bytes[0] != bytes[1]))
+    {
+        fprintf(stderr, "The parsers disagree\n");
+        return 1;
+    }
+
+    ctx->Release();
+    engine->ShutDownAndRelease();
+
+    return runner.Finish();
+}
@@ -36,6 +36,10 @@ void CustomizedPtrTest()
     Print("# create null customized handle\n");
     HorsePtr@ ref3 = null;
     
+    Print("# Format customized handles\n");
+    Print(format("`format(\"{{}}\", ref1)`: {}\n", ref1));
+    Print(format("`format(\"{{}}\", ref3)`: {}\n", ref3));
+
     Print("# Test equality on null/notnull customized handles\n");
     Print("`(ref2 == ref3)`: " + (ref2 == ref3) + "\n");
     Print("`(@ref2 == @ref3)`: " + (@ref2 == @ref3) + "\n");    
@@ -142,6 +146,40 @@ void AppInterfaceCustomizedPtrTest()
     // ho
 }
 
+void SlotMapHandleTest()
+{
+    Print("# creating horse with a slot map handle\n");
+    HorseHandle h1 = HorseHandle(Horse()); // "Binky"
+    Print("`h1.valid()`: " + h1.valid() + "\n");
+
+    Print("# copying slot map handle\n");
+    HorseHandle h2 = h1;
+    Print("`(h1 == h2)`: " + (h1 == h2) + "\n");
+
+    Print("# getting horse from slot map handle\n");
+    h2.get().Neigh();
+
+    Print("# removing horse from slot map - object will be deleted\n");
+    h1.remove();
+
+    Print("# Test stale slot map handle\n");
+    Print("`h2.valid()`: " + h2.valid() + "\n");
+    Print("`(h2.get() is null)`: " + (h2.get() is null) + "\n");
+
+    Print("# putting unreferenced horse to stable\n");
+    PutToStable(Horse()); // "Tornado"
+
+    Print("# fetching slot map handle of the horse in stable\n");
+    HorseHandle h3 = FetchHandleFromStable();
+    h3.get().Neigh();
+
+    Print("# removing horse from slot map\n");
+    h3.remove();
+
+    Print("# Dump horse from stable - object will be deleted\n");
+    PutToStable(null);
+}
+
 void ExampleAngelScript()
 {
     Print("##  BEGIN native handle test\n");
@@ -159,6 +197,10 @@ void ExampleAngelScript()
     Print("##  BEGIN app interface + Customized handle test\n");
     AppInterfaceCustomizedPtrTest();
     Print("##  END app interface + Customized handle test\n");
+
+    Print("##  BEGIN slot map handle test\n");
+    SlotMapHandleTest();
+    Print("##  END slot map handle test\n");
     
      
     Print("# Create parrot\n");
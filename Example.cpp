@@ -1,6 +1,7 @@
 
 #include "RefCountingObject.h"
 #include "RefCountingObjectPtr.h"
+#include "RefCountingObjectHandle.h"
 
 #include <string>
 #include <vector>
@@ -22,6 +23,7 @@ public:
 
 typedef RefCountingObjectPtr<Horse> HorsePtr;
 typedef RefCountingObjectPtr<Parrot> ParrotPtr;
+typedef RefCountingObjectHandle<Horse> HorseHandle;
 
 Horse* HorseFactory()
 {
@@ -56,6 +58,14 @@ HorsePtr FetchFromStable()
     return g_stable;
 }
 
+HorseHandle FetchHandleFromStable()
+{
+    std::cout << __FUNCTION__ << " called"  << std::endl;
+
+    // Adds the horse to the slot map, unless it's there already
+    return HorseHandle(g_stable);
+}
+
 void PutToAviary(ParrotPtr parrot)
 {
     std::cout << __FUNCTION__ << " called with '" << parrot.GetRef() << "'" << std::endl;
@@ -96,9 +106,12 @@ void ExampleCpp(asIScriptEngine *engine)
     r = engine->RegisterObjectBehaviour("Horse", asBEHAVE_FACTORY, "Horse@ f()", asFUNCTION(HorseFactory), asCALL_CDECL); assert( r >= 0 );
     // Register handle type
     HorsePtr::RegisterRefCountingObjectPtr("HorsePtr", "Horse", engine);
+    // Register slot map handle type
+    HorseHandle::RegisterRefCountingObjectHandle("HorseHandle", "Horse", engine);
     // Registering example interface
     r = engine->RegisterGlobalFunction("void PutToStable(HorsePtr@ h)", asFUNCTION(PutToStable), asCALL_CDECL); assert( r >= 0 );
     r = engine->RegisterGlobalFunction("HorsePtr@ FetchFromStable()", asFUNCTION(FetchFromStable), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("HorseHandle FetchHandleFromStable()", asFUNCTION(FetchHandleFromStable), asCALL_CDECL); assert( r >= 0 );
 
     // -- Parrot --
     // Registering the reference type
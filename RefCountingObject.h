@@ -7,11 +7,15 @@
 
 #include <angelscript.h>
 #include <cassert>
+#include <type_traits>
 
 #if !defined(RefCoutingObject_DEBUGTRACE)
-#   define RefCoutingObject_DEBUGTRACE
+#   define RefCoutingObject_DEBUGTRACE()
 #endif
 
+template<class T> class NoCountObject;
+template<class T> class ScopedObject;
+
 /// Self reference-counting objects, as requred by AngelScript garbage collector.
 template<class T> class RefCountingObject
 {
@@ -44,6 +48,9 @@ public:
 
     static void  RegisterRefCountingObject(const char* name, asIScriptEngine *engine)
     {
+        static_assert(!std::is_base_of<NoCountObject<T>, T>::value && !std::is_base_of<ScopedObject<T>, T>::value,
+            "A class is either refcounted, NoCountObject or ScopedObject");
+
         int r;
         // Registering the reference type
         r = engine->RegisterObjectType(name, 0, asOBJ_REF); assert( r >= 0 );
@@ -55,3 +62,45 @@ public:
 
     int m_refcount = 1; // Initial refcount for any angelscript object.
 };
+
+/// Objects owned by the application, e.g. singletons, registered as `asOBJ_NOCOUNT`.
+/// Scripts can hold handles, but the engine never calls AddRef()/Release(), so the
+/// object must outlive all scripts using it. Can't be used with RefCountingObjectPtr.
+template<class T> class NoCountObject
+{
+public:
+    static void  RegisterNoCountObject(const char* name, asIScriptEngine *engine)
+    {
+        static_assert(std::is_base_of<NoCountObject<T>, T>::value, "T must derive from NoCountObject<T>");
+        static_assert(!std::is_base_of<RefCountingObject<T>, T>::value && !std::is_base_of<ScopedObject<T>, T>::value,
+            "A class is either refcounted, NoCountObject or ScopedObject");
+
+        int r;
+        r = engine->RegisterObjectType(name, 0, asOBJ_REF | asOBJ_NOCOUNT); assert( r >= 0 );
+    }
+};
+
+/// Objects living in a single script scope, e.g. helpers declared as local variables,
+/// registered as `asOBJ_SCOPED`. The variable owns the object and deletes it when it goes
+/// out of scope; scripts can't take handles to it, so there's nothing to count.
+/// The factory, returning a new object, is registered by the application as for RefCountingObject.
+/// Can't be used with RefCountingObjectPtr.
+template<class T> class ScopedObject
+{
+public:
+    static void  RegisterScopedObject(const char* name, asIScriptEngine *engine)
+    {
+        static_assert(std::is_base_of<ScopedObject<T>, T>::value, "T must derive from ScopedObject<T>");
+        static_assert(!std::is_base_of<RefCountingObject<T>, T>::value && !std::is_base_of<NoCountObject<T>, T>::value,
+            "A class is either refcounted, NoCountObject or ScopedObject");
+
+        int r;
+        r = engine->RegisterObjectType(name, 0, asOBJ_REF | asOBJ_SCOPED); assert( r >= 0 );
+
+        // Called once, when the variable goes out of scope
+        r = engine->RegisterObjectBehaviour(name, asBEHAVE_RELEASE, "void f()", asFUNCTION(ScopedObject::Destroy), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+    }
+
+protected:
+    static void Destroy(T* self) { delete self; }
+};
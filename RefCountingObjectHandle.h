@@ -0,0 +1,246 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+#pragma once
+
+#include "RefCountingObject.h"
+#include "RefCountingObjectPtr.h"
+
+#include <angelscript.h>
+#include <cassert>
+#include <cstdio> // snprintf()
+#include <new>    // placement new
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+template<class T> class RefCountingObjectHandle;
+
+/// Per-type registry of objects addressed by RefCountingObjectHandle.
+/// The objects are kept densely in one array, holding a reference each, so systems
+/// updating all objects of a type walk contiguous memory (with PooledRefCountingObject,
+/// the objects themselves are also close together). Each object has a slot with
+/// a generation number, which changes when the object is removed, so that stale handles
+/// are detected with a single array lookup.
+///
+/// Not thread safe: use from the thread which runs the scripts.
+template<class T> class RefCountingObjectSlotMap
+{
+public:
+    /// Adds a reference to the object; an object which is already in the map gets its existing handle.
+    static RefCountingObjectHandle<T> Insert(T* obj)
+    {
+        static_assert(std::is_base_of<RefCountingObject<T>, T>::value, "T must derive from RefCountingObject<T>");
+
+        if (!obj)
+            return RefCountingObjectHandle<T>();
+
+        RefCountingObjectSlotMap& map = Instance();
+        auto found = map.m_lookup.find(obj);
+        if (found != map.m_lookup.end())
+            return RefCountingObjectHandle<T>(found->second, map.m_slots[found->second].generation);
+
+        asUINT slot_index;
+        if (map.m_freeSlots.empty())
+        {
+            slot_index = asUINT(map.m_slots.size());
+            map.m_slots.push_back(Slot());
+        }
+        else
+        {
+            slot_index = map.m_freeSlots.back();
+            map.m_freeSlots.pop_back();
+        }
+
+        Slot& slot = map.m_slots[slot_index];
+        slot.object = asUINT(map.m_objects.size());
+        map.m_objects.push_back(obj);
+        map.m_objectSlots.push_back(slot_index);
+        map.m_lookup[obj] = slot_index;
+        obj->AddRef();
+        return RefCountingObjectHandle<T>(slot_index, slot.generation);
+    }
+
+    /// Releases the map's reference and invalidates all handles to the object.
+    /// Returns false if the handle was already stale.
+    static bool Remove(const RefCountingObjectHandle<T>& handle)
+    {
+        RefCountingObjectSlotMap& map = Instance();
+        if (!map.IsValid(handle))
+            return false;
+
+        Slot& slot = map.m_slots[handle.GetIndex()];
+        T* obj = map.m_objects[slot.object];
+
+        // Move the last object into the gap
+        const asUINT last = asUINT(map.m_objects.size() - 1);
+        map.m_objects[slot.object] = map.m_objects[last];
+        map.m_objectSlots[slot.object] = map.m_objectSlots[last];
+        map.m_slots[map.m_objectSlots[slot.object]].object = slot.object;
+        map.m_objects.pop_back();
+        map.m_objectSlots.pop_back();
+
+        // A slot whose generation would wrap around is retired, so old handles never become valid again
+        slot.generation++;
+        if (slot.generation != GENERATION_MAX)
+            map.m_freeSlots.push_back(handle.GetIndex());
+
+        map.m_lookup.erase(obj);
+        obj->Release();
+        return true;
+    }
+
+    /// The object, without adding a reference, or null for a stale handle.
+    static T* Get(const RefCountingObjectHandle<T>& handle)
+    {
+        RefCountingObjectSlotMap& map = Instance();
+        return map.IsValid(handle) ? map.m_objects[map.m_slots[handle.GetIndex()].object] : nullptr;
+    }
+
+    static bool IsValid(const RefCountingObjectHandle<T>& handle)
+    {
+        return Instance().IsValidSlot(handle);
+    }
+
+    /// All objects in the map, in no particular order. Invalidated by Insert() and Remove().
+    static T* const* GetObjects() { return Instance().m_objects.data(); }
+    static size_t    GetCount()   { return Instance().m_objects.size(); }
+
+    /// Removes all objects, e.g. before the script engine is shut down.
+    static void Clear()
+    {
+        RefCountingObjectSlotMap& map = Instance();
+        while (!map.m_objects.empty())
+        {
+            const asUINT slot_index = map.m_objectSlots.back();
+            Remove(RefCountingObjectHandle<T>(slot_index, map.m_slots[slot_index].generation));
+        }
+    }
+
+private:
+    static const asUINT GENERATION_MAX = 0xFFFFFFFFu;
+
+    struct Slot
+    {
+        asUINT object = 0;     ///< Index in m_objects while in use
+        asUINT generation = 1; ///< Zero is reserved for the null handle
+    };
+
+    bool IsValidSlot(const RefCountingObjectHandle<T>& handle) const
+    {
+        return handle.GetIndex() < m_slots.size() && m_slots[handle.GetIndex()].generation == handle.GetGeneration();
+    }
+
+    /// Never destroyed: handles may be used by other statics during exit. Use Clear() to release the objects.
+    static RefCountingObjectSlotMap& Instance()
+    {
+        static RefCountingObjectSlotMap* map = new RefCountingObjectSlotMap();
+        return *map;
+    }
+
+    std::vector<Slot>              m_slots;
+    std::vector<asUINT>            m_freeSlots;
+    std::vector<T*>                m_objects;     ///< Dense, each holds a reference
+    std::vector<asUINT>            m_objectSlots; ///< Slot of each object, to update it when objects move
+    std::unordered_map<T*, asUINT> m_lookup;      ///< Slot of each object, for Insert()
+};
+
+/// Alternative to RefCountingObjectPtr: a 64-bit generational index into RefCountingObjectSlotMap<T>
+/// rather than a reference. It doesn't keep the object alive; the object lives until it's removed
+/// from the map (and released by everyone else), after which all handles to it are stale
+/// and return null, which makes use-after-free easy to detect. Registered as a POD script value type,
+/// so copying it costs nothing. Converts to and from RefCountingObjectPtr, for application interfaces.
+template<class T> class RefCountingObjectHandle
+{
+public:
+    RefCountingObjectHandle(): m_index(0), m_generation(0) {}
+    RefCountingObjectHandle(asUINT index, asUINT generation): m_index(index), m_generation(generation) {}
+    /// Inserts the object into the slot map if it isn't there yet.
+    explicit RefCountingObjectHandle(RefCountingObjectPtr<T> ptr) { *this = RefCountingObjectSlotMap<T>::Insert(ptr.GetRef()); }
+
+    bool operator==(const RefCountingObjectHandle<T> &o) const { return m_index == o.m_index && m_generation == o.m_generation; }
+    bool operator!=(const RefCountingObjectHandle<T> &o) const { return !(*this == o); }
+
+    bool IsValid() const { return RefCountingObjectSlotMap<T>::IsValid(*this); }
+    /// Null for a stale handle; no reference is added.
+    T* Get() const { return RefCountingObjectSlotMap<T>::Get(*this); }
+    RefCountingObjectPtr<T> GetPtr() const;
+    /// See RefCountingObjectSlotMap::Remove()
+    bool Remove() const { return RefCountingObjectSlotMap<T>::Remove(*this); }
+
+    asUINT GetIndex() const { return m_index; }
+    asUINT GetGeneration() const { return m_generation; }
+
+    static void RegisterRefCountingObjectHandle(const char* handle_name, const char* obj_name, asIScriptEngine *engine);
+
+protected:
+    // Wrapper functions, to be invoked by AngelScript only!
+    static void ConstructDefault(RefCountingObjectHandle<T> *self) { new(self) RefCountingObjectHandle(); }
+    static void ConstructRef(RefCountingObjectHandle<T> *self, T* ref);
+    static T* GetRef(RefCountingObjectHandle<T> *self);
+
+    asUINT m_index;
+    asUINT m_generation;
+};
+
+template<class T>
+void RefCountingObjectHandle<T>::RegisterRefCountingObjectHandle(const char* handle_name, const char* obj_name, asIScriptEngine *engine)
+{
+    static_assert(std::is_base_of<RefCountingObject<T>, T>::value, "T must derive from RefCountingObject<T>");
+
+    int r;
+    const size_t DECLBUF_MAX = 300;
+    char decl_buf[DECLBUF_MAX];
+
+    // Plain data, copied and compared as two integers
+    r = engine->RegisterObjectType(handle_name, sizeof(RefCountingObjectHandle), asOBJ_VALUE | asOBJ_POD | asOBJ_APP_CLASS_ALLINTS | asGetTypeTraits<RefCountingObjectHandle>()); assert( r >= 0 );
+
+    // construct
+    r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_CONSTRUCT, "void f()", asFUNCTION(RefCountingObjectHandle::ConstructDefault), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+    snprintf(decl_buf, DECLBUF_MAX, "void f(%s@)", obj_name);
+    r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_CONSTRUCT, decl_buf, asFUNCTION(RefCountingObjectHandle::ConstructRef), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+
+    // Access
+    r = engine->RegisterObjectMethod(handle_name, "bool valid() const", asMETHOD(RefCountingObjectHandle, IsValid), asCALL_THISCALL); assert( r >= 0 );
+    snprintf(decl_buf, DECLBUF_MAX, "%s@ get() const", obj_name);
+    r = engine->RegisterObjectMethod(handle_name, decl_buf, asFUNCTION(RefCountingObjectHandle::GetRef), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+    r = engine->RegisterObjectMethod(handle_name, "bool remove() const", asMETHOD(RefCountingObjectHandle, Remove), asCALL_THISCALL); assert( r >= 0 );
+
+    // Equals
+    snprintf(decl_buf, DECLBUF_MAX, "bool opEquals(const %s &in) const", handle_name);
+    r = engine->RegisterObjectMethod(handle_name, decl_buf, asMETHODPR(RefCountingObjectHandle, operator==, (const RefCountingObjectHandle &) const, bool), asCALL_THISCALL); assert( r >= 0 );
+}
+
+// ---------------------------- Internals ------------------------------
+
+template<class T>
+inline RefCountingObjectPtr<T> RefCountingObjectHandle<T>::GetPtr() const
+{
+    T* ref = Get();
+    // The raw pointer constructor doesn't add a reference, see RefCountingObjectPtr.
+    if (ref)
+        ref->AddRef();
+    return RefCountingObjectPtr<T>(ref);
+}
+
+template<class T>
+inline void RefCountingObjectHandle<T>::ConstructRef(RefCountingObjectHandle<T> *self, T* ref)
+{
+    new(self) RefCountingObjectHandle(RefCountingObjectSlotMap<T>::Insert(ref));
+
+    // The handle parameter was passed in with a reference added for us.
+    if (ref)
+        ref->Release();
+}
+
+template<class T>
+inline T* RefCountingObjectHandle<T>::GetRef(RefCountingObjectHandle<T> *self)
+{
+    // The returned handle must carry its own reference.
+    T* ref = self->Get();
+    if (ref)
+        ref->AddRef();
+    return ref;
+}
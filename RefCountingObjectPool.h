@@ -0,0 +1,231 @@
+
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+
+#pragma once
+
+#include "RefCountingObject.h"
+
+#include <angelscript.h>
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+struct RefCountingObjectPoolStats
+{
+    size_t slabs = 0;
+    size_t slots = 0;       ///< Total slots in all slabs
+    size_t slotsInUse = 0;
+};
+
+/// Slots for objects of a single type, carved from slabs which are kept for reuse.
+/// Freed slots go to a free list, which is used before carving new ones.
+/// Thread safe; a bulk allocation takes the lock once.
+template<class T> class RefCountingObjectPool
+{
+public:
+    static const size_t SLAB_SLOTS = 256;
+
+    /// Allocates `count` slots. Slots carved from a slab are contiguous, and a request
+    /// bigger than SLAB_SLOTS gets a slab of its own, so that it's one allocation.
+    static void Allocate(T** slots, size_t count)
+    {
+        RefCountingObjectPool& pool = Instance();
+        std::lock_guard<std::mutex> lock(pool.m_mutex);
+
+        if (count > pool.m_freeCount + pool.m_slabRemaining)
+        {
+            // May throw, before anything is taken
+            size_t slab_slots = SLAB_SLOTS;
+            if (count - pool.m_freeCount > slab_slots)
+                slab_slots = count - pool.m_freeCount;
+            if (slab_slots > MAX_SLAB_SLOTS)
+                throw std::bad_alloc();
+            char* slab = static_cast<char*>(::operator new(slab_slots * SLOT_SIZE));
+
+            // The rest of the current slab goes to the free list
+            for (; pool.m_slabRemaining > 0; pool.m_slabRemaining--, pool.m_slabCursor += SLOT_SIZE)
+            {
+                pool.PushFree(pool.m_slabCursor);
+            }
+            pool.m_slabCursor = slab;
+            pool.m_slabRemaining = slab_slots;
+            pool.m_slabs++;
+            pool.m_slots += slab_slots;
+        }
+
+        size_t i = 0;
+        for (; i < count && pool.m_free; i++)
+        {
+            slots[i] = static_cast<T*>(static_cast<void*>(pool.m_free));
+            pool.m_free = pool.m_free->next;
+            pool.m_freeCount--;
+        }
+        for (; i < count; i++, pool.m_slabRemaining--, pool.m_slabCursor += SLOT_SIZE)
+        {
+            slots[i] = static_cast<T*>(static_cast<void*>(pool.m_slabCursor));
+        }
+        pool.m_slotsInUse += count;
+    }
+
+    static void Free(void* ptr)
+    {
+        RefCountingObjectPool& pool = Instance();
+        std::lock_guard<std::mutex> lock(pool.m_mutex);
+
+        pool.PushFree(ptr);
+        pool.m_slotsInUse--;
+    }
+
+    static RefCountingObjectPoolStats GetStats()
+    {
+        RefCountingObjectPool& pool = Instance();
+        std::lock_guard<std::mutex> lock(pool.m_mutex);
+
+        RefCountingObjectPoolStats stats;
+        stats.slabs = pool.m_slabs;
+        stats.slots = pool.m_slots;
+        stats.slotsInUse = pool.m_slotsInUse;
+        return stats;
+    }
+
+private:
+    struct FreeSlot
+    {
+        FreeSlot* next;
+    };
+
+    static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types can't be pooled");
+    static const size_t SLOT_ALIGN = (alignof(T) > alignof(FreeSlot)) ? alignof(T) : alignof(FreeSlot);
+    static const size_t SLOT_SIZE = ((sizeof(T) > sizeof(FreeSlot) ? sizeof(T) : sizeof(FreeSlot)) + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+    /// Bigger slabs would overflow `slab_slots * SLOT_SIZE`
+    static const size_t MAX_SLAB_SLOTS = size_t(-1) / SLOT_SIZE;
+
+    void PushFree(void* ptr)
+    {
+        FreeSlot* slot = static_cast<FreeSlot*>(ptr);
+        slot->next = m_free;
+        m_free = slot;
+        m_freeCount++;
+    }
+
+    /// Never destroyed: objects may be released by other statics during exit.
+    static RefCountingObjectPool& Instance()
+    {
+        static RefCountingObjectPool* pool = new RefCountingObjectPool();
+        return *pool;
+    }
+
+    std::mutex m_mutex;
+    FreeSlot*  m_free = nullptr;
+    size_t     m_freeCount = 0;
+    char*      m_slabCursor = nullptr;
+    size_t     m_slabRemaining = 0;
+    size_t     m_slabs = 0;
+    size_t     m_slots = 0;
+    size_t     m_slotsInUse = 0;
+};
+
+/// RefCountingObject allocated from a RefCountingObjectPool, with a bulk factory
+/// creating many objects in one call. Each object is still released on its own.
+///
+/// Derived classes of T which are bigger than T are allocated from the heap as usual.
+template<class T> class PooledRefCountingObject: public RefCountingObject<T>
+{
+public:
+    static void* operator new(size_t size)
+    {
+        if (size != sizeof(T))
+            return ::operator new(size);
+
+        T* slot;
+        RefCountingObjectPool<T>::Allocate(&slot, 1);
+        return slot;
+    }
+
+    static void operator delete(void* ptr, size_t size)
+    {
+        if (size != sizeof(T))
+            ::operator delete(ptr);
+        else
+            RefCountingObjectPool<T>::Free(ptr);
+    }
+
+    /// Creates `count` default constructed objects, each holding its initial reference.
+    /// If a constructor throws, the objects created so far are released, `objects` is nulled.
+    /// Throws std::bad_alloc, with nothing created, if the slots can't be allocated.
+    static void CreateMany(T** objects, size_t count)
+    {
+        static_assert(std::is_base_of<PooledRefCountingObject<T>, T>::value, "T must derive from PooledRefCountingObject<T>");
+
+        RefCountingObjectPool<T>::Allocate(objects, count);
+        size_t i = 0;
+        try
+        {
+            for (; i < count; i++)
+                objects[i] = ::new (static_cast<void*>(objects[i])) T();
+        }
+        catch (...)
+        {
+            for (size_t j = 0; j < count; j++)
+            {
+                if (j < i)
+                    objects[j]->Release();
+                else
+                    RefCountingObjectPool<T>::Free(objects[j]);
+                objects[j] = nullptr;
+            }
+            throw;
+        }
+    }
+
+    /// Registers `decl`, e.g. `array<Horse@>@ CreateHorses(uint n)`, as a global function
+    /// returning a new array of `n` new objects. `Array` is the `CScriptArray` of the array add-on;
+    /// it's a parameter so that this header doesn't depend on the add-on.
+    template<class Array> static void RegisterBulkFactory(const char* decl, asIScriptEngine *engine)
+    {
+        int r;
+        r = engine->RegisterGlobalFunction(decl, asFUNCTION(BulkFactory<Array>), asCALL_GENERIC); assert( r >= 0 );
+
+        // The objects are constructed in place of the array's handles
+        asITypeInfo* type = engine->GetTypeInfoById(engine->GetFunctionById(r)->GetReturnTypeId());
+        assert( type && (type->GetSubTypeId() & asTYPEID_OBJHANDLE) );
+        (void)type;
+    }
+
+private:
+    template<class Array> static void BulkFactory(asIScriptGeneric* gen)
+    {
+        // The array type, as declared by the registered function
+        asIScriptEngine* engine = gen->GetEngine();
+        asITypeInfo* type = engine->GetTypeInfoById(gen->GetFunction()->GetReturnTypeId());
+        asUINT count = gen->GetArgDWord(0);
+
+        // Filled with null handles; sets a script exception if too big
+        Array* array = Array::Create(type, count);
+        if (array && count > 0)
+        {
+            try
+            {
+                // The array may have come back without its buffer, if that couldn't be allocated
+                if (array->GetSize() != count || !array->At(0))
+                    throw std::bad_alloc();
+
+                // The array takes over the initial references
+                CreateMany(static_cast<T**>(array->At(0)), count);
+            }
+            catch (...)
+            {
+                array->Release();
+                array = nullptr;
+                asIScriptContext* ctx = asGetActiveContext();
+                if (ctx && ctx->GetState() != asEXECUTION_EXCEPTION)
+                    ctx->SetException("Failed to create the objects");
+            }
+        }
+        *static_cast<Array**>(gen->GetAddressOfReturnLocation()) = array;
+    }
+};
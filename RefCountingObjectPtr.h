@@ -7,11 +7,16 @@
 
 #pragma once
 
+#include "RefCountingObject.h"
+
 #include <angelscript.h>
 #include <cassert>
+#include <cstdio> // snprintf()
+#include <new>    // placement new
+#include <type_traits>
 
 #if !defined(RefCoutingObjectPtr_DEBUGTRACE)
-#   define RefCoutingObjectPtr_DEBUGTRACE
+#   define RefCoutingObjectPtr_DEBUGTRACE(_arg_)
 #endif
 
 template<class T>
@@ -64,6 +69,8 @@ protected:
 template<class T>
 void RefCountingObjectPtr<T>::RegisterRefCountingObjectPtr(const char* handle_name, const char* obj_name, asIScriptEngine *engine)
 {
+    static_assert(std::is_base_of<RefCountingObject<T>, T>::value, "T must derive from RefCountingObject<T>");
+
     int r;
     const size_t DECLBUF_MAX = 300;
     char decl_buf[DECLBUF_MAX];
@@ -172,6 +179,9 @@ inline RefCountingObjectPtr<T>::RefCountingObjectPtr(T *ref)
 template<class T>
 inline RefCountingObjectPtr<T>::~RefCountingObjectPtr()
 {
+    // Not in the class body: T may be incomplete there, e.g. a pointer member of T itself.
+    // Rejects NoCountObject and ScopedObject types, whose handles mustn't be counted.
+    static_assert(std::is_base_of<RefCountingObject<T>, T>::value, "T must derive from RefCountingObject<T>");
     RefCoutingObjectPtr_DEBUGTRACE(nullptr);
     ReleaseHandle();
 }
@@ -12,6 +12,9 @@
 #endif
 #include <angelscript.h>
 #include "scriptstdstring.h"
+#include "scriptstringformat.h"
+#include "scriptprintsink.h"
+#include "scriptallocator.h"
 
 using namespace std;
 
@@ -63,6 +66,14 @@ void LineCallback(asIScriptContext *ctx, DWORD *timeOut);
 // Function prototypes implemented in "example.cpp"
 void ExampleCpp(asIScriptEngine *engine);
 
+// The output of Print() is written to stdout by a thread of its own, so the
+// script doesn't wait on the terminal. The sink writes to the original stream
+// buffer of std::cout; while the script runs, std::cout itself goes through the
+// sink, so the traces of debug_log.h and Example.cpp keep their order with Print().
+std::ostream              stdoutStream(std::cout.rdbuf());
+CScriptPrintSink          printSink(stdoutStream);
+CScriptPrintSinkStreamBuf printSinkBuf(printSink);
+
 int main(int argc, char **argv)
 {
 	RunApplication();
@@ -90,6 +101,10 @@ int RunApplication()
 {
 	int r;
 
+	// The engine's memory goes through the size class allocator. This must be
+	// done before the engine is created, as it allocates from the start.
+	InstallScriptAllocator();
+
 	// Create the script engine
 	asIScriptEngine *engine = asCreateScriptEngine();
 	if( engine == 0 )
@@ -168,8 +183,16 @@ int RunApplication()
 	// Execute the function
 	std::cout << "Executing the script." << std::endl;
 	std::cout << "---" << std::endl;
+	std::streambuf *coutBuf = std::cout.rdbuf(&printSinkBuf);
+	printSink.Start();
 	r = ctx->Execute();
+	printSink.Stop();
+	std::cout.rdbuf(coutBuf);
 	std::cout << "---" << std::endl;
+
+	SScriptPrintSinkStats printStats = printSink.GetStats();
+	if( printStats.droppedMessages > 0 )
+		std::cout << "Print() output dropped: " << printStats.droppedMessages << " calls, " << printStats.droppedBytes << " bytes." << std::endl;
 	if( r != asEXECUTION_FINISHED )
 	{
 		// The execution didn't finish as we had planned. Determine why.
@@ -208,6 +231,7 @@ void ConfigureEngine(asIScriptEngine *engine)
 	// Look at the implementation for this function for more information  
 	// on how to register a custom string type, and other object types.
 	RegisterStdString(engine);
+	RegisterStringFormat(engine);
 
 	if( !strstr(asGetLibraryOptions(), "AS_MAX_PORTABILITY") )
 	{
@@ -323,14 +347,14 @@ void LineCallback(asIScriptContext *ctx, DWORD *timeOut)
 // Function implementation with native calling convention
 void PrintString(string &str)
 {
-	std::cout << str;
+	printSink.Write(str);
 }
 
 // Function implementation with generic script interface
 void PrintString_Generic(asIScriptGeneric *gen)
 {
 	string *str = (string*)gen->GetArgAddress(0);
-	std::cout << *str;
+	printSink.Write(*str);
 }
 
 // Function wrapper is needed when native calling conventions are not supported
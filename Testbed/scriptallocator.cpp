@@ -0,0 +1,642 @@
+#include "scriptallocator.h"
+#include <assert.h>  // assert()
+#include <stdlib.h>  // malloc(), free()
+#include <iomanip>   // std::setw()
+#include <mutex>
+#include <new>       // placement new
+
+using namespace std;
+
+BEGIN_AS_NAMESPACE
+
+static const size_t CLASS_SIZES[SCRIPTALLOCATOR_CLASS_COUNT] =
+{
+	16, 32, 48, 64, 80, 96, 112, 128,
+	160, 192, 224, 256,
+	320, 384, 448, 512,
+	640, 768, 896, 1024
+};
+
+static const size_t MAX_CLASS_SIZE = 1024;
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+// Keeps the blocks 16 byte aligned, as malloc's are
+static const size_t HEADER_SIZE = 16;
+
+// The kinds of blocks other than the size classes
+static const asUINT BLOCK_LARGE = 0x100;
+static const asUINT BLOCK_PASSTHROUGH = 0x200; // The size class is in the low bits
+static const asUINT BLOCK_ARENA = 0x400;
+
+struct SBlockHeader
+{
+	asUINT kind;
+	union
+	{
+		CScriptContextArena::SChunk *arenaChunk; // BLOCK_ARENA
+		void                *next;  // Next free block of the size class, while free
+	};
+};
+
+static inline SBlockHeader *HeaderOf(void *ptr)
+{
+	return reinterpret_cast<SBlockHeader*>(static_cast<char*>(ptr) - HEADER_SIZE);
+}
+
+static inline void *PayloadOf(SBlockHeader *header)
+{
+	return reinterpret_cast<char*>(header) + HEADER_SIZE;
+}
+
+static inline asUINT SizeClass(size_t size)
+{
+	if (size <= 128)
+		return size == 0 ? 0 : asUINT((size - 1) >> 4);
+	if (size <= 256)
+		return 8 + asUINT((size - 129) >> 5);
+	if (size <= 512)
+		return 12 + asUINT((size - 257) >> 6);
+	return 16 + asUINT((size - 513) >> 7);
+}
+
+// Blocks moved between a thread and the shared list at a time, about 4 KiB
+static inline asUINT BatchSize(asUINT sizeClass)
+{
+	size_t blocks = 4096 / (HEADER_SIZE + CLASS_SIZES[sizeClass]);
+	return blocks < 4 ? 4 : asUINT(blocks);
+}
+
+// Only the owning thread writes a counter, so there's no need for an atomic
+// increment; the atomic only makes reading it from GetScriptAllocatorStats() safe
+static inline void Count(atomic<asQWORD> &counter)
+{
+	counter.store(counter.load(memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+struct SCounters
+{
+	atomic<asQWORD> allocations[SCRIPTALLOCATOR_CLASS_COUNT];
+	atomic<asQWORD> frees[SCRIPTALLOCATOR_CLASS_COUNT];
+	atomic<asQWORD> largeAllocations;
+	atomic<asQWORD> largeFrees;
+	atomic<asQWORD> passThroughAllocations;
+	atomic<asQWORD> passThroughFrees;
+	atomic<asQWORD> arenaAllocations;
+	atomic<asQWORD> arenaFrees;
+	atomic<asQWORD> arenaRewinds;
+	atomic<asQWORD> arenaFallbacks;
+
+	SCounters()
+	{
+		for (asUINT n = 0; n < SCRIPTALLOCATOR_CLASS_COUNT; n++)
+		{
+			allocations[n] = 0;
+			frees[n] = 0;
+		}
+		largeAllocations = 0;
+		largeFrees = 0;
+		passThroughAllocations = 0;
+		passThroughFrees = 0;
+		arenaAllocations = 0;
+		arenaFrees = 0;
+		arenaRewinds = 0;
+		arenaFallbacks = 0;
+	}
+
+	void AddTo(SScriptAllocatorStats &stats) const
+	{
+		for (asUINT n = 0; n < SCRIPTALLOCATOR_CLASS_COUNT; n++)
+		{
+			stats.classes[n].allocations += allocations[n].load(memory_order_relaxed);
+			stats.classes[n].frees += frees[n].load(memory_order_relaxed);
+		}
+		stats.largeAllocations += largeAllocations.load(memory_order_relaxed);
+		stats.largeFrees += largeFrees.load(memory_order_relaxed);
+		stats.passThroughAllocations += passThroughAllocations.load(memory_order_relaxed);
+		stats.passThroughFrees += passThroughFrees.load(memory_order_relaxed);
+		stats.arenaAllocations += arenaAllocations.load(memory_order_relaxed);
+		stats.arenaFrees += arenaFrees.load(memory_order_relaxed);
+		stats.arenaRewinds += arenaRewinds.load(memory_order_relaxed);
+		stats.arenaFallbacks += arenaFallbacks.load(memory_order_relaxed);
+	}
+};
+
+struct SThreadCache;
+
+// The blocks shared between the threads
+struct SCentral
+{
+	struct SClass
+	{
+		SClass() : head(0), cursor(0), end(0), blocksReserved(0) {}
+
+		mutex        lock;
+		SBlockHeader *head;    // Free blocks returned by the threads
+		char         *cursor;  // Not yet carved part of the current chunk
+		char         *end;
+		asQWORD       blocksReserved;
+	};
+
+	SCentral() : passThrough(false), reservedBytes(0) {}
+
+	SClass                classes[SCRIPTALLOCATOR_CLASS_COUNT];
+	atomic<bool>          passThrough;
+	atomic<size_t>        reservedBytes;
+
+	// Guards the list of thread caches
+	mutex                 cachesLock;
+	vector<SThreadCache*> caches;
+	SCounters             exited; // Of the threads that have exited, and of threads while they exit
+};
+
+// Never destroyed, as the engine may free memory after the static objects are gone
+static SCentral &Central()
+{
+	static SCentral *central = new SCentral();
+	return *central;
+}
+
+struct SThreadCache
+{
+	struct SClass
+	{
+		SBlockHeader *head;
+		asUINT        count;
+	};
+
+	SThreadCache();
+	~SThreadCache();
+
+	SClass    classes[SCRIPTALLOCATOR_CLASS_COUNT];
+	SCounters counters;
+};
+
+// Set once the cache of the thread is gone, e.g. for memory freed by other
+// thread_local objects during thread exit
+static thread_local bool threadCacheDestroyed = false;
+static thread_local SThreadCache threadCache;
+
+// The arena of the context executing on this thread, set by CScriptContextArenaScope.
+// The allocator must not ask the engine, as that may allocate in turn.
+static thread_local CScriptContextArena *threadArena = 0;
+
+// Takes up to `count` blocks off the shared list, carving new ones if needed
+static SBlockHeader *TakeFromCentral(asUINT sizeClass, asUINT count, asUINT &taken)
+{
+	SCentral &central = Central();
+	SCentral::SClass &shared = central.classes[sizeClass];
+	size_t stride = HEADER_SIZE + CLASS_SIZES[sizeClass];
+
+	SBlockHeader *head = 0;
+	taken = 0;
+
+	lock_guard<mutex> lock(shared.lock);
+	while (taken < count && shared.head)
+	{
+		SBlockHeader *block = shared.head;
+		shared.head = static_cast<SBlockHeader*>(block->next);
+		block->next = head;
+		head = block;
+		taken++;
+	}
+	while (taken < count)
+	{
+		if (shared.cursor == 0 || shared.cursor + stride > shared.end)
+		{
+			char *chunk = static_cast<char*>(malloc(CHUNK_SIZE));
+			if (chunk == 0)
+				break;
+			central.reservedBytes.fetch_add(CHUNK_SIZE, memory_order_relaxed);
+			shared.cursor = chunk;
+			shared.end = chunk + CHUNK_SIZE;
+		}
+		SBlockHeader *block = reinterpret_cast<SBlockHeader*>(shared.cursor);
+		shared.cursor += stride;
+		shared.blocksReserved++;
+		block->next = head;
+		head = block;
+		taken++;
+	}
+	return head;
+}
+
+// Returns the blocks from `head` to `tail` to the shared list
+static void ReturnToCentral(asUINT sizeClass, SBlockHeader *head, SBlockHeader *tail)
+{
+	SCentral::SClass &shared = Central().classes[sizeClass];
+	lock_guard<mutex> lock(shared.lock);
+	tail->next = shared.head;
+	shared.head = head;
+}
+
+SThreadCache::SThreadCache()
+{
+	for (asUINT n = 0; n < SCRIPTALLOCATOR_CLASS_COUNT; n++)
+	{
+		classes[n].head = 0;
+		classes[n].count = 0;
+	}
+
+	SCentral &central = Central();
+	lock_guard<mutex> lock(central.cachesLock);
+	central.caches.push_back(this);
+}
+
+SThreadCache::~SThreadCache()
+{
+	threadCacheDestroyed = true;
+
+	for (asUINT n = 0; n < SCRIPTALLOCATOR_CLASS_COUNT; n++)
+	{
+		SBlockHeader *head = classes[n].head;
+		if (head == 0)
+			continue;
+		SBlockHeader *tail = head;
+		while (tail->next)
+			tail = static_cast<SBlockHeader*>(tail->next);
+		ReturnToCentral(n, head, tail);
+	}
+
+	SCentral &central = Central();
+	lock_guard<mutex> lock(central.cachesLock);
+	for (size_t n = 0; n < central.caches.size(); n++)
+	{
+		if (central.caches[n] == this)
+		{
+			central.caches.erase(central.caches.begin() + n);
+			break;
+		}
+	}
+
+	SScriptAllocatorStats mine = SScriptAllocatorStats();
+	counters.AddTo(mine);
+	SCounters &exited = central.exited;
+	for (asUINT n = 0; n < SCRIPTALLOCATOR_CLASS_COUNT; n++)
+	{
+		exited.allocations[n] += mine.classes[n].allocations;
+		exited.frees[n] += mine.classes[n].frees;
+	}
+	exited.largeAllocations += mine.largeAllocations;
+	exited.largeFrees += mine.largeFrees;
+	exited.passThroughAllocations += mine.passThroughAllocations;
+	exited.passThroughFrees += mine.passThroughFrees;
+	exited.arenaAllocations += mine.arenaAllocations;
+	exited.arenaFrees += mine.arenaFrees;
+	exited.arenaRewinds += mine.arenaRewinds;
+	exited.arenaFallbacks += mine.arenaFallbacks;
+}
+
+// Counts on the thread's counters, or the shared ones once its cache is gone
+static inline void CountForThread(atomic<asQWORD> SCounters::*counter)
+{
+	if (!threadCacheDestroyed)
+		Count(threadCache.counters.*counter);
+	else
+		(Central().exited.*counter).fetch_add(1, memory_order_relaxed);
+}
+
+void *ScriptAllocatorAlloc(size_t size)
+{
+	SCentral &central = Central();
+
+	if (size <= CScriptContextArena::MAX_BLOCK_SIZE && threadArena)
+	{
+		void *ptr = threadArena->Allocate(size);
+		if (ptr)
+			return ptr;
+	}
+
+	if (size > MAX_CLASS_SIZE || central.passThrough.load(memory_order_relaxed))
+	{
+		SBlockHeader *header = static_cast<SBlockHeader*>(malloc(HEADER_SIZE + size));
+		if (header == 0)
+			return 0;
+		if (size > MAX_CLASS_SIZE)
+		{
+			header->kind = BLOCK_LARGE;
+			CountForThread(&SCounters::largeAllocations);
+		}
+		else
+		{
+			header->kind = BLOCK_PASSTHROUGH | SizeClass(size);
+			CountForThread(&SCounters::passThroughAllocations);
+		}
+		return PayloadOf(header);
+	}
+
+	asUINT sizeClass = SizeClass(size);
+	SBlockHeader *block;
+	if (!threadCacheDestroyed)
+	{
+		SThreadCache &cache = threadCache;
+		SThreadCache::SClass &local = cache.classes[sizeClass];
+		if (local.head == 0)
+			local.head = TakeFromCentral(sizeClass, BatchSize(sizeClass), local.count);
+		block = local.head;
+		if (block == 0)
+			return 0;
+		local.head = static_cast<SBlockHeader*>(block->next);
+		local.count--;
+		Count(cache.counters.allocations[sizeClass]);
+	}
+	else
+	{
+		asUINT taken;
+		block = TakeFromCentral(sizeClass, 1, taken);
+		if (block == 0)
+			return 0;
+		central.exited.allocations[sizeClass].fetch_add(1, memory_order_relaxed);
+	}
+
+	block->kind = sizeClass;
+	return PayloadOf(block);
+}
+
+void ScriptAllocatorFree(void *ptr)
+{
+	if (ptr == 0)
+		return;
+
+	SBlockHeader *header = HeaderOf(ptr);
+	asUINT kind = header->kind;
+
+	if (kind < SCRIPTALLOCATOR_CLASS_COUNT)
+	{
+		if (!threadCacheDestroyed)
+		{
+			SThreadCache &cache = threadCache;
+			SThreadCache::SClass &local = cache.classes[kind];
+			header->next = local.head;
+			local.head = header;
+			Count(cache.counters.frees[kind]);
+
+			// Give a batch back, so blocks freed by another thread than the one
+			// allocating them don't pile up here
+			asUINT batch = BatchSize(kind);
+			if (++local.count > 2 * batch)
+			{
+				SBlockHeader *tail = local.head;
+				for (asUINT n = 1; n < batch; n++)
+					tail = static_cast<SBlockHeader*>(tail->next);
+				SBlockHeader *head = local.head;
+				local.head = static_cast<SBlockHeader*>(tail->next);
+				local.count -= batch;
+				ReturnToCentral(kind, head, tail);
+			}
+		}
+		else
+		{
+			header->next = 0;
+			ReturnToCentral(kind, header, header);
+			Central().exited.frees[kind].fetch_add(1, memory_order_relaxed);
+		}
+		return;
+	}
+
+	if (kind == BLOCK_ARENA)
+	{
+		CScriptContextArena::Free(header->arenaChunk);
+		CountForThread(&SCounters::arenaFrees);
+		return;
+	}
+
+	if (kind == BLOCK_LARGE)
+		CountForThread(&SCounters::largeFrees);
+	else
+		CountForThread(&SCounters::passThroughFrees);
+	free(header);
+}
+
+int InstallScriptAllocator()
+{
+	// Sets up the shared state before the engine can call from several threads
+	Central();
+	return asSetGlobalMemoryFunctions(ScriptAllocatorAlloc, ScriptAllocatorFree);
+}
+
+void SetScriptAllocatorPassThrough(bool passThrough)
+{
+	Central().passThrough = passThrough;
+}
+
+void GetScriptAllocatorStats(SScriptAllocatorStats &stats)
+{
+	SCentral &central = Central();
+
+	stats = SScriptAllocatorStats();
+	for (asUINT n = 0; n < SCRIPTALLOCATOR_CLASS_COUNT; n++)
+	{
+		stats.classes[n].blockSize = CLASS_SIZES[n];
+		lock_guard<mutex> lock(central.classes[n].lock);
+		stats.classes[n].blocksReserved = central.classes[n].blocksReserved;
+	}
+	stats.reservedBytes = central.reservedBytes.load(memory_order_relaxed);
+
+	lock_guard<mutex> lock(central.cachesLock);
+	central.exited.AddTo(stats);
+	for (size_t n = 0; n < central.caches.size(); n++)
+		central.caches[n]->counters.AddTo(stats);
+	stats.threads = asUINT(central.caches.size());
+}
+
+void WriteScriptAllocatorStats(ostream &out)
+{
+	SScriptAllocatorStats stats;
+	GetScriptAllocatorStats(stats);
+
+	out << setw(8) << "size" << setw(14) << "allocations" << setw(14) << "frees"
+		<< setw(10) << "in use" << setw(10) << "reserved" << "\n";
+	for (asUINT n = 0; n < SCRIPTALLOCATOR_CLASS_COUNT; n++)
+	{
+		const SScriptAllocatorClassStats &c = stats.classes[n];
+		if (c.allocations == 0 && c.blocksReserved == 0)
+			continue;
+		out << setw(8) << c.blockSize << setw(14) << c.allocations << setw(14) << c.frees
+			<< setw(10) << c.allocations - c.frees << setw(10) << c.blocksReserved << "\n";
+	}
+	out << setw(8) << "large" << setw(14) << stats.largeAllocations << setw(14) << stats.largeFrees
+		<< setw(10) << stats.largeAllocations - stats.largeFrees << "\n";
+	if (stats.passThroughAllocations)
+		out << setw(8) << "malloc" << setw(14) << stats.passThroughAllocations << setw(14) << stats.passThroughFrees
+			<< setw(10) << stats.passThroughAllocations - stats.passThroughFrees << "\n";
+	if (stats.arenaAllocations)
+		out << setw(8) << "arena" << setw(14) << stats.arenaAllocations << setw(14) << stats.arenaFrees
+			<< setw(10) << stats.arenaAllocations - stats.arenaFrees << "\n";
+	out << "reserved: " << stats.reservedBytes / 1024 << " KiB, threads: " << stats.threads
+		<< ", arena rewinds: " << stats.arenaRewinds << ", arena fallbacks: " << stats.arenaFallbacks << "\n";
+}
+
+//--------------------------------------------------------------------------
+// CScriptContextArena
+
+struct CScriptContextArena::SChunk
+{
+	CScriptContextArena *arena;
+	atomic<asQWORD>      live; // Blocks in use
+};
+
+// The blocks of a chunk start after its SChunk, 16 byte aligned
+static const size_t ARENA_CHUNK_HEADER_SIZE = 16;
+
+CScriptContextArena::CScriptContextArena(size_t chunkSize, size_t maxChunks)
+	: m_chunkSize(chunkSize)
+	, m_maxChunks(maxChunks)
+	, m_chunk(0)
+	, m_offset(0)
+	, m_attached(true)
+	, m_refs(1)
+{
+	static_assert(sizeof(SChunk) <= ARENA_CHUNK_HEADER_SIZE, "SChunk doesn't fit before the blocks");
+}
+
+CScriptContextArena::~CScriptContextArena()
+{
+	for (size_t n = 0; n < m_chunks.size(); n++)
+	{
+		m_chunks[n]->~SChunk();
+		free(m_chunks[n]);
+	}
+	Central().reservedBytes.fetch_sub(m_chunks.size() * m_chunkSize, memory_order_relaxed);
+}
+
+CScriptContextArena *CScriptContextArena::Attach(asIScriptContext *ctx, size_t chunkSize, size_t maxChunks)
+{
+	CScriptContextArena *arena = Get(ctx);
+	if (arena)
+		return arena;
+
+	// Room for at least a few of the largest blocks
+	if (chunkSize < ARENA_CHUNK_HEADER_SIZE + 4 * (HEADER_SIZE + MAX_BLOCK_SIZE))
+		chunkSize = ARENA_CHUNK_HEADER_SIZE + 4 * (HEADER_SIZE + MAX_BLOCK_SIZE);
+	if (maxChunks < 1)
+		maxChunks = 1;
+
+	arena = new CScriptContextArena(chunkSize, maxChunks);
+	ctx->SetUserData(arena, SCRIPTALLOCATOR_ARENA_UDATA);
+	ctx->GetEngine()->SetContextUserDataCleanupCallback(CleanupContext, SCRIPTALLOCATOR_ARENA_UDATA);
+	return arena;
+}
+
+void CScriptContextArena::Detach(asIScriptContext *ctx)
+{
+	CScriptContextArena *arena = Get(ctx);
+	if (arena == 0)
+		return;
+
+	ctx->SetUserData(0, SCRIPTALLOCATOR_ARENA_UDATA);
+	arena->m_attached = false;
+	arena->Release();
+}
+
+CScriptContextArena *CScriptContextArena::Get(asIScriptContext *ctx)
+{
+	return static_cast<CScriptContextArena*>(ctx->GetUserData(SCRIPTALLOCATOR_ARENA_UDATA));
+}
+
+void CScriptContextArena::CleanupContext(asIScriptContext *ctx)
+{
+	Detach(ctx);
+}
+
+void *CScriptContextArena::Allocate(size_t size)
+{
+	size_t needed = HEADER_SIZE + ((size + 15) & ~size_t(15));
+
+	// Nothing in the current chunk is in use, so start it over. Blocks are only
+	// freed after this, so whoever freed the last one is done with the memory (acquire).
+	if (m_offset > 0 && m_chunks[m_chunk]->live.load(memory_order_acquire) == 0)
+	{
+		m_offset = 0;
+		CountForThread(&SCounters::arenaRewinds);
+	}
+
+	if (m_chunks.empty() || ARENA_CHUNK_HEADER_SIZE + m_offset + needed > m_chunkSize)
+	{
+		if (!NextChunk())
+		{
+			CountForThread(&SCounters::arenaFallbacks);
+			return 0;
+		}
+	}
+
+	SChunk *chunk = m_chunks[m_chunk];
+	SBlockHeader *header = reinterpret_cast<SBlockHeader*>(reinterpret_cast<char*>(chunk) + ARENA_CHUNK_HEADER_SIZE + m_offset);
+	m_offset += needed;
+	header->kind = BLOCK_ARENA;
+	header->arenaChunk = chunk;
+	chunk->live.fetch_add(1, memory_order_relaxed);
+	m_refs.fetch_add(1, memory_order_relaxed);
+	CountForThread(&SCounters::arenaAllocations);
+	return PayloadOf(header);
+}
+
+// Moves on to a chunk with no blocks in use, or a new one. Returns false if
+// all chunks are in use and there may be no more.
+bool CScriptContextArena::NextChunk()
+{
+	for (size_t n = 1; n < m_chunks.size(); n++)
+	{
+		size_t index = (m_chunk + n) % m_chunks.size();
+		if (m_chunks[index]->live.load(memory_order_acquire) == 0)
+		{
+			m_chunk = index;
+			m_offset = 0;
+			CountForThread(&SCounters::arenaRewinds);
+			return true;
+		}
+	}
+
+	if (m_chunks.size() >= m_maxChunks)
+		return false;
+
+	void *memory = malloc(m_chunkSize);
+	if (memory == 0)
+		return false;
+	SChunk *chunk = new(memory) SChunk;
+	chunk->arena = this;
+	chunk->live.store(0, memory_order_relaxed);
+	m_chunks.push_back(chunk);
+	Central().reservedBytes.fetch_add(m_chunkSize, memory_order_relaxed);
+
+	m_chunk = m_chunks.size() - 1;
+	m_offset = 0;
+	return true;
+}
+
+void CScriptContextArena::Free(SChunk *chunk)
+{
+	// The chunk may be reused as soon as its count is down, but the arena is
+	// kept alive by the block until Release()
+	CScriptContextArena *arena = chunk->arena;
+	chunk->live.fetch_sub(1, memory_order_release);
+	arena->Release();
+}
+
+void CScriptContextArena::Release()
+{
+	// The last of the blocks and the attachment deletes the arena
+	if (m_refs.fetch_sub(1, memory_order_acq_rel) == 1)
+		delete this;
+}
+
+//--------------------------------------------------------------------------
+// CScriptContextArenaScope
+
+CScriptContextArenaScope::CScriptContextArenaScope(asIScriptContext *ctx)
+	: m_arena(CScriptContextArena::Get(ctx))
+	, m_previous(threadArena)
+{
+	// Keeps the arena alive if the context is detached or destroyed meanwhile
+	if (m_arena)
+		m_arena->m_refs.fetch_add(1, memory_order_relaxed);
+	threadArena = m_arena;
+}
+
+CScriptContextArenaScope::~CScriptContextArenaScope()
+{
+	threadArena = m_previous;
+	if (m_arena)
+		m_arena->Release();
+}
+
+END_AS_NAMESPACE
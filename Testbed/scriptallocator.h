@@ -0,0 +1,159 @@
+//
+// Script allocator
+//
+// Memory functions for asSetGlobalMemoryFunctions(). Without them all the
+// engine's own allocations, i.e. bytecode, contexts and their stacks, script
+// objects and their members, go to malloc.
+//
+// - Requests up to 1024 bytes are served from 20 size classes. Each thread
+//   keeps a few free blocks per class and only takes a lock to move a batch
+//   of blocks from or to the shared lists when its own run empty or full.
+//   Blocks are carved from 64 KiB chunks, which are kept for reuse rather
+//   than returned to the system.
+// - Larger requests go to malloc.
+// - A context can have a bump arena attached (CScriptContextArena). Requests
+//   up to 256 bytes made while that context executes within a
+//   CScriptContextArenaScope, e.g. for the script objects it creates, then take
+//   the next bytes of the arena's current chunk.
+//   Each chunk counts its blocks in use, and is started over once they have
+//   all been freed. Meant for contexts that run short callbacks creating lots
+//   of temporary objects. Objects that outlive the call are still fine: they
+//   only keep their own chunk from being reused. Once all of the arena's
+//   chunks hold such objects and it has as many as it may, further requests go
+//   to the size classes until a chunk is free again.
+//
+// Every block has a 16 byte header saying where it came from, so a block can
+// be freed from any thread, and the two modes of SetScriptAllocatorPassThrough()
+// can be switched at any time.
+//
+// The statistics by size class are counted per thread, with no shared atomics
+// on the way, and summed by GetScriptAllocatorStats().
+//
+// InstallScriptAllocator() must be called before the first asCreateScriptEngine().
+//
+
+#ifndef SCRIPTALLOCATOR_H
+#define SCRIPTALLOCATOR_H
+
+#ifndef ANGELSCRIPT_H
+// Avoid having to inform include path if header is already include before
+#include <angelscript.h>
+#endif
+
+#include <atomic>
+#include <ostream>
+#include <vector>
+
+BEGIN_AS_NAMESPACE
+
+// User data slot holding the arena of a context
+const asPWORD SCRIPTALLOCATOR_ARENA_UDATA = 2004;
+
+const asUINT SCRIPTALLOCATOR_CLASS_COUNT = 20;
+
+struct SScriptAllocatorClassStats
+{
+	size_t  blockSize;
+	asQWORD allocations;
+	asQWORD frees;
+	asQWORD blocksReserved; // Carved from chunks so far
+};
+
+struct SScriptAllocatorStats
+{
+	SScriptAllocatorClassStats classes[SCRIPTALLOCATOR_CLASS_COUNT];
+	asQWORD largeAllocations; // Over the largest size class, from malloc
+	asQWORD largeFrees;
+	asQWORD passThroughAllocations; // Of size class sizes, from malloc with SetScriptAllocatorPassThrough()
+	asQWORD passThroughFrees;
+	asQWORD arenaAllocations;
+	asQWORD arenaFrees;
+	asQWORD arenaRewinds;     // Arena chunks started over
+	asQWORD arenaFallbacks;   // Arena requests sent to the size classes, as all chunks were in use
+	size_t  reservedBytes;    // Chunks of the size classes and the arenas
+	asUINT  threads;          // Threads that currently have a cache of free blocks
+};
+
+// Installs ScriptAllocatorAlloc()/ScriptAllocatorFree() as the engine's memory functions
+int   InstallScriptAllocator();
+void *ScriptAllocatorAlloc(size_t size);
+void  ScriptAllocatorFree(void *ptr);
+
+// Sends all requests to malloc, still counted by size class, e.g. to compare
+void  SetScriptAllocatorPassThrough(bool passThrough);
+
+void  GetScriptAllocatorStats(SScriptAllocatorStats &stats);
+// A table of the size classes with their allocations and blocks in use
+void  WriteScriptAllocatorStats(std::ostream &out);
+
+class CScriptContextArena
+{
+public:
+	// Larger requests go to the size classes
+	static const size_t MAX_BLOCK_SIZE = 256;
+
+	// The arena is detached when the context is destroyed, or with Detach().
+	// It reserves at most `maxChunks` chunks of `chunkSize` bytes.
+	static CScriptContextArena *Attach(asIScriptContext *ctx, size_t chunkSize = 64 * 1024, size_t maxChunks = 16);
+	static void                 Detach(asIScriptContext *ctx);
+	static CScriptContextArena *Get(asIScriptContext *ctx);
+
+	// Called by ScriptAllocatorAlloc() on the thread in the arena's scope.
+	// Returns null if the request must go to the size classes instead.
+	void *Allocate(size_t size);
+
+	// The start of each chunk, shared by its blocks
+	struct SChunk;
+	// Called by ScriptAllocatorFree() from any thread, for a block of `chunk`
+	static void Free(SChunk *chunk);
+
+	// Blocks not freed yet
+	asQWORD GetBlocksInUse() const { return m_refs.load(std::memory_order_relaxed) - (m_attached ? 1 : 0); }
+
+protected:
+	friend class CScriptContextArenaScope;
+
+	CScriptContextArena(size_t chunkSize, size_t maxChunks);
+	~CScriptContextArena();
+
+	static void CleanupContext(asIScriptContext *ctx);
+	bool        NextChunk();
+	void        Release();
+
+	std::vector<SChunk*> m_chunks;
+	size_t               m_chunkSize;
+	size_t               m_maxChunks;
+	size_t               m_chunk;   // Index of the chunk being used
+	size_t               m_offset;  // Next free byte in it, after the SChunk
+	bool                 m_attached;
+	std::atomic<asQWORD> m_refs;    // Blocks in use, plus one while attached and one per scope
+};
+
+// Sends the requests of this thread to the arena of `ctx`, if it has one, while
+// in scope. The allocator never asks the engine which context is executing, as
+// that can allocate too, so put a scope around each Execute() of a context with
+// an arena. Scopes nest, e.g. for a context executed from a native function; a
+// context without an arena turns the arena off until its scope ends. An arena
+// must be in scope on one thread at a time.
+//
+// {
+//     CScriptContextArenaScope scope(ctx);
+//     r = ctx->Execute();
+// }
+class CScriptContextArenaScope
+{
+public:
+	CScriptContextArenaScope(asIScriptContext *ctx);
+	~CScriptContextArenaScope();
+
+protected:
+	CScriptContextArenaScope(const CScriptContextArenaScope &);
+	CScriptContextArenaScope &operator=(const CScriptContextArenaScope &);
+
+	CScriptContextArena *m_arena;
+	CScriptContextArena *m_previous;
+};
+
+END_AS_NAMESPACE
+
+#endif
@@ -0,0 +1,214 @@
+#include "scripthotreload.h"
+#include <string.h>  // memcpy()
+#include <chrono>    // std::chrono::steady_clock
+#include <fstream>   // std::ifstream
+#include <sstream>   // std::stringstream
+
+using namespace std;
+
+BEGIN_AS_NAMESPACE
+
+static double MillisecondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+CScriptHotReloader::CScriptHotReloader(asIScriptEngine *engine, const char *moduleName)
+	: m_engine(engine)
+	, m_moduleName(moduleName ? moduleName : "")
+	, m_dirty(false)
+	, m_sectionsChanged(0)
+{
+	m_report.sectionsChanged = 0;
+	m_report.globalsMigrated = 0;
+	m_report.buildMs = 0;
+	m_report.migrateMs = 0;
+	m_report.totalMs = 0;
+}
+
+bool CScriptHotReloader::SetSection(const string &name, const string &code)
+{
+	for (size_t n = 0; n < m_sections.size(); n++)
+	{
+		if (m_sections[n].name == name)
+		{
+			if (m_sections[n].code == code)
+				return false;
+
+			m_sections[n].code = code;
+			m_sectionsChanged++;
+			m_dirty = true;
+			return true;
+		}
+	}
+
+	SSection section;
+	section.name = name;
+	section.code = code;
+	m_sections.push_back(section);
+	m_sectionsChanged++;
+	m_dirty = true;
+	return true;
+}
+
+int CScriptHotReloader::LoadSectionFromFile(const string &filename)
+{
+	ifstream file(filename.c_str(), ios::in | ios::binary);
+	if (!file)
+	{
+		string msg = "Failed to open script file '" + filename + "'";
+		m_engine->WriteMessage(filename.c_str(), 0, 0, asMSGTYPE_ERROR, msg.c_str());
+		return asERROR;
+	}
+
+	stringstream buf;
+	buf << file.rdbuf();
+	return SetSection(filename, buf.str()) ? 1 : 0;
+}
+
+void CScriptHotReloader::RemoveSection(const string &name)
+{
+	for (size_t n = 0; n < m_sections.size(); n++)
+	{
+		if (m_sections[n].name == name)
+		{
+			m_sections.erase(m_sections.begin() + n);
+			m_sectionsChanged++;
+			m_dirty = true;
+			return;
+		}
+	}
+}
+
+asIScriptModule *CScriptHotReloader::GetModule() const
+{
+	return m_engine->GetModule(m_moduleName.c_str(), asGM_ONLY_IF_EXISTS);
+}
+
+int CScriptHotReloader::Build()
+{
+	asIScriptModule *oldMod = GetModule();
+	if (!m_dirty && oldMod)
+		return 0;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	m_report.sectionsChanged = m_sectionsChanged;
+	m_report.globalsMigrated = 0;
+	m_report.globalsNotMigrated.clear();
+	m_report.migrateMs = 0;
+
+	// Build the new code next to the running module, so a failed build changes nothing.
+	// The engine doesn't keep the sections after Build(), so all of them are added again
+	// from the cache; only the changed ones were re-read from their source.
+	string tempName = m_moduleName + "~reload";
+	asIScriptModule *newMod = m_engine->GetModule(tempName.c_str(), asGM_ALWAYS_CREATE);
+	for (size_t n = 0; n < m_sections.size(); n++)
+	{
+		int r = newMod->AddScriptSection(m_sections[n].name.c_str(), m_sections[n].code.c_str(), m_sections[n].code.length());
+		if (r < 0)
+		{
+			newMod->Discard();
+			return r;
+		}
+	}
+
+	int r = newMod->Build();
+	m_report.buildMs = MillisecondsSince(start);
+	if (r < 0)
+	{
+		newMod->Discard();
+		m_report.totalMs = MillisecondsSince(start);
+		return r;
+	}
+
+	if (oldMod)
+	{
+		chrono::steady_clock::time_point migrateStart = chrono::steady_clock::now();
+		for (asUINT n = 0; n < oldMod->GetGlobalVarCount(); n++)
+		{
+			if (MigrateGlobal(oldMod, n, newMod))
+				m_report.globalsMigrated++;
+			else
+				m_report.globalsNotMigrated.push_back(oldMod->GetGlobalVarDeclaration(n, true));
+		}
+		m_report.migrateMs = MillisecondsSince(migrateStart);
+
+		// Contexts still running the old code keep it alive until they finish
+		oldMod->Discard();
+	}
+
+	newMod->SetName(m_moduleName.c_str());
+	m_dirty = false;
+	m_sectionsChanged = 0;
+	m_report.totalMs = MillisecondsSince(start);
+	return 1;
+}
+
+bool CScriptHotReloader::MigrateGlobal(asIScriptModule *oldMod, asUINT oldIndex, asIScriptModule *newMod)
+{
+	const char *name = 0, *nameSpace = 0;
+	int typeId = 0;
+	bool isConst = false;
+	oldMod->GetGlobalVar(oldIndex, &name, &nameSpace, &typeId, &isConst);
+	if (isConst)
+		return true; // Nothing to carry over, the new initializer is authoritative
+
+	// Look the variable up by its full declaration, which covers both name and type
+	int newIndex = newMod->GetGlobalVarIndexByDecl(oldMod->GetGlobalVarDeclaration(oldIndex, true));
+	if (newIndex < 0)
+		return false;
+
+	int newTypeId = 0;
+	newMod->GetGlobalVar(newIndex, 0, 0, &newTypeId);
+
+	void *src = oldMod->GetAddressOfGlobalVar(oldIndex);
+	void *dst = newMod->GetAddressOfGlobalVar(newIndex);
+
+	if (typeId <= asTYPEID_DOUBLE)
+	{
+		memcpy(dst, src, m_engine->GetSizeOfPrimitiveType(typeId));
+		return true;
+	}
+
+	asITypeInfo *type = m_engine->GetTypeInfoById(typeId);
+	if (type == 0)
+		return false;
+
+	if (type->GetFlags() & asOBJ_ENUM)
+	{
+		// Script declared enums get a new type id in each build, but the values are plain ints
+		asITypeInfo *newType = m_engine->GetTypeInfoById(newTypeId);
+		if (newType == 0 || !(newType->GetFlags() & asOBJ_ENUM) || strcmp(type->GetName(), newType->GetName()) != 0)
+			return false;
+		memcpy(dst, src, m_engine->GetSizeOfPrimitiveType(typeId));
+		return true;
+	}
+
+	// Same goes for script classes, which would need a full serializer to migrate
+	if (newTypeId != typeId || (typeId & asTYPEID_SCRIPTOBJECT) || (type->GetFlags() & asOBJ_FUNCDEF))
+		return false;
+
+	if (typeId & asTYPEID_OBJHANDLE)
+	{
+		// Native handle to an application object, e.g. `Horse@`
+		void *obj = *static_cast<void**>(src);
+		if (obj)
+			m_engine->AddRefScriptObject(obj, type);
+		void *prev = *static_cast<void**>(dst);
+		*static_cast<void**>(dst) = obj;
+		if (prev)
+			m_engine->ReleaseScriptObject(prev, type);
+		return true;
+	}
+
+	map<int, CopyFunc>::const_iterator it = m_copyFuncs.find(typeId);
+	if (it != m_copyFuncs.end())
+	{
+		it->second(dst, src);
+		return true;
+	}
+
+	return m_engine->AssignScriptObject(dst, src, type) >= 0;
+}
+
+END_AS_NAMESPACE
@@ -0,0 +1,106 @@
+//
+// Script hot reload
+//
+// Rebuilds a script module from its sections without restarting the
+// application. Section sources are cached, so a reload only has to re-read
+// the sections that changed, and is skipped entirely if none did. The new
+// module is built under a temporary name; if the build fails the old module
+// keeps running untouched. On success, global variables are carried over from
+// the old module by name and type before the old module is discarded, so
+// objects held by both script globals and C++ (e.g. `g_stable` in Example.cpp)
+// keep their identity.
+//
+// Migrated globals:
+//  - primitives and enums
+//  - handles to application registered types, e.g. `Horse@`
+//  - application registered value types with a copy function registered via
+//    RegisterCopyFunc()/RegisterRefCountingObjectPtr(), or an opAssign (e.g. string)
+// Script class instances and function handles are not migrated; they are
+// listed in the reload report and keep the value from the new module's initializer.
+//
+
+#ifndef SCRIPTHOTRELOAD_H
+#define SCRIPTHOTRELOAD_H
+
+#ifndef ANGELSCRIPT_H
+// Avoid having to inform include path if header is already include before
+#include <angelscript.h>
+#endif
+
+#include "../RefCountingObjectPtr.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+BEGIN_AS_NAMESPACE
+
+struct SScriptReloadReport
+{
+	asUINT sectionsChanged;
+	asUINT globalsMigrated;
+	std::vector<std::string> globalsNotMigrated; // Declarations of the globals that were reset
+	double buildMs;     // AddScriptSection() + Build() of the new module
+	double migrateMs;   // Copying the globals over
+	double totalMs;
+};
+
+class CScriptHotReloader
+{
+public:
+	// Copies the value at `src` over the value at `dst`, both of the same registered type.
+	typedef void (*CopyFunc)(void *dst, void *src);
+
+	CScriptHotReloader(asIScriptEngine *engine, const char *moduleName);
+
+	// Sets the code of a section; returns true if it differs from the cached one.
+	bool SetSection(const std::string &name, const std::string &code);
+	// Reads a section from disk; returns <0 on error, 0 if unchanged, 1 if changed.
+	int  LoadSectionFromFile(const std::string &filename);
+	void RemoveSection(const std::string &name);
+	bool HasChanges() const { return m_dirty; }
+
+	// Builds the module, or rebuilds it and migrates the globals if it already exists.
+	// Returns 0 if nothing changed, 1 if the module was (re)built, <0 on failure.
+	int Build();
+
+	const SScriptReloadReport &GetLastReport() const { return m_report; }
+	asIScriptModule *GetModule() const;
+
+	void RegisterCopyFunc(int typeId, CopyFunc func) { m_copyFuncs[typeId] = func; }
+
+	// Script globals of type `handleName` (registered with RefCountingObjectPtr<T>::RegisterRefCountingObjectPtr())
+	// are migrated with the C++ assignment, so refcounts stay balanced.
+	template<class T> void RegisterRefCountingObjectPtr(const char *handleName)
+	{
+		int typeId = m_engine->GetTypeIdByDecl(handleName);
+		if (typeId >= 0)
+			RegisterCopyFunc(typeId, &CopyRefCountingObjectPtr<T>);
+	}
+
+protected:
+	struct SSection
+	{
+		std::string name;
+		std::string code;
+	};
+
+	template<class T> static void CopyRefCountingObjectPtr(void *dst, void *src)
+	{
+		*static_cast<RefCountingObjectPtr<T>*>(dst) = *static_cast<RefCountingObjectPtr<T>*>(src);
+	}
+
+	bool MigrateGlobal(asIScriptModule *oldMod, asUINT oldIndex, asIScriptModule *newMod);
+
+	asIScriptEngine          *m_engine;
+	std::string               m_moduleName;
+	std::vector<SSection>     m_sections;
+	bool                      m_dirty;
+	asUINT                    m_sectionsChanged;
+	std::map<int, CopyFunc>   m_copyFuncs;
+	SScriptReloadReport       m_report;
+};
+
+END_AS_NAMESPACE
+
+#endif
@@ -0,0 +1,501 @@
+#include "scriptimmutablestring.h"
+#include "scriptstdstring.h"
+#include "scriptstringsearch.h"
+#include <assert.h>    // assert()
+#include <string.h>    // memcpy(), memcmp(), memset()
+#include <new>         // placement new
+#include <string_view> // std::string_view
+
+using namespace std;
+
+// This macro is used to avoid warnings about unused variables.
+// Usually where the variables are only used in debug mode.
+#define UNUSED_VAR(x) (void)(x)
+
+BEGIN_AS_NAMESPACE
+
+CImmutableString::CImmutableString()
+	: m_inlineLength(0)
+{
+	m_inline[0] = 0;
+}
+
+CImmutableString::CImmutableString(const char *data, asUINT length)
+{
+	char *dst = InitUninitialized(length);
+	memcpy(dst, data, length);
+}
+
+CImmutableString::CImmutableString(const string &str)
+{
+	char *dst = InitUninitialized(asUINT(str.length()));
+	memcpy(dst, str.data(), str.length());
+}
+
+CImmutableString::CImmutableString(const CImmutableString &other)
+{
+	// Copies the inline characters or the buffer pointer, whichever is in use
+	memcpy(m_inline, other.m_inline, sizeof(m_inline));
+	m_inlineLength = other.m_inlineLength;
+	if( m_inlineLength == HEAP )
+		Buffer()->refCount.fetch_add(1, memory_order_relaxed);
+}
+
+CImmutableString::~CImmutableString()
+{
+	Release();
+}
+
+CImmutableString &CImmutableString::operator=(const CImmutableString &other)
+{
+	if( this != &other )
+	{
+		if( other.m_inlineLength == HEAP )
+			other.Buffer()->refCount.fetch_add(1, memory_order_relaxed);
+		Release();
+		memcpy(m_inline, other.m_inline, sizeof(m_inline));
+		m_inlineLength = other.m_inlineLength;
+	}
+	return *this;
+}
+
+bool CImmutableString::operator==(const CImmutableString &other) const
+{
+	if( m_inlineLength == HEAP && other.m_inlineLength == HEAP && Buffer() == other.Buffer() )
+		return true;
+	asUINT len = length();
+	return len == other.length() && memcmp(c_str(), other.c_str(), len) == 0;
+}
+
+int CImmutableString::Compare(const CImmutableString &other) const
+{
+	int cmp = string_view(c_str(), length()).compare(string_view(other.c_str(), other.length()));
+	return cmp < 0 ? -1 : (cmp > 0 ? 1 : 0);
+}
+
+CImmutableString CImmutableString::Concat(const char *a, asUINT aLength, const char *b, asUINT bLength)
+{
+	CImmutableString result;
+	char *dst = result.InitUninitialized(aLength + bLength);
+	memcpy(dst, a, aLength);
+	memcpy(dst + aLength, b, bLength);
+	return result;
+}
+
+CImmutableString CImmutableString::CreateUninitialized(asUINT length, char *&chars)
+{
+	CImmutableString result;
+	chars = result.InitUninitialized(length);
+	return result;
+}
+
+CImmutableString CImmutableString::FromConstant(const string *constant)
+{
+	CImmutableString result;
+	asUINT length = asUINT(constant->length());
+	if( length <= INLINE_CAPACITY )
+	{
+		// Short constants are cheaper to copy than to keep referenced
+		memcpy(result.m_inline, constant->c_str(), length + 1);
+		result.m_inlineLength = (unsigned char)length;
+		GetStdStringFactory()->ReleaseStringConstant(constant);
+		return result;
+	}
+
+	SBuffer *buffer = static_cast<SBuffer*>(::operator new(sizeof(SBuffer)));
+	new(&buffer->refCount) atomic<int>(1);
+	buffer->length = length;
+	buffer->data = constant->c_str();
+	buffer->constant = constant;
+
+	result.SetBuffer(buffer);
+	return result;
+}
+
+CImmutableString::SBuffer *CImmutableString::CreateBuffer(asUINT length)
+{
+	// The characters follow the header in the same allocation
+	SBuffer *buffer = static_cast<SBuffer*>(::operator new(sizeof(SBuffer) + length + 1));
+	new(&buffer->refCount) atomic<int>(1);
+	buffer->length = length;
+	buffer->data = reinterpret_cast<char*>(buffer + 1);
+	buffer->constant = 0;
+	return buffer;
+}
+
+char *CImmutableString::InitUninitialized(asUINT length)
+{
+	char *dst;
+	if( length <= INLINE_CAPACITY )
+	{
+		m_inlineLength = (unsigned char)length;
+		dst = m_inline;
+	}
+	else
+	{
+		SBuffer *buffer = CreateBuffer(length);
+		SetBuffer(buffer);
+		dst = const_cast<char*>(buffer->data);
+	}
+	dst[length] = 0;
+	return dst;
+}
+
+void CImmutableString::Release()
+{
+	if( m_inlineLength != HEAP )
+		return;
+
+	SBuffer *buffer = Buffer();
+	if( buffer->refCount.fetch_sub(1, memory_order_acq_rel) == 1 )
+	{
+		if( buffer->constant )
+			GetStdStringFactory()->ReleaseStringConstant(buffer->constant);
+		buffer->refCount.~atomic<int>();
+		::operator delete(buffer);
+	}
+}
+
+//--------------------------------------------------------------------------
+// String factory, used when the type is registered as `string`
+
+class CImmutableStringFactory : public asIStringFactory
+{
+public:
+	const void *GetStringConstant(const char *data, asUINT length)
+	{
+		// The engine keeps the constant until it's released, and copies it into
+		// script variables with the copy constructor, i.e. an AddRef
+		const string *constant = static_cast<const string*>(GetStdStringFactory()->GetStringConstant(data, length));
+		if( constant == 0 )
+			return 0;
+		return new CImmutableString(CImmutableString::FromConstant(constant));
+	}
+
+	int ReleaseStringConstant(const void *str)
+	{
+		if( str == 0 )
+			return asERROR;
+		delete static_cast<const CImmutableString*>(str);
+		return asSUCCESS;
+	}
+
+	int GetRawStringData(const void *str, char *data, asUINT *length) const
+	{
+		if( str == 0 )
+			return asERROR;
+
+		const CImmutableString *s = static_cast<const CImmutableString*>(str);
+		if( length )
+			*length = s->length();
+		if( data )
+			memcpy(data, s->c_str(), s->length());
+		return asSUCCESS;
+	}
+};
+
+// Holds no state, the constants are kept by the std::string factory
+static CImmutableStringFactory immutableStringFactory;
+
+//--------------------------------------------------------------------------
+// Script interface
+
+static string_view View(const CImmutableString &str)
+{
+	return string_view(str.c_str(), str.length());
+}
+
+static int FindResult(size_t pos)
+{
+	return pos == string_view::npos ? -1 : int(pos);
+}
+
+static void ConstructImmutableString(CImmutableString *thisPointer)
+{
+	new(thisPointer) CImmutableString();
+}
+
+static void CopyConstructImmutableString(const CImmutableString &other, CImmutableString *thisPointer)
+{
+	new(thisPointer) CImmutableString(other);
+}
+
+static void ConstructImmutableStringFromStdString(const string &other, CImmutableString *thisPointer)
+{
+	new(thisPointer) CImmutableString(other);
+}
+
+static void DestructImmutableString(CImmutableString *thisPointer)
+{
+	thisPointer->~CImmutableString();
+}
+
+static string ImmutableStringToStdString(const CImmutableString &str)
+{
+	return str.str();
+}
+
+static CImmutableString StdStringToImmutableString(const string &str)
+{
+	return CImmutableString(str);
+}
+
+static CImmutableString &AddAssignImmutableString(const CImmutableString &other, CImmutableString &dest)
+{
+	dest = CImmutableString::Concat(dest.c_str(), dest.length(), other.c_str(), other.length());
+	return dest;
+}
+
+static CImmutableString AddImmutableStrings(const CImmutableString &a, const CImmutableString &b)
+{
+	return CImmutableString::Concat(a.c_str(), a.length(), b.c_str(), b.length());
+}
+
+static bool ImmutableStringEquals(const CImmutableString &a, const CImmutableString &b)
+{
+	return a == b;
+}
+
+static int ImmutableStringCmp(const CImmutableString &a, const CImmutableString &b)
+{
+	return a.Compare(b);
+}
+
+static asUINT ImmutableStringLength(const CImmutableString &str)
+{
+	return str.length();
+}
+
+static bool ImmutableStringIsEmpty(const CImmutableString &str)
+{
+	return str.empty();
+}
+
+static void ImmutableStringResize(asUINT length, CImmutableString &str)
+{
+	// Like std::string::resize(), new characters are zero
+	asUINT keep = length < str.length() ? length : str.length();
+	char *dst;
+	CImmutableString result = CImmutableString::CreateUninitialized(length, dst);
+	memcpy(dst, str.c_str(), keep);
+	memset(dst + keep, 0, length - keep);
+	str = result;
+}
+
+static const char *ImmutableStringCharAt(asUINT i, const CImmutableString &str)
+{
+	if( i >= str.length() )
+	{
+		// Set a script exception
+		asIScriptContext *ctx = asGetActiveContext();
+		ctx->SetException("Out of range");
+
+		// Return a null pointer
+		return 0;
+	}
+
+	return str.c_str() + i;
+}
+
+template<class T>
+static CImmutableString &AssignNumberToImmutableString(T value, CImmutableString &dest)
+{
+	char buf[STRING_NUMBER_BUFFER_SIZE];
+	dest = CImmutableString(buf, asUINT(StringNumberToChars(buf, value)));
+	return dest;
+}
+
+template<class T>
+static CImmutableString &AddAssignNumberToImmutableString(T value, CImmutableString &dest)
+{
+	char buf[STRING_NUMBER_BUFFER_SIZE];
+	dest = CImmutableString::Concat(dest.c_str(), dest.length(), buf, asUINT(StringNumberToChars(buf, value)));
+	return dest;
+}
+
+template<class T>
+static CImmutableString AddImmutableStringNumber(const CImmutableString &str, T value)
+{
+	char buf[STRING_NUMBER_BUFFER_SIZE];
+	return CImmutableString::Concat(str.c_str(), str.length(), buf, asUINT(StringNumberToChars(buf, value)));
+}
+
+template<class T>
+static CImmutableString AddNumberImmutableString(T value, const CImmutableString &str)
+{
+	char buf[STRING_NUMBER_BUFFER_SIZE];
+	return CImmutableString::Concat(buf, asUINT(StringNumberToChars(buf, value)), str.c_str(), str.length());
+}
+
+// AngelScript signature:
+// T T::substr(uint start = 0, int count = -1) const
+static CImmutableString ImmutableStringSubString(asUINT start, int count, const CImmutableString &str)
+{
+	if( start >= str.length() || count == 0 )
+		return CImmutableString();
+
+	string_view sub = View(str).substr(start, count < 0 ? string_view::npos : size_t(count));
+	return CImmutableString(sub.data(), asUINT(sub.length()));
+}
+
+static int ImmutableStringFindFirst(const CImmutableString &sub, asUINT start, const CImmutableString &str)
+{
+	return FindResult(StringSearchFind(str.c_str(), str.length(), sub.c_str(), sub.length(), start));
+}
+
+static int ImmutableStringFindFirstOf(const CImmutableString &sub, asUINT start, const CImmutableString &str)
+{
+	return FindResult(StringSearchFindFirstOf(str.c_str(), str.length(), sub.c_str(), sub.length(), start));
+}
+
+static int ImmutableStringFindFirstNotOf(const CImmutableString &sub, asUINT start, const CImmutableString &str)
+{
+	return FindResult(StringSearchFindFirstNotOf(str.c_str(), str.length(), sub.c_str(), sub.length(), start));
+}
+
+static int ImmutableStringFindLast(const CImmutableString &sub, int start, const CImmutableString &str)
+{
+	return FindResult(StringSearchFindLast(str.c_str(), str.length(), sub.c_str(), sub.length(), start < 0 ? string_view::npos : size_t(start)));
+}
+
+static int ImmutableStringFindLastOf(const CImmutableString &sub, int start, const CImmutableString &str)
+{
+	return FindResult(StringSearchFindLastOf(str.c_str(), str.length(), sub.c_str(), sub.length(), start < 0 ? string_view::npos : size_t(start)));
+}
+
+static int ImmutableStringFindLastNotOf(const CImmutableString &sub, int start, const CImmutableString &str)
+{
+	return FindResult(StringSearchFindLastNotOf(str.c_str(), str.length(), sub.c_str(), sub.length(), start < 0 ? string_view::npos : size_t(start)));
+}
+
+static void ImmutableStringInsert(asUINT pos, const CImmutableString &other, CImmutableString &str)
+{
+	if( pos > str.length() )
+	{
+		asGetActiveContext()->SetException("Out of range");
+		return;
+	}
+
+	char *dst;
+	CImmutableString result = CImmutableString::CreateUninitialized(str.length() + other.length(), dst);
+	memcpy(dst, str.c_str(), pos);
+	memcpy(dst + pos, other.c_str(), other.length());
+	memcpy(dst + pos + other.length(), str.c_str() + pos, str.length() - pos);
+	str = result;
+}
+
+static void ImmutableStringErase(asUINT pos, int count, CImmutableString &str)
+{
+	if( pos > str.length() )
+	{
+		asGetActiveContext()->SetException("Out of range");
+		return;
+	}
+
+	asUINT erased = str.length() - pos;
+	if( count >= 0 && asUINT(count) < erased )
+		erased = asUINT(count);
+	const char *rest = str.c_str() + pos + erased;
+	str = CImmutableString::Concat(str.c_str(), pos, rest, str.length() - pos - erased);
+}
+
+static void RegisterNumberConversions(asIScriptEngine *engine, const char *typeName)
+{
+	int r = 0;
+	UNUSED_VAR(r);
+
+	struct SNumberType
+	{
+		const char *name;
+		asSFuncPtr  assign, addAssign, add, addR;
+	};
+
+	const SNumberType types[] =
+	{
+		{ "double", asFUNCTION(AssignNumberToImmutableString<double>),  asFUNCTION(AddAssignNumberToImmutableString<double>),  asFUNCTION(AddImmutableStringNumber<double>),  asFUNCTION(AddNumberImmutableString<double>) },
+		{ "float",  asFUNCTION(AssignNumberToImmutableString<float>),   asFUNCTION(AddAssignNumberToImmutableString<float>),   asFUNCTION(AddImmutableStringNumber<float>),   asFUNCTION(AddNumberImmutableString<float>) },
+		{ "int64",  asFUNCTION(AssignNumberToImmutableString<asINT64>), asFUNCTION(AddAssignNumberToImmutableString<asINT64>), asFUNCTION(AddImmutableStringNumber<asINT64>), asFUNCTION(AddNumberImmutableString<asINT64>) },
+		{ "uint64", asFUNCTION(AssignNumberToImmutableString<asQWORD>), asFUNCTION(AddAssignNumberToImmutableString<asQWORD>), asFUNCTION(AddImmutableStringNumber<asQWORD>), asFUNCTION(AddNumberImmutableString<asQWORD>) },
+		{ "bool",   asFUNCTION(AssignNumberToImmutableString<bool>),    asFUNCTION(AddAssignNumberToImmutableString<bool>),    asFUNCTION(AddImmutableStringNumber<bool>),    asFUNCTION(AddNumberImmutableString<bool>) },
+	};
+
+	string t = typeName;
+	for( size_t n = 0; n < sizeof(types) / sizeof(types[0]); n++ )
+	{
+		string v = types[n].name;
+		r = engine->RegisterObjectMethod(typeName, (t + " &opAssign(" + v + ")").c_str(), types[n].assign, asCALL_CDECL_OBJLAST); assert( r >= 0 );
+		r = engine->RegisterObjectMethod(typeName, (t + " &opAddAssign(" + v + ")").c_str(), types[n].addAssign, asCALL_CDECL_OBJLAST); assert( r >= 0 );
+		r = engine->RegisterObjectMethod(typeName, (t + " opAdd(" + v + ") const").c_str(), types[n].add, asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+		r = engine->RegisterObjectMethod(typeName, (t + " opAdd_r(" + v + ") const").c_str(), types[n].addR, asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	}
+}
+
+void RegisterImmutableString(asIScriptEngine *engine, bool asStringType)
+{
+	int r = 0;
+	UNUSED_VAR(r);
+
+	const char *typeName = asStringType ? "string" : "istring";
+	string t = typeName;
+
+	// The buffer is shared between copies, so the object can be moved around freely
+	r = engine->RegisterObjectType(typeName, sizeof(CImmutableString), asOBJ_VALUE | asOBJ_APP_CLASS_CDAK); assert( r >= 0 );
+
+	if( asStringType )
+	{
+		r = engine->RegisterStringFactory(typeName, &immutableStringFactory); assert( r >= 0 );
+	}
+
+	r = engine->RegisterObjectBehaviour(typeName, asBEHAVE_CONSTRUCT, "void f()", asFUNCTION(ConstructImmutableString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectBehaviour(typeName, asBEHAVE_CONSTRUCT, ("void f(const " + t + " &in)").c_str(), asFUNCTION(CopyConstructImmutableString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectBehaviour(typeName, asBEHAVE_DESTRUCT, "void f()", asFUNCTION(DestructImmutableString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+
+	if( !asStringType )
+	{
+		// Conversions to and from the std::string type
+		r = engine->RegisterObjectBehaviour(typeName, asBEHAVE_CONSTRUCT, "void f(const string &in) explicit", asFUNCTION(ConstructImmutableStringFromStdString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+		r = engine->RegisterObjectMethod(typeName, "string opImplConv() const", asFUNCTION(ImmutableStringToStdString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+		r = engine->RegisterObjectMethod("string", (t + " opImplConv() const").c_str(), asFUNCTION(StdStringToImmutableString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	}
+
+	r = engine->RegisterObjectMethod(typeName, (t + " &opAssign(const " + t + " &in)").c_str(), asMETHODPR(CImmutableString, operator=, (const CImmutableString &), CImmutableString &), asCALL_THISCALL); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, (t + " &opAddAssign(const " + t + " &in)").c_str(), asFUNCTION(AddAssignImmutableString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, ("bool opEquals(const " + t + " &in) const").c_str(), asFUNCTION(ImmutableStringEquals), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, ("int opCmp(const " + t + " &in) const").c_str(), asFUNCTION(ImmutableStringCmp), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, (t + " opAdd(const " + t + " &in) const").c_str(), asFUNCTION(AddImmutableStrings), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+
+	// The same accessors as registered for std::string, see AS_USE_ACCESSORS in scriptstdstring.h
+#if AS_USE_ACCESSORS != 1
+	r = engine->RegisterObjectMethod(typeName, "uint length() const", asFUNCTION(ImmutableStringLength), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+#endif
+	r = engine->RegisterObjectMethod(typeName, "void resize(uint)", asFUNCTION(ImmutableStringResize), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+#if AS_USE_STLNAMES != 1 && AS_USE_ACCESSORS == 1
+	r = engine->RegisterObjectMethod(typeName, "uint get_length() const property", asFUNCTION(ImmutableStringLength), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, "void set_length(uint) property", asFUNCTION(ImmutableStringResize), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+#endif
+	r = engine->RegisterObjectMethod(typeName, "bool isEmpty() const", asFUNCTION(ImmutableStringIsEmpty), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+
+	// Only the inspector, the characters can't be modified
+	r = engine->RegisterObjectMethod(typeName, "const uint8 &opIndex(uint) const", asFUNCTION(ImmutableStringCharAt), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+
+	RegisterNumberConversions(engine, typeName);
+
+	r = engine->RegisterObjectMethod(typeName, (t + " substr(uint start = 0, int count = -1) const").c_str(), asFUNCTION(ImmutableStringSubString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, ("int findFirst(const " + t + " &in, uint start = 0) const").c_str(), asFUNCTION(ImmutableStringFindFirst), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, ("int findFirstOf(const " + t + " &in, uint start = 0) const").c_str(), asFUNCTION(ImmutableStringFindFirstOf), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, ("int findFirstNotOf(const " + t + " &in, uint start = 0) const").c_str(), asFUNCTION(ImmutableStringFindFirstNotOf), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, ("int findLast(const " + t + " &in, int start = -1) const").c_str(), asFUNCTION(ImmutableStringFindLast), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, ("int findLastOf(const " + t + " &in, int start = -1) const").c_str(), asFUNCTION(ImmutableStringFindLastOf), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, ("int findLastNotOf(const " + t + " &in, int start = -1) const").c_str(), asFUNCTION(ImmutableStringFindLastNotOf), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, ("void insert(uint pos, const " + t + " &in other)").c_str(), asFUNCTION(ImmutableStringInsert), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, "void erase(uint pos, int count = -1)", asFUNCTION(ImmutableStringErase), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+
+#if AS_USE_STLNAMES == 1
+	r = engine->RegisterObjectMethod(typeName, "uint size() const", asFUNCTION(ImmutableStringLength), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, "bool empty() const", asFUNCTION(ImmutableStringIsEmpty), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, ("int find(const " + t + " &in, uint start = 0) const").c_str(), asFUNCTION(ImmutableStringFindFirst), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod(typeName, ("int rfind(const " + t + " &in, int start = -1) const").c_str(), asFUNCTION(ImmutableStringFindLast), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+#endif
+}
+
+END_AS_NAMESPACE
@@ -0,0 +1,105 @@
+//
+// Script immutable string
+//
+// An alternative to the value type std::string registered by RegisterStdString(),
+// for scripts that pass and assign strings a lot. The characters are never
+// modified once created: strings of up to INLINE_CAPACITY bytes are stored
+// inline in the script variable itself, longer ones in a shared, reference
+// counted buffer. Copying a string is thus either a small memcpy or an AddRef,
+// never an allocation.
+//
+// The script interface is the same as the methods and operators of `string`.
+// Methods that modify the string (`+=`, insert(), erase(), resize()) build a
+// new string and assign it to the variable. The only exception is the mutable
+// `uint8 &opIndex(uint)`, which isn't available.
+//
+// RegisterImmutableString(engine, true) registers the type as `string`, instead
+// of RegisterStdString(). String literals then share the constant cache of the
+// std::string factory, and the characters of long literals aren't copied at all.
+// RegisterImmutableString(engine) registers it as `istring` next to `string`,
+// which must be registered first, with conversions between the two.
+// The global formatInt(), parseInt() etc. are only provided by RegisterStdString().
+//
+
+#ifndef SCRIPTIMMUTABLESTRING_H
+#define SCRIPTIMMUTABLESTRING_H
+
+#ifndef ANGELSCRIPT_H
+// Avoid having to inform include path if header is already include before
+#include <angelscript.h>
+#endif
+
+#include <atomic>
+#include <string>
+#include <string.h>
+
+BEGIN_AS_NAMESPACE
+
+class CImmutableString
+{
+public:
+	// Longest string stored without a buffer; the object is 24 bytes
+	static const asUINT INLINE_CAPACITY = 22;
+
+	CImmutableString();
+	CImmutableString(const char *data, asUINT length);
+	explicit CImmutableString(const std::string &str);
+	CImmutableString(const CImmutableString &other);
+	~CImmutableString();
+
+	CImmutableString &operator=(const CImmutableString &other);
+
+	// Null terminated
+	const char *c_str() const { return m_inlineLength == HEAP ? Buffer()->data : m_inline; }
+	asUINT      length() const { return m_inlineLength == HEAP ? Buffer()->length : m_inlineLength; }
+	bool        empty() const { return length() == 0; }
+	std::string str() const { return std::string(c_str(), length()); }
+
+	// True if the characters are stored inline, false if in a shared buffer
+	bool        IsInline() const { return m_inlineLength != HEAP; }
+
+	bool operator==(const CImmutableString &other) const;
+	int  Compare(const CImmutableString &other) const;
+
+	// Creates the string `a` followed by `b` with a single allocation at most
+	static CImmutableString Concat(const char *a, asUINT aLength, const char *b, asUINT bLength);
+
+	// Creates a string of `length` chars with a single allocation at most. The caller
+	// fills in `chars` before the string is copied; the terminating null is set.
+	static CImmutableString CreateUninitialized(asUINT length, char *&chars);
+
+	// Wraps a constant of the std::string factory without copying the characters.
+	// Takes over the caller's reference to the constant.
+	static CImmutableString FromConstant(const std::string *constant);
+
+protected:
+	static const unsigned char HEAP = 0xFF;
+
+	struct SBuffer
+	{
+		std::atomic<int>   refCount;
+		asUINT             length;
+		const char        *data;     // Follows the buffer, or points into `constant`
+		const std::string *constant; // Constant of the std::string factory, or null
+	};
+
+	// Allocates a buffer for `length` chars, which the caller must fill in
+	static SBuffer *CreateBuffer(asUINT length);
+	char *InitUninitialized(asUINT length);
+	void  Release();
+
+	// The buffer pointer is kept in the first bytes of m_inline. A union with
+	// the pointer would align the object to 8 and pad it to 32 bytes.
+	SBuffer *Buffer() const { SBuffer *buffer; memcpy(&buffer, m_inline, sizeof(buffer)); return buffer; }
+	void     SetBuffer(SBuffer *buffer) { memcpy(m_inline, &buffer, sizeof(buffer)); m_inlineLength = HEAP; }
+
+	char          m_inline[INLINE_CAPACITY + 1];
+	unsigned char m_inlineLength; // HEAP if Buffer() is used
+};
+
+// Registers the type as `string` if `asStringType`, or as `istring` otherwise.
+void RegisterImmutableString(asIScriptEngine *engine, bool asStringType = false);
+
+END_AS_NAMESPACE
+
+#endif
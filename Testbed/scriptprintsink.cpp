@@ -0,0 +1,319 @@
+#include "scriptprintsink.h"
+#include <algorithm> // std::max()
+#include <chrono>    // std::chrono::microseconds
+
+using namespace std;
+
+BEGIN_AS_NAMESPACE
+
+// Never reused, so a per-thread lookup can't find the buffer of a destroyed sink
+static atomic<asUINT> nextPrintSinkId(1);
+
+struct SThreadBufferRef
+{
+	asUINT sinkId;
+	void  *buffer;
+};
+
+// The buffer the current thread used last, so Write() doesn't search for it
+static thread_local SThreadBufferRef lastThreadBuffer = { 0, 0 };
+
+CScriptPrintSink::CScriptPrintSink(ostream &out)
+	: m_out(&out)
+	, m_id(nextPrintSinkId++)
+	, m_running(false)
+	, m_bytesWritten(0)
+	, m_drains(0)
+	, m_wakeRequested(false)
+	, m_stopRequested(false)
+	, m_writerStopped(false)
+	, m_flushRequested(0)
+	, m_flushCompleted(0)
+{
+}
+
+CScriptPrintSink::~CScriptPrintSink()
+{
+	Stop();
+	Drain();
+
+	lock_guard<mutex> lock(m_buffersMutex);
+	for (size_t n = 0; n < m_buffers.size(); n++)
+		delete m_buffers[n];
+	m_buffers.clear();
+}
+
+void CScriptPrintSink::Start(const SScriptPrintSinkConfig &config)
+{
+	Stop();
+
+	m_config = config;
+	m_stopRequested = false;
+	m_writerStopped = false;
+	m_running = true;
+	m_thread = thread(&CScriptPrintSink::ThreadMain, this);
+}
+
+void CScriptPrintSink::Stop()
+{
+	if (!m_thread.joinable())
+		return;
+
+	m_running = false;
+	{
+		lock_guard<mutex> lock(m_wakeMutex);
+		m_stopRequested = true;
+	}
+	m_wake.notify_all();
+	m_thread.join();
+
+	// Writes that raced with the last pass of the writer
+	Drain();
+
+	// Threads waiting for space write directly from now on
+	lock_guard<mutex> lock(m_buffersMutex);
+	for (size_t n = 0; n < m_buffers.size(); n++)
+	{
+		lock_guard<mutex> bufferLock(m_buffers[n]->lock);
+		m_buffers[n]->drained.notify_all();
+	}
+}
+
+CScriptPrintSink::SThreadBuffer *CScriptPrintSink::GetThreadBuffer()
+{
+	if (lastThreadBuffer.sinkId == m_id)
+		return static_cast<SThreadBuffer*>(lastThreadBuffer.buffer);
+
+	thread::id self = this_thread::get_id();
+	SThreadBuffer *buffer = 0;
+
+	lock_guard<mutex> lock(m_buffersMutex);
+	for (size_t n = 0; n < m_buffers.size() && buffer == 0; n++)
+		if (m_buffers[n]->owner == self)
+			buffer = m_buffers[n];
+
+	if (buffer == 0)
+	{
+		buffer = new SThreadBuffer;
+		buffer->owner = self;
+		buffer->wakeSent = false;
+		buffer->messages = 0;
+		buffer->bytes = 0;
+		buffer->droppedMessages = 0;
+		buffer->droppedBytes = 0;
+		buffer->overflows = 0;
+		buffer->blockedWrites = 0;
+		buffer->peakPendingBytes = 0;
+		m_buffers.push_back(buffer);
+	}
+
+	lastThreadBuffer.sinkId = m_id;
+	lastThreadBuffer.buffer = buffer;
+	return buffer;
+}
+
+void CScriptPrintSink::Write(const char *data, size_t length)
+{
+	if (length == 0)
+		return;
+
+	SThreadBuffer *buffer = GetThreadBuffer();
+	bool running = m_running;
+	bool wake = false;
+	{
+		unique_lock<mutex> lock(buffer->lock);
+
+		// An empty buffer takes any write, so a large one isn't lost
+		if (running && !buffer->pending.empty() && buffer->pending.size() + length > m_config.bufferCapacity)
+		{
+			buffer->overflows++;
+			if (!buffer->wakeSent)
+				buffer->wakeSent = wake = true;
+
+			if (m_config.overflow == PRINT_OVERFLOW_DROP)
+			{
+				buffer->droppedMessages++;
+				buffer->droppedBytes += length;
+				lock.unlock();
+				if (wake)
+					WakeWriter();
+				return;
+			}
+
+			buffer->blockedWrites++;
+			if (wake)
+			{
+				// The writer takes the buffer lock, so it must not be held here
+				lock.unlock();
+				WakeWriter();
+				lock.lock();
+				wake = false;
+			}
+			while (m_running && !buffer->pending.empty() && buffer->pending.size() + length > m_config.bufferCapacity)
+				buffer->drained.wait(lock);
+			running = m_running;
+		}
+
+		buffer->pending.append(data, length);
+		buffer->messages++;
+		buffer->bytes += length;
+		buffer->peakPendingBytes = max(buffer->peakPendingBytes, buffer->pending.size());
+
+		if (running && !buffer->wakeSent &&
+			(buffer->pending.size() >= m_config.flushThreshold || (m_config.flushOnNewline && data[length - 1] == '\n')))
+			buffer->wakeSent = wake = true;
+	}
+
+	if (!running)
+		Drain();
+	else if (wake)
+		WakeWriter();
+}
+
+void CScriptPrintSink::WakeWriter()
+{
+	{
+		lock_guard<mutex> lock(m_wakeMutex);
+		m_wakeRequested = true;
+	}
+	m_wake.notify_one();
+}
+
+void CScriptPrintSink::Flush()
+{
+	if (!m_running)
+	{
+		Drain();
+		return;
+	}
+
+	unique_lock<mutex> lock(m_wakeMutex);
+	asQWORD target = ++m_flushRequested;
+	m_wake.notify_one();
+	while (m_flushCompleted < target && !m_writerStopped)
+		m_flushDone.wait(lock);
+
+	// Stop() was called meanwhile, and the writer may have gone before the request
+	if (m_flushCompleted < target)
+	{
+		lock.unlock();
+		Drain();
+	}
+}
+
+void CScriptPrintSink::Drain()
+{
+	lock_guard<mutex> output(m_outputMutex);
+
+	{
+		lock_guard<mutex> lock(m_buffersMutex);
+		m_drainList = m_buffers;
+	}
+
+	bool wrote = false;
+	for (size_t n = 0; n < m_drainList.size(); n++)
+	{
+		SThreadBuffer *buffer = m_drainList[n];
+		{
+			lock_guard<mutex> lock(buffer->lock);
+			if (buffer->pending.empty())
+				continue;
+
+			// The thread gets the emptied buffer of the previous write in exchange
+			m_chunk.swap(buffer->pending);
+			buffer->wakeSent = false;
+		}
+		buffer->drained.notify_all();
+
+		// The thread may write again while this is blocked on the stream
+		m_out->write(m_chunk.data(), streamsize(m_chunk.size()));
+		m_bytesWritten += m_chunk.size();
+		m_chunk.clear();
+		wrote = true;
+	}
+
+	if (wrote)
+	{
+		m_out->flush();
+		m_drains++;
+	}
+}
+
+void CScriptPrintSink::ThreadMain()
+{
+	unique_lock<mutex> lock(m_wakeMutex);
+	for (;;)
+	{
+		if (!m_wakeRequested && !m_stopRequested && m_flushRequested == m_flushCompleted)
+		{
+			if (m_config.flushIntervalMicroseconds > 0)
+				m_wake.wait_for(lock, chrono::microseconds(m_config.flushIntervalMicroseconds));
+			else
+				m_wake.wait(lock);
+		}
+
+		bool stop = m_stopRequested;
+		asQWORD flushTarget = m_flushRequested;
+		m_wakeRequested = false;
+
+		lock.unlock();
+		Drain();
+		lock.lock();
+
+		m_flushCompleted = flushTarget;
+		if (stop)
+			m_writerStopped = true;
+		m_flushDone.notify_all();
+		if (stop)
+			break;
+	}
+}
+
+SScriptPrintSinkStats CScriptPrintSink::GetStats() const
+{
+	SScriptPrintSinkStats stats = SScriptPrintSinkStats();
+
+	{
+		lock_guard<mutex> lock(m_buffersMutex);
+		for (size_t n = 0; n < m_buffers.size(); n++)
+		{
+			SThreadBuffer *buffer = m_buffers[n];
+			lock_guard<mutex> bufferLock(buffer->lock);
+			stats.messages += buffer->messages;
+			stats.bytes += buffer->bytes;
+			stats.droppedMessages += buffer->droppedMessages;
+			stats.droppedBytes += buffer->droppedBytes;
+			stats.overflows += buffer->overflows;
+			stats.blockedWrites += buffer->blockedWrites;
+			stats.peakPendingBytes = max(stats.peakPendingBytes, buffer->peakPendingBytes);
+		}
+		stats.threads = asUINT(m_buffers.size());
+	}
+
+	lock_guard<mutex> lock(m_outputMutex);
+	stats.bytesWritten = m_bytesWritten;
+	stats.drains = m_drains;
+	return stats;
+}
+
+//--------------------------------------------------------------------------
+// CScriptPrintSinkStreamBuf
+
+CScriptPrintSinkStreamBuf::int_type CScriptPrintSinkStreamBuf::overflow(int_type c)
+{
+	if (traits_type::eq_int_type(c, traits_type::eof()))
+		return traits_type::not_eof(c);
+
+	char ch = traits_type::to_char_type(c);
+	m_sink->Write(&ch, 1);
+	return c;
+}
+
+streamsize CScriptPrintSinkStreamBuf::xsputn(const char *data, streamsize length)
+{
+	if (length > 0)
+		m_sink->Write(data, size_t(length));
+	return length;
+}
+
+END_AS_NAMESPACE
@@ -0,0 +1,189 @@
+//
+// Script print sink
+//
+// Buffers the output of the script Print() function, so the thread executing
+// a script doesn't wait on the terminal or a file. Each thread appends to a
+// buffer of its own, which only the writer thread ever takes a lock on as well;
+// the writer thread takes the filled buffers and writes them to the stream.
+//
+// The writer drains the buffers every `flushIntervalMicroseconds`, and as soon
+// as a buffer holds `flushThreshold` bytes, or with `flushOnNewline` as soon as
+// a line is complete. Flush() waits until everything written so far is out.
+//
+// A buffer holds at most `bufferCapacity` bytes. When a write doesn't fit, it is
+// either dropped (PRINT_OVERFLOW_DROP, the script never waits) or the thread
+// waits until the writer has taken the buffer (PRINT_OVERFLOW_BLOCK, nothing is
+// lost); either way it's counted in the stats.
+//
+// The output of one thread keeps its order; the output of several threads is
+// interleaved by buffer, not by line. Until Start() and after Stop() Write()
+// writes to the stream directly.
+//
+// Anything else written to the same stream while the sink runs would bypass
+// the buffers and come out before script output written earlier. To keep the
+// order, point the stream at a CScriptPrintSinkStreamBuf while the sink runs,
+// with the sink itself writing to the original stream buffer:
+//
+// std::ostream stdoutStream(std::cout.rdbuf());
+// CScriptPrintSink printSink(stdoutStream);
+// CScriptPrintSinkStreamBuf printSinkBuf(printSink);
+//
+// void PrintString(string &str)
+// {
+//     printSink.Write(str);
+// }
+//
+// std::streambuf *coutBuf = std::cout.rdbuf(&printSinkBuf);
+// printSink.Start();
+// r = ctx->Execute();
+// printSink.Stop();
+// std::cout.rdbuf(coutBuf);
+//
+
+#ifndef SCRIPTPRINTSINK_H
+#define SCRIPTPRINTSINK_H
+
+#ifndef ANGELSCRIPT_H
+// Avoid having to inform include path if header is already include before
+#include <angelscript.h>
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+BEGIN_AS_NAMESPACE
+
+enum EScriptPrintOverflow
+{
+	PRINT_OVERFLOW_DROP,  // Writes that don't fit in the buffer are discarded
+	PRINT_OVERFLOW_BLOCK  // Writes that don't fit wait for the writer thread
+};
+
+struct SScriptPrintSinkConfig
+{
+	SScriptPrintSinkConfig()
+		: bufferCapacity(256 * 1024)
+		, flushThreshold(16 * 1024)
+		, flushIntervalMicroseconds(20000)
+		, flushOnNewline(false)
+		, overflow(PRINT_OVERFLOW_DROP)
+	{
+	}
+
+	size_t               bufferCapacity;            // Per thread; a single larger write is still accepted into an empty buffer
+	size_t               flushThreshold;            // Wakes the writer once a buffer holds this many bytes
+	asUINT               flushIntervalMicroseconds; // 0 drains only on the threshold, a newline or Flush()
+	bool                 flushOnNewline;            // Wakes the writer when a write ends with '\n', e.g. for an interactive console
+	EScriptPrintOverflow overflow;
+};
+
+struct SScriptPrintSinkStats
+{
+	asQWORD messages;         // Writes accepted into a buffer
+	asQWORD bytes;
+	asQWORD droppedMessages;  // Writes discarded with PRINT_OVERFLOW_DROP
+	asQWORD droppedBytes;
+	asQWORD overflows;        // Writes that found the buffer of their thread full, dropped or not
+	asQWORD blockedWrites;    // Writes that waited for the writer with PRINT_OVERFLOW_BLOCK
+	asQWORD bytesWritten;     // Written to the stream
+	asQWORD drains;           // Times the buffers were written out
+	size_t  peakPendingBytes; // Largest fill of a single buffer, to size `bufferCapacity`
+	asUINT  threads;          // Threads that have written through the sink
+};
+
+class CScriptPrintSink
+{
+public:
+	explicit CScriptPrintSink(std::ostream &out);
+	~CScriptPrintSink();
+
+	// Starts the writer thread. The configuration must not change while other
+	// threads write, i.e. Start() is called before the scripts run.
+	void Start(const SScriptPrintSinkConfig &config = SScriptPrintSinkConfig());
+	// Writes out what's left and stops the writer thread
+	void Stop();
+	bool IsRunning() const { return m_running; }
+
+	// Can be called from any thread
+	void Write(const char *data, size_t length);
+	void Write(const std::string &str) { Write(str.data(), str.length()); }
+
+	// Returns once everything written before the call is in the stream
+	void Flush();
+
+	SScriptPrintSinkStats GetStats() const;
+
+protected:
+	struct SThreadBuffer
+	{
+		std::mutex              lock;
+		std::condition_variable drained;  // Signalled when the writer took the pending text
+		std::string             pending;
+		std::thread::id         owner;
+		bool                    wakeSent; // The writer was woken for the pending text already
+
+		// Guarded by `lock`
+		asQWORD messages;
+		asQWORD bytes;
+		asQWORD droppedMessages;
+		asQWORD droppedBytes;
+		asQWORD overflows;
+		asQWORD blockedWrites;
+		size_t  peakPendingBytes;
+	};
+
+	SThreadBuffer *GetThreadBuffer();
+	void           WakeWriter();
+	void           Drain();
+	void           ThreadMain();
+
+	std::ostream                 *m_out;
+	asUINT                        m_id;      // Identifies the sink in the per-thread buffer lookup
+	SScriptPrintSinkConfig        m_config;
+	std::atomic<bool>             m_running;
+
+	// Guards the list of buffers
+	mutable std::mutex            m_buffersMutex;
+	std::vector<SThreadBuffer*>   m_buffers;
+
+	// Guards the stream and the members used by Drain()
+	mutable std::mutex            m_outputMutex;
+	std::vector<SThreadBuffer*>   m_drainList;
+	std::string                   m_chunk;   // Swapped with a pending buffer, so neither allocates again
+	asQWORD                       m_bytesWritten;
+	asQWORD                       m_drains;
+
+	std::thread                   m_thread;
+	std::mutex                    m_wakeMutex;
+	std::condition_variable       m_wake;
+	std::condition_variable       m_flushDone;
+	bool                          m_wakeRequested;
+	bool                          m_stopRequested;
+	bool                          m_writerStopped;
+	asQWORD                       m_flushRequested;
+	asQWORD                       m_flushCompleted;
+};
+
+// Unbuffered stream buffer writing through a sink, so that other output to
+// the stream, e.g. std::cout, stays in order with the scripts' output
+class CScriptPrintSinkStreamBuf : public std::streambuf
+{
+public:
+	explicit CScriptPrintSinkStreamBuf(CScriptPrintSink &sink) : m_sink(&sink) {}
+
+protected:
+	int_type        overflow(int_type c);
+	std::streamsize xsputn(const char *data, std::streamsize length);
+
+	CScriptPrintSink *m_sink;
+};
+
+END_AS_NAMESPACE
+
+#endif
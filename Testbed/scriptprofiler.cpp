@@ -0,0 +1,271 @@
+#include "scriptprofiler.h"
+#include <algorithm> // std::sort()
+#include <chrono>    // std::chrono::microseconds
+#include <set>       // std::set
+
+using namespace std;
+
+BEGIN_AS_NAMESPACE
+
+static bool ProfileEntryMoreSamples(const SScriptProfileEntry &a, const SScriptProfileEntry &b)
+{
+	if (a.selfSamples != b.selfSamples)
+		return a.selfSamples > b.selfSamples;
+	return a.totalSamples > b.totalSamples;
+}
+
+CScriptProfiler::CScriptProfiler()
+	: m_sampleCount(0)
+	, m_stopRequested(false)
+	, m_intervalMicroseconds(10000)
+{
+}
+
+CScriptProfiler::~CScriptProfiler()
+{
+	Stop();
+
+	lock_guard<mutex> lock(m_contextsMutex);
+	for (size_t n = 0; n < m_contexts.size(); n++)
+	{
+		if (!m_contexts[n]->ownLineCallback)
+			m_contexts[n]->ctx->ClearLineCallback();
+		m_contexts[n]->ctx->SetUserData(0, SCRIPTPROFILER_UDATA);
+		m_contexts[n]->ctx->Release();
+		delete m_contexts[n];
+	}
+	m_contexts.clear();
+}
+
+void CScriptProfiler::Start(asUINT intervalMicroseconds)
+{
+	Stop();
+
+	m_intervalMicroseconds = intervalMicroseconds > 0 ? intervalMicroseconds : 1;
+	m_stopRequested = false;
+	m_thread = thread(&CScriptProfiler::ThreadMain, this);
+}
+
+void CScriptProfiler::Stop()
+{
+	if (!m_thread.joinable())
+		return;
+
+	{
+		lock_guard<mutex> lock(m_threadMutex);
+		m_stopRequested = true;
+	}
+	m_threadWake.notify_all();
+	m_thread.join();
+}
+
+void CScriptProfiler::Attach(asIScriptContext *ctx, bool hasOwnLineCallback)
+{
+	SContextEntry *entry = new SContextEntry;
+	entry->profiler = this;
+	entry->ctx = ctx;
+	entry->ownLineCallback = hasOwnLineCallback;
+	entry->sampleRequested = false;
+
+	ctx->AddRef();
+	ctx->SetUserData(entry, SCRIPTPROFILER_UDATA);
+
+	lock_guard<mutex> lock(m_contextsMutex);
+	m_contexts.push_back(entry);
+}
+
+void CScriptProfiler::Detach(asIScriptContext *ctx)
+{
+	lock_guard<mutex> lock(m_contextsMutex);
+	for (size_t n = 0; n < m_contexts.size(); n++)
+	{
+		if (m_contexts[n]->ctx == ctx)
+		{
+			if (!m_contexts[n]->ownLineCallback)
+				ctx->ClearLineCallback();
+			ctx->SetUserData(0, SCRIPTPROFILER_UDATA);
+			ctx->Release();
+			delete m_contexts[n];
+			m_contexts.erase(m_contexts.begin() + n);
+			return;
+		}
+	}
+}
+
+void CScriptProfiler::ThreadMain()
+{
+	unique_lock<mutex> lock(m_threadMutex);
+	while (!m_stopRequested)
+	{
+		m_threadWake.wait_for(lock, chrono::microseconds(m_intervalMicroseconds));
+		if (!m_stopRequested)
+			RequestSamples();
+	}
+}
+
+void CScriptProfiler::RequestSamples()
+{
+	lock_guard<mutex> lock(m_contextsMutex);
+	for (size_t n = 0; n < m_contexts.size(); n++)
+	{
+		SContextEntry *entry = m_contexts[n];
+
+		// Idle contexts have nothing to sample. The state is read without synchronization,
+		// at worst a context which just started or stopped is sampled or skipped once.
+		if (entry->ctx->GetState() != asEXECUTION_ACTIVE)
+			continue;
+
+		// Don't arm again if the previous request hasn't been served yet
+		if (entry->sampleRequested.exchange(true))
+			continue;
+
+		// The engine supports setting the line callback from another thread
+		// while the context is executing, see asIScriptContext::SetLineCallback().
+		if (!entry->ownLineCallback)
+			entry->ctx->SetLineCallback(asMETHOD(CScriptProfiler, SampleLineCallback), this, asCALL_THISCALL);
+	}
+}
+
+void CScriptProfiler::SampleLineCallback(asIScriptContext *ctx)
+{
+	// One-shot: disarm first, so the callback costs nothing until the next sample
+	ctx->ClearLineCallback();
+
+	SContextEntry *entry = static_cast<SContextEntry*>(ctx->GetUserData(SCRIPTPROFILER_UDATA));
+	if (entry && entry->sampleRequested.exchange(false))
+		RecordSample(ctx);
+}
+
+void CScriptProfiler::OnLineCallback(asIScriptContext *ctx)
+{
+	SContextEntry *entry = static_cast<SContextEntry*>(ctx->GetUserData(SCRIPTPROFILER_UDATA));
+	if (entry && entry->sampleRequested.load(memory_order_relaxed) && entry->sampleRequested.exchange(false))
+		entry->profiler->RecordSample(ctx);
+}
+
+void CScriptProfiler::RecordSample(asIScriptContext *ctx)
+{
+	// Executed on the thread running the context, so the stack can be inspected safely
+	Stack stack;
+	asUINT levels = ctx->GetCallstackSize();
+	stack.reserve(levels);
+	for (asUINT n = levels; n-- > 0; )
+	{
+		asIScriptFunction *func = ctx->GetFunction(n);
+		if (func == 0)
+			continue; // Nested call from the application
+		stack.push_back(make_pair(string(func->GetDeclaration(true, true)), ctx->GetLineNumber(n)));
+	}
+
+	lock_guard<mutex> lock(m_samplesMutex);
+	m_stacks[stack]++;
+	m_sampleCount++;
+}
+
+vector<SScriptProfileEntry> CScriptProfiler::GetFunctionStats() const
+{
+	map<string, SScriptProfileEntry> functions;
+
+	lock_guard<mutex> lock(m_samplesMutex);
+	for (map<Stack, asUINT>::const_iterator it = m_stacks.begin(); it != m_stacks.end(); ++it)
+	{
+		const Stack &stack = it->first;
+		if (stack.empty())
+			continue;
+
+		// Recursive functions count only once towards the total of a sample
+		set<string> seen;
+		for (size_t n = 0; n < stack.size(); n++)
+		{
+			if (!seen.insert(stack[n].first).second)
+				continue;
+			SScriptProfileEntry &e = functions[stack[n].first];
+			e.function = stack[n].first;
+			e.line = 0;
+			e.totalSamples += it->second;
+		}
+		functions[stack.back().first].selfSamples += it->second;
+	}
+
+	vector<SScriptProfileEntry> result;
+	for (map<string, SScriptProfileEntry>::const_iterator it = functions.begin(); it != functions.end(); ++it)
+		result.push_back(it->second);
+	sort(result.begin(), result.end(), ProfileEntryMoreSamples);
+	return result;
+}
+
+vector<SScriptProfileEntry> CScriptProfiler::GetLineStats() const
+{
+	map<pair<string, int>, SScriptProfileEntry> lines;
+
+	lock_guard<mutex> lock(m_samplesMutex);
+	for (map<Stack, asUINT>::const_iterator it = m_stacks.begin(); it != m_stacks.end(); ++it)
+	{
+		const Stack &stack = it->first;
+		if (stack.empty())
+			continue;
+
+		set<pair<string, int> > seen;
+		for (size_t n = 0; n < stack.size(); n++)
+		{
+			if (!seen.insert(stack[n]).second)
+				continue;
+			SScriptProfileEntry &e = lines[stack[n]];
+			e.function = stack[n].first;
+			e.line = stack[n].second;
+			e.totalSamples += it->second;
+		}
+		lines[stack.back()].selfSamples += it->second;
+	}
+
+	vector<SScriptProfileEntry> result;
+	for (map<pair<string, int>, SScriptProfileEntry>::const_iterator it = lines.begin(); it != lines.end(); ++it)
+		result.push_back(it->second);
+	sort(result.begin(), result.end(), ProfileEntryMoreSamples);
+	return result;
+}
+
+asUINT CScriptProfiler::GetSampleCount() const
+{
+	lock_guard<mutex> lock(m_samplesMutex);
+	return m_sampleCount;
+}
+
+void CScriptProfiler::WriteFoldedStacks(ostream &out, bool withLines) const
+{
+	// Several stacks may fold into one line when the lines are left out
+	map<string, asUINT> folded;
+	{
+		lock_guard<mutex> lock(m_samplesMutex);
+		for (map<Stack, asUINT>::const_iterator it = m_stacks.begin(); it != m_stacks.end(); ++it)
+		{
+			string key;
+			for (size_t n = 0; n < it->first.size(); n++)
+			{
+				if (n > 0)
+					key += ';';
+				// The folded format uses ';' and ' ' as separators
+				for (size_t c = 0; c < it->first[n].first.size(); c++)
+				{
+					char ch = it->first[n].first[c];
+					key += (ch == ';' || ch == ' ') ? '_' : ch;
+				}
+				if (withLines)
+					key += ':' + to_string(it->first[n].second);
+			}
+			folded[key] += it->second;
+		}
+	}
+
+	for (map<string, asUINT>::const_iterator it = folded.begin(); it != folded.end(); ++it)
+		out << it->first << ' ' << it->second << '\n';
+}
+
+void CScriptProfiler::Reset()
+{
+	lock_guard<mutex> lock(m_samplesMutex);
+	m_stacks.clear();
+	m_sampleCount = 0;
+}
+
+END_AS_NAMESPACE
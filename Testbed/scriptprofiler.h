@@ -0,0 +1,110 @@
+//
+// Script sampling profiler
+//
+// A timer thread periodically asks each attached context for a sample. The
+// context isn't inspected from the timer thread, as that would race with the
+// VM; instead a one-shot line callback is armed, which records the call stack
+// (GetFunction()/GetLineNumber()) on the executing thread at the next statement
+// and disarms itself. Between samples the contexts run without any callback.
+//
+// Contexts which already use a line callback of their own (e.g. the timeout in
+// Testbed's main.cpp) must be attached with `hasOwnLineCallback = true` and
+// call CScriptProfiler::OnLineCallback() from it; the profiler then only sets
+// a flag which that callback checks.
+//
+// Samples are aggregated per function (self/total) and per line, and can be
+// exported as folded stacks, the input format of flamegraph.pl and similar tools.
+//
+
+#ifndef SCRIPTPROFILER_H
+#define SCRIPTPROFILER_H
+
+#ifndef ANGELSCRIPT_H
+// Avoid having to inform include path if header is already include before
+#include <angelscript.h>
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+BEGIN_AS_NAMESPACE
+
+// User data slot used to find the profiler state of a context.
+const asPWORD SCRIPTPROFILER_UDATA = 2001;
+
+struct SScriptProfileEntry
+{
+	std::string function; // Declaration, including namespace and object name
+	int         line;     // 0 for per-function entries
+	asUINT      selfSamples;
+	asUINT      totalSamples;
+};
+
+class CScriptProfiler
+{
+public:
+	CScriptProfiler();
+	~CScriptProfiler();
+
+	// Starts the timer thread, sampling every `intervalMicroseconds`.
+	void Start(asUINT intervalMicroseconds = 10000);
+	void Stop();
+	bool IsRunning() const { return m_thread.joinable(); }
+
+	// Attached contexts are kept alive (AddRef) until detached.
+	void Attach(asIScriptContext *ctx, bool hasOwnLineCallback = false);
+	void Detach(asIScriptContext *ctx);
+
+	// To be called from the application's line callback of contexts attached with `hasOwnLineCallback`.
+	static void OnLineCallback(asIScriptContext *ctx);
+
+	// Aggregated results, sorted by sample count, highest first
+	std::vector<SScriptProfileEntry> GetFunctionStats() const;
+	std::vector<SScriptProfileEntry> GetLineStats() const;
+	asUINT GetSampleCount() const;
+
+	// One line per distinct stack: `root;caller;callee count`. With `withLines`
+	// each frame is suffixed with its current line number.
+	void WriteFoldedStacks(std::ostream &out, bool withLines = false) const;
+	void Reset();
+
+protected:
+	struct SContextEntry
+	{
+		CScriptProfiler     *profiler;
+		asIScriptContext    *ctx;
+		bool                 ownLineCallback;
+		std::atomic<bool>    sampleRequested;
+	};
+
+	void ThreadMain();
+	void RequestSamples();
+	void RecordSample(asIScriptContext *ctx);
+	void SampleLineCallback(asIScriptContext *ctx);
+
+	// Guards the list of contexts
+	mutable std::mutex              m_contextsMutex;
+	std::vector<SContextEntry*>     m_contexts;
+
+	// Guards the aggregated samples, taken only when a sample is recorded
+	mutable std::mutex              m_samplesMutex;
+	asUINT                          m_sampleCount;
+	typedef std::vector<std::pair<std::string, int> > Stack; // (function, line), root first
+	std::map<Stack, asUINT>         m_stacks;
+
+	std::thread                     m_thread;
+	std::mutex                      m_threadMutex;
+	std::condition_variable         m_threadWake;
+	bool                            m_stopRequested;
+	asUINT                          m_intervalMicroseconds;
+};
+
+END_AS_NAMESPACE
+
+#endif
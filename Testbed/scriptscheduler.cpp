@@ -0,0 +1,335 @@
+#include "scriptscheduler.h"
+#include <assert.h> // assert()
+#include <string.h> // memset()
+#include <algorithm> // std::push_heap(), std::pop_heap()
+
+using namespace std;
+
+// This macro is used to avoid warnings about unused variables.
+// Usually where the variables are only used in debug mode.
+#define UNUSED_VAR(x) (void)(x)
+
+BEGIN_AS_NAMESPACE
+
+CScriptTask::CScriptTask(asIScriptFunction *func)
+	: m_func(func)
+	, m_ctx(0)
+	, m_state(STATE_READY)
+	, m_wakeTime(0)
+	, m_index(0)
+{
+	if (m_func)
+		m_func->AddRef();
+}
+
+CScriptTask::~CScriptTask()
+{
+	// The scheduler returns the context to the pool before it lets go of the task
+	assert(m_ctx == 0);
+
+	if (m_func)
+		m_func->Release();
+}
+
+CScriptScheduler::CScriptScheduler(asIScriptEngine *engine, asUINT maxResumesPerTick)
+	: m_engine(engine)
+	, m_maxResumesPerTick(maxResumesPerTick)
+	, m_now(0)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+CScriptScheduler::~CScriptScheduler()
+{
+	AbortAll();
+}
+
+void CScriptScheduler::RegisterInterface()
+{
+	int r = 0;
+	UNUSED_VAR(r);
+
+	CScriptTask::RegisterRefCountingObject("ScriptTask", m_engine);
+	r = m_engine->RegisterObjectMethod("ScriptTask", "bool isFinished() const", asMETHOD(CScriptTask, IsFinished), asCALL_THISCALL); assert( r >= 0 );
+	r = m_engine->RegisterFuncdef("void ScriptTaskFunc()"); assert( r >= 0 );
+
+	r = m_engine->RegisterGlobalFunction("ScriptTask@ spawn(ScriptTaskFunc@ func)", asMETHOD(CScriptScheduler, ScriptSpawn), asCALL_THISCALL_ASGLOBAL, this); assert( r >= 0 );
+	r = m_engine->RegisterGlobalFunction("void yield()", asMETHOD(CScriptScheduler, ScriptYield), asCALL_THISCALL_ASGLOBAL, this); assert( r >= 0 );
+	r = m_engine->RegisterGlobalFunction("void sleep(uint ms)", asMETHOD(CScriptScheduler, ScriptSleep), asCALL_THISCALL_ASGLOBAL, this); assert( r >= 0 );
+	r = m_engine->RegisterGlobalFunction("void waitFor(ScriptTask@ task)", asMETHOD(CScriptScheduler, ScriptWaitFor), asCALL_THISCALL_ASGLOBAL, this); assert( r >= 0 );
+}
+
+CScriptTaskPtr CScriptScheduler::Spawn(asIScriptFunction *func)
+{
+	CScriptTaskPtr task = new CScriptTask(func);
+	task.GetRef()->m_index = m_tasks.size();
+	m_tasks.push_back(task);
+	m_ready.push_back(task);
+	m_stats.tasksAlive++;
+	return task;
+}
+
+asUINT CScriptScheduler::Tick(asUINT now)
+{
+	m_now = now;
+
+	// Wake up the sleepers that are due, earliest first
+	while (!m_sleeping.empty() && IsDue(m_sleeping.front().wakeTime, now))
+	{
+		pop_heap(m_sleeping.begin(), m_sleeping.end(), SleeperLater);
+		m_ready.push_back(m_sleeping.back().task);
+		m_sleeping.pop_back();
+	}
+
+	// Only resume the tasks that were ready when the tick started, tasks that
+	// yield during this tick are queued behind them and run on the next one.
+	size_t batch = m_ready.size();
+	if (m_maxResumesPerTick > 0 && batch > m_maxResumesPerTick)
+		batch = m_maxResumesPerTick;
+
+	for (size_t i = 0; i < batch; i++)
+	{
+		CScriptTaskPtr task = m_ready.front();
+		m_ready.pop_front();
+		Resume(task);
+	}
+
+	m_stats.ticks++;
+	m_stats.tasksResumedLastTick = asUINT(batch);
+	m_stats.tasksResumedTotal += batch;
+	return asUINT(batch);
+}
+
+void CScriptScheduler::Resume(CScriptTaskPtr &task)
+{
+	CScriptTask *t = task.GetRef();
+	if (t->m_ctx == 0)
+	{
+		t->m_ctx = AcquireContext();
+		int r = t->m_ctx->Prepare(t->m_func);
+		if (r < 0)
+		{
+			m_engine->WriteMessage("CScriptScheduler", 0, 0, asMSGTYPE_ERROR, "Failed to prepare the context for a task");
+			Finish(t);
+			return;
+		}
+		t->m_ctx->SetUserData(t, SCRIPTSCHEDULER_UDATA);
+	}
+
+	t->m_state = CScriptTask::STATE_READY;
+	int r = t->m_ctx->Execute();
+	if (r != asEXECUTION_SUSPENDED)
+	{
+		if (r == asEXECUTION_EXCEPTION)
+		{
+			const char *section = 0;
+			int line = t->m_ctx->GetExceptionLineNumber(0, &section);
+			m_engine->WriteMessage(section ? section : "", line, 0, asMSGTYPE_ERROR, t->m_ctx->GetExceptionString());
+		}
+		Finish(t);
+		return;
+	}
+
+	// The script function that suspended the context has set the new state
+	switch (t->m_state)
+	{
+	case CScriptTask::STATE_SLEEPING:
+		PushSleeper(task);
+		break;
+	case CScriptTask::STATE_WAITING:
+		if (t->m_waitFor.GetRef()->IsFinished())
+		{
+			t->m_waitFor = nullptr;
+			m_ready.push_back(task);
+		}
+		else
+			t->m_waitFor.GetRef()->m_waiters.push_back(task);
+		break;
+	default:
+		// yield(), or suspended by the application (e.g. line callback)
+		m_ready.push_back(task);
+		break;
+	}
+}
+
+void CScriptScheduler::Finish(CScriptTask *task)
+{
+	if (task->m_ctx)
+	{
+		ReturnContext(task->m_ctx);
+		task->m_ctx = 0;
+	}
+
+	task->m_state = CScriptTask::STATE_FINISHED;
+	task->m_waitFor = nullptr;
+	m_stats.tasksAlive--;
+
+	// The caller holds a reference of its own, so the task outlives its removal
+	size_t index = task->m_index;
+	assert(index < m_tasks.size() && m_tasks[index].GetRef() == task);
+	if (index + 1 < m_tasks.size())
+	{
+		m_tasks[index] = m_tasks.back();
+		m_tasks[index].GetRef()->m_index = index;
+	}
+	m_tasks.pop_back();
+
+	for (size_t i = 0; i < task->m_waiters.size(); i++)
+	{
+		task->m_waiters[i].GetRef()->m_waitFor = nullptr;
+		m_ready.push_back(task->m_waiters[i]);
+	}
+	task->m_waiters.clear();
+}
+
+void CScriptScheduler::PushSleeper(CScriptTaskPtr &task)
+{
+	SSleeper s;
+	s.wakeTime = task.GetRef()->m_wakeTime;
+	s.task = task;
+	m_sleeping.push_back(s);
+	push_heap(m_sleeping.begin(), m_sleeping.end(), SleeperLater);
+}
+
+void CScriptScheduler::AbortAll()
+{
+	// Every task that is alive, whether ready, sleeping or waiting for another
+	vector<CScriptTaskPtr> tasks(m_tasks);
+
+	m_ready.clear();
+	m_sleeping.clear();
+
+	for (size_t i = 0; i < tasks.size(); i++)
+	{
+		CScriptTask *t = tasks[i].GetRef();
+		if (t->IsFinished())
+			continue;
+		if (t->m_ctx)
+			t->m_ctx->Abort();
+		t->m_waiters.clear();
+		Finish(t);
+	}
+
+	for (size_t i = 0; i < m_contextPool.size(); i++)
+		m_contextPool[i]->Release();
+	m_contextPool.clear();
+}
+
+const SScriptSchedulerStats &CScriptScheduler::GetStats()
+{
+	m_stats.contextsPooled = asUINT(m_contextPool.size());
+	m_stats.approxBytesPerSuspendedTask = sizeof(CScriptTask) + size_t(m_engine->GetEngineProperty(asEP_INIT_CONTEXT_STACK_SIZE));
+	return m_stats;
+}
+
+asIScriptContext *CScriptScheduler::AcquireContext()
+{
+	if (!m_contextPool.empty())
+	{
+		asIScriptContext *ctx = m_contextPool.back();
+		m_contextPool.pop_back();
+		m_stats.tasksSuspended++;
+		return ctx;
+	}
+
+	m_stats.contextsCreated++;
+	m_stats.tasksSuspended++;
+	return m_engine->CreateContext();
+}
+
+void CScriptScheduler::ReturnContext(asIScriptContext *ctx)
+{
+	// Unprepare() releases the objects held on the stack but keeps the stack memory for the next task
+	ctx->Unprepare();
+	ctx->SetUserData(0, SCRIPTSCHEDULER_UDATA);
+	m_contextPool.push_back(ctx);
+	m_stats.tasksSuspended--;
+}
+
+CScriptTask *CScriptScheduler::GetRunningTask(const char *funcName)
+{
+	asIScriptContext *ctx = asGetActiveContext();
+	CScriptTask *task = ctx ? static_cast<CScriptTask*>(ctx->GetUserData(SCRIPTSCHEDULER_UDATA)) : 0;
+	if (task == 0 && ctx)
+	{
+		string msg = string(funcName) + "() can only be called from a scheduled task";
+		ctx->SetException(msg.c_str());
+	}
+	return task;
+}
+
+CScriptTask *CScriptScheduler::ScriptSpawn(asIScriptFunction *func)
+{
+	if (func == 0)
+	{
+		asGetActiveContext()->SetException("spawn(): null function");
+		return 0;
+	}
+
+	CScriptTaskPtr task = Spawn(func);
+	func->Release(); // The task holds its own reference
+
+	// Handles returned to the script must carry a reference of their own
+	CScriptTask *ref = task.GetRef();
+	ref->AddRef();
+	return ref;
+}
+
+void CScriptScheduler::ScriptYield()
+{
+	CScriptTask *task = GetRunningTask("yield");
+	if (task == 0)
+		return;
+
+	task->m_state = CScriptTask::STATE_READY;
+	task->m_ctx->Suspend();
+}
+
+void CScriptScheduler::ScriptSleep(asUINT ms)
+{
+	CScriptTask *task = GetRunningTask("sleep");
+	if (task == 0)
+		return;
+
+	task->m_state = CScriptTask::STATE_SLEEPING;
+	task->m_wakeTime = m_now + ms;
+	task->m_ctx->Suspend();
+}
+
+void CScriptScheduler::ScriptWaitFor(CScriptTask *target)
+{
+	// Take over the reference the engine added for the parameter
+	CScriptTaskPtr targetPtr = target;
+
+	CScriptTask *task = GetRunningTask("waitFor");
+	if (task == 0 || target == 0 || target->IsFinished())
+		return;
+
+	if (target == task)
+	{
+		task->m_ctx->SetException("waitFor(): a task cannot wait for itself");
+		return;
+	}
+
+	// Neither task would ever be resumed
+	for (CScriptTask *t = target; t && t->m_state == CScriptTask::STATE_WAITING; t = t->m_waitFor.GetRef())
+	{
+		if (t->m_waitFor.GetRef() == task)
+		{
+			task->m_ctx->SetException("waitFor(): the task waits for the caller, which would never finish");
+			return;
+		}
+	}
+
+	task->m_state = CScriptTask::STATE_WAITING;
+	task->m_waitFor = targetPtr;
+	task->m_ctx->Suspend();
+}
+
+bool CScriptScheduler::SleeperLater(const SSleeper &a, const SSleeper &b)
+{
+	// Inverted comparison turns the std heap functions into a min-heap
+	return int(a.wakeTime - b.wakeTime) > 0;
+}
+
+END_AS_NAMESPACE
@@ -0,0 +1,144 @@
+//
+// Script scheduler
+//
+// Runs many long-lived script functions ("tasks") cooperatively on top of a
+// small pool of script contexts. A task runs until it calls one of the
+// registered script functions below, which suspend the context; the scheduler
+// resumes it on a later Tick() once it becomes ready again.
+//
+// Script interface:
+//
+//   funcdef void ScriptTaskFunc();
+//   ScriptTask@ spawn(ScriptTaskFunc@ func)  - start a new task on the next tick
+//   void yield()                             - resume on the next tick
+//   void sleep(uint ms)                      - resume once `ms` milliseconds elapsed
+//   void waitFor(ScriptTask@ task)           - resume once `task` has finished; raises a script
+//                                              exception if `task` waits for the caller, directly
+//                                              or through other tasks
+//   bool ScriptTask::isFinished() const
+//
+
+#ifndef SCRIPTSCHEDULER_H
+#define SCRIPTSCHEDULER_H
+
+#ifndef ANGELSCRIPT_H
+// Avoid having to inform include path if header is already include before
+#include <angelscript.h>
+#endif
+
+#include "../RefCountingObject.h"
+#include "../RefCountingObjectPtr.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+BEGIN_AS_NAMESPACE
+
+// User data slot used to find the running task from inside registered functions.
+// Applications that use context user data themselves must pick a different id.
+const asPWORD SCRIPTSCHEDULER_UDATA = 2000;
+
+class CScriptScheduler;
+
+class CScriptTask : public RefCountingObject<CScriptTask>
+{
+public:
+	enum State
+	{
+		STATE_READY,    // Queued to be resumed on the next tick
+		STATE_SLEEPING, // Waiting until `m_wakeTime`
+		STATE_WAITING,  // Waiting until `m_waitFor` finishes
+		STATE_FINISHED  // Returned, aborted or raised an exception
+	};
+
+	CScriptTask(asIScriptFunction *func);
+	~CScriptTask();
+
+	bool IsFinished() const { return m_state == STATE_FINISHED; }
+	State GetState() const { return m_state; }
+
+protected:
+	friend class CScriptScheduler;
+
+	asIScriptFunction                      *m_func;
+	asIScriptContext                       *m_ctx;      // Borrowed from the pool while the task is in progress.
+	State                                   m_state;
+	asUINT                                  m_wakeTime;
+	size_t                                  m_index;    // In CScriptScheduler::m_tasks while alive
+	RefCountingObjectPtr<CScriptTask>       m_waitFor;
+	std::vector<RefCountingObjectPtr<CScriptTask>> m_waiters; // Tasks blocked in waitFor() on this task.
+};
+
+typedef RefCountingObjectPtr<CScriptTask> CScriptTaskPtr;
+
+struct SScriptSchedulerStats
+{
+	asUINT ticks;
+	asUINT tasksResumedLastTick;
+	asQWORD tasksResumedTotal;
+	asUINT tasksAlive;             // Spawned and not yet finished
+	asUINT tasksSuspended;         // Alive tasks that currently own a context
+	asUINT contextsCreated;
+	asUINT contextsPooled;         // Idle contexts kept for reuse
+	size_t approxBytesPerSuspendedTask; // Task object + initial context stack; excludes objects referenced from the stack
+};
+
+class CScriptScheduler
+{
+public:
+	// `maxResumesPerTick` limits how many tasks are resumed by a single Tick(); 0 means unlimited.
+	CScriptScheduler(asIScriptEngine *engine, asUINT maxResumesPerTick = 0);
+	~CScriptScheduler();
+
+	// Registers the script interface described at the top of this file.
+	void RegisterInterface();
+
+	// Queues `func` (a `void f()` function) to start on the next tick.
+	CScriptTaskPtr Spawn(asIScriptFunction *func);
+
+	// Wakes sleeping tasks whose time has come and resumes the ready ones in a batch.
+	// `now` is a millisecond clock, e.g. timeGetTime(). Returns the number of tasks resumed.
+	asUINT Tick(asUINT now);
+
+	// Aborts all tasks, including those waiting for others, and releases the pooled contexts.
+	void AbortAll();
+
+	void SetMaxResumesPerTick(asUINT max) { m_maxResumesPerTick = max; }
+	const SScriptSchedulerStats &GetStats();
+
+protected:
+	struct SSleeper
+	{
+		asUINT         wakeTime;
+		CScriptTaskPtr task;
+	};
+
+	asIScriptContext *AcquireContext();
+	void              ReturnContext(asIScriptContext *ctx);
+	void              Resume(CScriptTaskPtr &task);
+	void              Finish(CScriptTask *task);
+	void              PushSleeper(CScriptTaskPtr &task);
+	static bool       SleeperLater(const SSleeper &a, const SSleeper &b);
+	static bool       IsDue(asUINT wakeTime, asUINT now) { return int(wakeTime - now) <= 0; }
+	static CScriptTask *GetRunningTask(const char *funcName);
+
+	// Script interface, registered with asCALL_THISCALL_ASGLOBAL
+	CScriptTask *ScriptSpawn(asIScriptFunction *func);
+	void         ScriptYield();
+	void         ScriptSleep(asUINT ms);
+	void         ScriptWaitFor(CScriptTask *task);
+
+	asIScriptEngine                *m_engine;
+	asUINT                          m_maxResumesPerTick;
+	asUINT                          m_now;
+	std::vector<CScriptTaskPtr>     m_tasks;    // Every task spawned and not yet finished
+	std::deque<CScriptTaskPtr>      m_ready;
+	std::vector<SSleeper>           m_sleeping; // Min-heap by wake time
+	std::vector<asIScriptContext*>  m_contextPool;
+	SScriptSchedulerStats           m_stats;
+};
+
+END_AS_NAMESPACE
+
+#endif
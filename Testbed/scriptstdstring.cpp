@@ -1,11 +1,22 @@
 #include "scriptstdstring.h"
+#include "scriptstringsearch.h"
 #include <assert.h> // assert()
-#include <sstream>  // std::stringstream
+#include <charconv> // std::to_chars()
 #include <string.h> // strstr()
 #include <stdio.h>	// sprintf()
 #include <stdlib.h> // strtod()
+#include <math.h>   // isfinite()
+#include <mutex>         // std::mutex
+#include <atomic>        // std::atomic
+#include <string_view>   // std::string_view
+#include <vector>        // std::vector
+#include <unordered_set> // std::unordered_set
+#include <type_traits>   // std::aligned_storage
+#include <new>           // placement new
+#include <algorithm>     // std::push_heap(), std::pop_heap()
+#include <chrono>        // std::chrono::steady_clock
 #ifndef __psp2__
-	#include <locale.h> // setlocale()
+	#include <locale.h> // setlocale(), localeconv()
 #endif
 
 using namespace std;
@@ -14,76 +25,339 @@ using namespace std;
 // Usually where the variables are only used in debug mode.
 #define UNUSED_VAR(x) (void)(x)
 
-#ifdef AS_CAN_USE_CPP11
-// The string factory doesn't need to keep a specific order in the
-// cache, so the unordered_map is faster than the ordinary map
-#include <unordered_map>  // std::unordered_map
-BEGIN_AS_NAMESPACE
-typedef unordered_map<string, int> map_t;
-END_AS_NAMESPACE
-#else
-#include <map>      // std::map
-BEGIN_AS_NAMESPACE
-typedef map<string, int> map_t;
-END_AS_NAMESPACE
-#endif
+// The string factory is shared by all engines and all threads building modules,
+// so the cache is split into shards with their own lock, chosen by the string's hash.
+// The reference count of each constant is atomic, which lets ReleaseStringConstant()
+// drop all but the last reference without taking any lock.
 
 BEGIN_AS_NAMESPACE
+
+// The returned string constant points to `str`, which is the first member,
+// so the entry can be found from the pointer the engine hands back.
+struct SStringConstant
+{
+	SStringConstant(string_view s, size_t h) : str(s), hash(h), refCount(0) {}
+
+	string           str;
+	size_t           hash;
+	std::atomic<int> refCount;
+};
+
+// Storage for the entries of one shard. The entries have a fixed size, so instead
+// of a heap allocation per entry they are carved out of large blocks, and released
+// entries are reused through a free list. Only the characters of strings that don't
+// fit in std::string's internal buffer are still allocated separately, as the
+// engine expects the constants to be ordinary std::string objects.
+class CStringConstantPool
+{
+public:
+	static const size_t ENTRIES_PER_BLOCK = 256;
+
+	CStringConstantPool() : freeList(0), nextInBlock(0), endOfBlock(0) {}
+	~CStringConstantPool()
+	{
+		for (size_t n = 0; n < blocks.size(); n++)
+			delete[] blocks[n];
+	}
+
+	SStringConstant *Create(string_view str, size_t hash)
+	{
+		USlot *slot;
+		if (freeList)
+		{
+			slot = freeList;
+			freeList = freeList->next;
+		}
+		else
+		{
+			if (nextInBlock == endOfBlock)
+			{
+				nextInBlock = new USlot[ENTRIES_PER_BLOCK];
+				endOfBlock = nextInBlock + ENTRIES_PER_BLOCK;
+				blocks.push_back(nextInBlock);
+			}
+			slot = nextInBlock++;
+		}
+		return new(&slot->entry) SStringConstant(str, hash);
+	}
+
+	void Destroy(SStringConstant *constant)
+	{
+		constant->~SStringConstant();
+		USlot *slot = reinterpret_cast<USlot*>(constant);
+		slot->next = freeList;
+		freeList = slot;
+	}
+
+	size_t GetMemoryUsage() const
+	{
+		return blocks.size() * ENTRIES_PER_BLOCK * sizeof(USlot);
+	}
+
+protected:
+	union USlot
+	{
+		USlot *next;
+		std::aligned_storage<sizeof(SStringConstant), alignof(SStringConstant)>::type entry;
+	};
+
+	vector<USlot*> blocks;
+	USlot         *freeList;
+	USlot         *nextInBlock;
+	USlot         *endOfBlock;
+};
+
+// Open addressing hash table with linear probing, keyed by the string's hash.
+// Looking up a constant only needs a string_view of the script's literal, so
+// finding an existing constant doesn't allocate anything.
+class CStringConstantTable
+{
+public:
+	CStringConstantTable() : slots(0), capacity(0), count(0) {}
+	~CStringConstantTable() { delete[] slots; }
+
+	SStringConstant *Find(string_view str, size_t hash) const
+	{
+		if (count == 0)
+			return 0;
+		for (size_t i = hash & (capacity - 1); slots[i].constant; i = (i + 1) & (capacity - 1))
+		{
+			if (slots[i].hash == hash && string_view(slots[i].constant->str) == str)
+				return slots[i].constant;
+		}
+		return 0;
+	}
+
+	bool Contains(const SStringConstant *constant) const
+	{
+		return IndexOf(constant) != capacity;
+	}
+
+	// The constant must not be in the table yet
+	void Insert(SStringConstant *constant)
+	{
+		// Keep the load factor at or below 3/4
+		if ((count + 1) * 4 > capacity * 3)
+			Rehash(capacity ? capacity * 2 : 64);
+		Place(constant);
+		count++;
+	}
+
+	void Erase(const SStringConstant *constant)
+	{
+		size_t i = IndexOf(constant);
+		if (i == capacity)
+			return;
+
+		// Move the following entries of the probe sequence back, so lookups
+		// never stop early at the gap and no tombstones are needed
+		const size_t mask = capacity - 1;
+		slots[i].constant = 0;
+		for (size_t j = (i + 1) & mask; slots[j].constant; j = (j + 1) & mask)
+		{
+			size_t home = slots[j].hash & mask;
+			bool inRange = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+			if (inRange)
+				continue;
+			slots[i] = slots[j];
+			slots[j].constant = 0;
+			i = j;
+		}
+		count--;
+	}
+
+	size_t Size() const { return count; }
+
+	size_t GetMemoryUsage() const { return capacity * sizeof(SSlot); }
+
+	template<class F>
+	void ForEach(F f) const
+	{
+		for (size_t n = 0; n < capacity; n++)
+		{
+			if (slots[n].constant)
+				f(*slots[n].constant);
+		}
+	}
+
+protected:
+	struct SSlot
+	{
+		size_t           hash;
+		SStringConstant *constant;
+	};
+
+	size_t IndexOf(const SStringConstant *constant) const
+	{
+		if (count == 0)
+			return capacity;
+		for (size_t i = constant->hash & (capacity - 1); slots[i].constant; i = (i + 1) & (capacity - 1))
+		{
+			if (slots[i].constant == constant)
+				return i;
+		}
+		return capacity;
+	}
+
+	void Place(SStringConstant *constant)
+	{
+		size_t i = constant->hash & (capacity - 1);
+		while (slots[i].constant)
+			i = (i + 1) & (capacity - 1);
+		slots[i].hash = constant->hash;
+		slots[i].constant = constant;
+	}
+
+	void Rehash(size_t newCapacity)
+	{
+		SSlot *oldSlots = slots;
+		size_t oldCapacity = capacity;
+
+		slots = new SSlot[newCapacity]();
+		capacity = newCapacity;
+		for (size_t n = 0; n < oldCapacity; n++)
+		{
+			if (oldSlots[n].constant)
+				Place(oldSlots[n].constant);
+		}
+		delete[] oldSlots;
+	}
+
+	SSlot  *slots;
+	size_t  capacity; // Power of 2
+	size_t  count;
+};
+
 class CStdStringFactory : public asIStringFactory
 {
 public:
+	// Must be a power of 2
+	static const asUINT SHARD_COUNT = 32;
+
 	CStdStringFactory() {}
 	~CStdStringFactory() 
 	{
 		// The script engine must release each string 
 		// constant that it has requested
-		assert(stringCache.size() == 0);
+		assert(GetCacheSize() == 0);
 	}
 
 	const void *GetStringConstant(const char *data, asUINT length)
 	{
-		// The string factory might be modified from multiple 
-		// threads, so it is necessary to use a mutex.
-		asAcquireExclusiveLock();
-		
-		string str(data, length);
-		map_t::iterator it = stringCache.find(str);
-		if (it != stringCache.end())
-			it->second++;
+		string_view key(data, length);
+		size_t hash = std::hash<string_view>()(key);
+		SShard &shard = shards[ShardIndex(hash)];
+
+		LockShard(shard);
+
+		SStringConstant *constant = shard.table.Find(key, hash);
+		if (constant == 0)
+		{
+			constant = shard.pool.Create(key, hash);
+			shard.table.Insert(constant);
+#ifndef NDEBUG
+			shard.entries.insert(constant);
+#endif
+			shard.misses++;
+		}
 		else
-			it = stringCache.insert(map_t::value_type(str, 1)).first;
+			shard.hits++;
+		// Increased while holding the lock, so a concurrent release of the last reference can't delete it
+		constant->refCount.fetch_add(1, std::memory_order_relaxed);
+
+		shard.lock.unlock();
 
-		asReleaseExclusiveLock();
-		
-		return reinterpret_cast<const void*>(&it->first);
+		return reinterpret_cast<const void*>(&constant->str);
 	}
 
+	// `str` must have been returned by GetStringConstant() or FindStringConstant(),
+	// which the engine guarantees. Only debug builds check it and return asERROR
+	// for other pointers; release builds would decrease a count in foreign memory.
 	int  ReleaseStringConstant(const void *str)
 	{
 		if (str == 0)
 			return asERROR;
 
+		SStringConstant *constant = reinterpret_cast<SStringConstant*>(const_cast<void*>(str));
+
+#ifndef NDEBUG
+		if (!IsStringConstant(constant))
+			return asERROR;
+#endif
+
+		// Fast path: as long as this isn't the last reference, nobody else can
+		// remove the entry, so the count can be decreased without a lock
+		int refs = constant->refCount.load(std::memory_order_relaxed);
+		while (refs > 1)
+		{
+			if (constant->refCount.compare_exchange_weak(refs, refs - 1, std::memory_order_release, std::memory_order_relaxed))
+				return asSUCCESS;
+		}
+
+		// Possibly the last reference; decide under the lock, as GetStringConstant()
+		// may be handing out a new reference to the same entry concurrently
+		SShard &shard = shards[ShardIndex(constant->hash)];
+		LockShard(shard);
+
 		int ret = asSUCCESS;
-		
-		// The string factory might be modified from multiple 
-		// threads, so it is necessary to use a mutex.
-		asAcquireExclusiveLock();
-		
-		map_t::iterator it = stringCache.find(*reinterpret_cast<const string*>(str));
-		if (it == stringCache.end())
+		if (!shard.table.Contains(constant))
 			ret = asERROR;
-		else
+		else if (constant->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
 		{
-			it->second--;
-			if (it->second == 0)
-				stringCache.erase(it);
+			shard.table.Erase(constant);
+#ifndef NDEBUG
+			shard.entries.erase(constant);
+#endif
+			shard.pool.Destroy(constant);
 		}
-		
-		asReleaseExclusiveLock();
-		
+
+		shard.lock.unlock();
+
 		return ret;
 	}
 
+#ifndef NDEBUG
+	// Compares the address only, as a foreign pointer can't be dereferenced.
+	// The shard isn't known without the hash, so all of them are searched.
+	bool IsStringConstant(const SStringConstant *constant)
+	{
+		for (asUINT n = 0; n < SHARD_COUNT; n++)
+		{
+			SShard &shard = shards[n];
+			LockShard(shard);
+			bool found = shard.entries.count(constant) != 0;
+			shard.lock.unlock();
+			if (found)
+				return true;
+		}
+		return false;
+	}
+#endif
+
+	// Like GetStringConstant(), but doesn't add the constant if it isn't cached
+	const void *FindStringConstant(const char *data, asUINT length)
+	{
+		string_view key(data, length);
+		size_t hash = std::hash<string_view>()(key);
+		SShard &shard = shards[ShardIndex(hash)];
+
+		LockShard(shard);
+		SStringConstant *constant = shard.table.Find(key, hash);
+		if (constant)
+			constant->refCount.fetch_add(1, std::memory_order_relaxed);
+		shard.lock.unlock();
+
+		return constant ? reinterpret_cast<const void*>(&constant->str) : 0;
+	}
+
+	// Adds a reference to a constant the caller already holds a reference to,
+	// so the entry can't be removed concurrently and no lock is needed
+	void AddRefStringConstant(const void *str)
+	{
+		SStringConstant *constant = reinterpret_cast<SStringConstant*>(const_cast<void*>(str));
+		constant->refCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
 	int  GetRawStringData(const void *str, char *data, asUINT *length) const
 	{
 		if (str == 0)
@@ -98,15 +372,133 @@ public:
 		return asSUCCESS;
 	}
 
-	// THe access to the string cache is protected with the common mutex provided by AngelScript
-	map_t stringCache;
+	size_t GetCacheSize()
+	{
+		size_t size = 0;
+		for (asUINT n = 0; n < SHARD_COUNT; n++)
+		{
+			shards[n].lock.lock();
+			size += shards[n].table.Size();
+			shards[n].lock.unlock();
+		}
+		return size;
+	}
+
+	SStdStringCacheStats GetStats()
+	{
+		// Characters up to this length are stored within the std::string itself
+		const size_t inlineCapacity = string().capacity();
+
+		SStdStringCacheStats stats = {};
+		for (asUINT n = 0; n < SHARD_COUNT; n++)
+		{
+			SShard &shard = shards[n];
+			lock_guard<mutex> guard(shard.lock);
+			stats.entries += shard.table.Size();
+			stats.memoryUsage += shard.table.GetMemoryUsage() + shard.pool.GetMemoryUsage();
+			shard.table.ForEach([&](const SStringConstant &constant) {
+				stats.stringBytes += constant.str.length();
+				if (constant.str.capacity() > inlineCapacity)
+					stats.memoryUsage += constant.str.capacity() + 1;
+			});
+			stats.hits += shard.hits;
+			stats.misses += shard.misses;
+			stats.contendedLocks += shard.contendedLocks;
+			stats.lockWaitNs += shard.lockWaitNs;
+		}
+		return stats;
+	}
+
+	vector<SStdStringCacheEntry> GetTopEntries(asUINT count)
+	{
+		// Min-heap of the best entries so far, so only those get copied out of the shards
+		struct SMoreRefs
+		{
+			bool operator()(const SStdStringCacheEntry &a, const SStdStringCacheEntry &b) const { return a.refCount > b.refCount; }
+		};
+
+		vector<SStdStringCacheEntry> top;
+		if (count == 0)
+			return top;
+		top.reserve(count);
+		for (asUINT n = 0; n < SHARD_COUNT; n++)
+		{
+			lock_guard<mutex> guard(shards[n].lock);
+			shards[n].table.ForEach([&](const SStringConstant &constant) {
+				asUINT refs = asUINT(constant.refCount.load(memory_order_relaxed));
+				if (top.size() == count)
+				{
+					if (refs <= top.front().refCount)
+						return;
+					pop_heap(top.begin(), top.end(), SMoreRefs());
+					top.pop_back();
+				}
+				SStdStringCacheEntry entry = { constant.str, refs };
+				top.push_back(entry);
+				push_heap(top.begin(), top.end(), SMoreRefs());
+			});
+		}
+		sort_heap(top.begin(), top.end(), SMoreRefs());
+		return top;
+	}
+
+	void ResetCounters()
+	{
+		for (asUINT n = 0; n < SHARD_COUNT; n++)
+		{
+			lock_guard<mutex> guard(shards[n].lock);
+			shards[n].hits = 0;
+			shards[n].misses = 0;
+			shards[n].contendedLocks = 0;
+			shards[n].lockWaitNs = 0;
+		}
+	}
+
+protected:
+	struct SShard
+	{
+		SShard() : hits(0), misses(0), contendedLocks(0), lockWaitNs(0) {}
+
+		std::mutex           lock;
+		CStringConstantTable table;
+		CStringConstantPool  pool;
+#ifndef NDEBUG
+		// Addresses of the entries in the table, for IsStringConstant()
+		std::unordered_set<const SStringConstant*> entries;
+#endif
+
+		// Only changed while holding the lock
+		asQWORD              hits;
+		asQWORD              misses;
+		asQWORD              contendedLocks;
+		asQWORD              lockWaitNs;
+	};
+
+	static void LockShard(SShard &shard)
+	{
+		// The clock is only read when the lock is taken, so the uncontended path costs nothing extra
+		if (shard.lock.try_lock())
+			return;
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		shard.lock.lock();
+		shard.contendedLocks++;
+		shard.lockWaitNs += asQWORD(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+	}
+
+	static asUINT ShardIndex(size_t h)
+	{
+		// The table within a shard uses the low bits, so select the shard with the high ones
+		return asUINT(h >> (sizeof(size_t) * 8 - 5)) & (SHARD_COUNT - 1);
+	}
+
+	SShard shards[SHARD_COUNT];
 };
 
 static CStdStringFactory *stringFactory = 0;
 
-// TODO: Make this public so the application can also use the string 
-//       factory and share the string constants if so desired, or to
-//       monitor the size of the string factory cache.
+// The application reaches the factory through GetStdStringFactory() and
+// the cache statistics through GetStdStringCacheStats(), see scriptstdstring.h
 CStdStringFactory *GetStdStringFactorySingleton()
 {
 	if( stringFactory == 0 )
@@ -131,7 +523,7 @@ public:
 			// the application might crash. Not deleting the cache would
 			// lead to a memory leak, but since this is only happens when the
 			// application is shutting down anyway, it is not important.
-			if (stringFactory->stringCache.empty())
+			if (stringFactory->GetCacheSize() == 0)
 			{
 				delete stringFactory;
 				stringFactory = 0;
@@ -142,6 +534,103 @@ public:
 
 static CStdStringFactoryCleaner cleaner;
 
+asIStringFactory *GetStdStringFactory()
+{
+	return GetStdStringFactorySingleton();
+}
+
+SStdStringCacheStats GetStdStringCacheStats()
+{
+	return GetStdStringFactorySingleton()->GetStats();
+}
+
+vector<SStdStringCacheEntry> GetStdStringCacheTopEntries(asUINT count)
+{
+	return GetStdStringFactorySingleton()->GetTopEntries(count);
+}
+
+void ResetStdStringCacheCounters()
+{
+	GetStdStringFactorySingleton()->ResetCounters();
+}
+
+const string *InternStdString(const char *data, asUINT length)
+{
+	return reinterpret_cast<const string*>(GetStdStringFactorySingleton()->GetStringConstant(data, length));
+}
+
+const string *FindInternedStdString(const char *data, asUINT length)
+{
+	return reinterpret_cast<const string*>(GetStdStringFactorySingleton()->FindStringConstant(data, length));
+}
+
+void AddRefInternedStdString(const string *str)
+{
+	GetStdStringFactorySingleton()->AddRefStringConstant(str);
+}
+
+void ReleaseInternedStdString(const string *str)
+{
+	GetStdStringFactorySingleton()->ReleaseStringConstant(str);
+}
+
+
+// Buffers of destroyed script strings, reused for the results of `+`.
+//
+// The script gives no way to tell that the left operand of the second `+` in
+// `a + b + c` is a temporary, so its buffer can't be taken over. But that
+// temporary is destroyed right after the `+`, and its buffer then goes to the
+// result of the next one. A chain thus cycles between a few buffers instead of
+// allocating one per `+`, and a chain run in a loop stops allocating at all.
+struct SConcatBufferPool
+{
+	static const size_t COUNT = 4;
+	// Larger buffers are freed as usual, so a result doesn't hold on to more
+	// memory than that when it's kept
+	static const size_t MAX_CAPACITY = 1024;
+
+	SConcatBufferPool() : count(0), inlineCapacity(string().capacity()) {}
+	~SConcatBufferPool() { concatBufferPoolDestroyed = true; }
+
+	string buffers[COUNT];
+	size_t count;
+	size_t inlineCapacity; // Of the small string optimization, nothing to reuse
+
+	// Strings may still be destroyed after the pool at thread exit
+	static thread_local bool concatBufferPoolDestroyed;
+};
+
+thread_local bool SConcatBufferPool::concatBufferPoolDestroyed = false;
+static thread_local SConcatBufferPool concatBufferPool;
+
+// Keeps the buffer of a script string that is about to be destroyed
+static void RecycleStringBuffer(string &str)
+{
+	if( SConcatBufferPool::concatBufferPoolDestroyed )
+		return;
+
+	SConcatBufferPool &pool = concatBufferPool;
+	size_t capacity = str.capacity();
+	if( capacity > pool.inlineCapacity && capacity <= SConcatBufferPool::MAX_CAPACITY && pool.count < SConcatBufferPool::COUNT )
+		pool.buffers[pool.count++].swap(str);
+}
+
+// An empty string with room for `length` chars, for the result of a `+`
+static string NewConcatResult(size_t length)
+{
+	string ret;
+	if( !SConcatBufferPool::concatBufferPoolDestroyed )
+	{
+		SConcatBufferPool &pool = concatBufferPool;
+		if( pool.count > 0 )
+		{
+			ret.swap(pool.buffers[--pool.count]);
+			ret.clear();
+		}
+	}
+	ret.reserve(length);
+	return ret;
+}
 
 static void ConstructString(string *thisPointer)
 {
@@ -155,6 +644,7 @@ static void CopyConstructString(const string &other, string *thisPointer)
 
 static void DestructString(string *thisPointer)
 {
+	RecycleStringBuffer(*thisPointer);
 	thisPointer->~string();
 }
 
@@ -179,154 +669,195 @@ static bool StringIsEmpty(const string &str)
 	return str.empty();
 }
 
-static string &AssignUInt64ToString(asQWORD i, string &dest)
+// Conversion of numbers and bools to text, shared by all the operators below.
+// The value is formatted into a buffer on the stack with std::to_chars and then
+// copied into the destination, without the locale handling and allocations of an
+// ostringstream. The text is the same as `ostream << value` gives with the classic
+// locale: integers in decimal, and floating point values like printf's "%g".
+// Also used by other string types, see scriptstdstring.h.
+
+size_t StringNumberToChars(char *buf, asINT64 value)
+{
+	return size_t(to_chars(buf, buf + STRING_NUMBER_BUFFER_SIZE, value).ptr - buf);
+}
+
+size_t StringNumberToChars(char *buf, asQWORD value)
+{
+	return size_t(to_chars(buf, buf + STRING_NUMBER_BUFFER_SIZE, value).ptr - buf);
+}
+
+size_t StringNumberToChars(char *buf, double value)
 {
-	ostringstream stream;
-	stream << i;
-	dest = stream.str();
+#ifdef __cpp_lib_to_chars
+	// Equals "%g", ostream's default precision is 6 as well
+	return size_t(to_chars(buf, buf + STRING_NUMBER_BUFFER_SIZE, value, chars_format::general, 6).ptr - buf);
+#else
+	// Standard libraries without floating point to_chars. Unlike ostream, this
+	// follows the decimal point of the C locale if the application changed it.
+	return size_t(snprintf(buf, STRING_NUMBER_BUFFER_SIZE, "%g", value));
+#endif
+}
+
+size_t StringNumberToChars(char *buf, float value)
+{
+	// ostream prints floats as doubles too
+	return StringNumberToChars(buf, double(value));
+}
+
+size_t StringNumberToChars(char *buf, bool value)
+{
+	if( value )
+	{
+		memcpy(buf, "true", 4);
+		return 4;
+	}
+	memcpy(buf, "false", 5);
+	return 5;
+}
+
+template<class T>
+static string &AssignNumberToString(T value, string &dest)
+{
+	char buf[STRING_NUMBER_BUFFER_SIZE];
+	dest.assign(buf, StringNumberToChars(buf, value));
 	return dest;
 }
 
-static string &AddAssignUInt64ToString(asQWORD i, string &dest)
+template<class T>
+static string &AddAssignNumberToString(T value, string &dest)
 {
-	ostringstream stream;
-	stream << i;
-	dest += stream.str();
+	char buf[STRING_NUMBER_BUFFER_SIZE];
+	dest.append(buf, StringNumberToChars(buf, value));
 	return dest;
 }
 
+template<class T>
+static string AddStringNumber(const string &str, T value)
+{
+	char buf[STRING_NUMBER_BUFFER_SIZE];
+	size_t length = StringNumberToChars(buf, value);
+	string ret = NewConcatResult(str.length() + length);
+	ret.append(str).append(buf, length);
+	return ret;
+}
+
+template<class T>
+static string AddNumberString(T value, const string &str)
+{
+	char buf[STRING_NUMBER_BUFFER_SIZE];
+	size_t length = StringNumberToChars(buf, value);
+	string ret = NewConcatResult(length + str.length());
+	ret.append(buf, length).append(str);
+	return ret;
+}
+
+static string &AssignUInt64ToString(asQWORD i, string &dest)
+{
+	return AssignNumberToString(i, dest);
+}
+
+static string &AddAssignUInt64ToString(asQWORD i, string &dest)
+{
+	return AddAssignNumberToString(i, dest);
+}
+
 static string AddStringUInt64(const string &str, asQWORD i)
 {
-	ostringstream stream;
-	stream << i;
-	return str + stream.str();
+	return AddStringNumber(str, i);
 }
 
 static string AddInt64String(asINT64 i, const string &str)
 {
-	ostringstream stream;
-	stream << i;
-	return stream.str() + str;
+	return AddNumberString(i, str);
 }
 
 static string &AssignInt64ToString(asINT64 i, string &dest)
 {
-	ostringstream stream;
-	stream << i;
-	dest = stream.str();
-	return dest;
+	return AssignNumberToString(i, dest);
 }
 
 static string &AddAssignInt64ToString(asINT64 i, string &dest)
 {
-	ostringstream stream;
-	stream << i;
-	dest += stream.str();
-	return dest;
+	return AddAssignNumberToString(i, dest);
 }
 
 static string AddStringInt64(const string &str, asINT64 i)
 {
-	ostringstream stream;
-	stream << i;
-	return str + stream.str();
+	return AddStringNumber(str, i);
 }
 
 static string AddUInt64String(asQWORD i, const string &str)
 {
-	ostringstream stream;
-	stream << i;
-	return stream.str() + str;
+	return AddNumberString(i, str);
 }
 
 static string &AssignDoubleToString(double f, string &dest)
 {
-	ostringstream stream;
-	stream << f;
-	dest = stream.str();
-	return dest;
+	return AssignNumberToString(f, dest);
 }
 
 static string &AddAssignDoubleToString(double f, string &dest)
 {
-	ostringstream stream;
-	stream << f;
-	dest += stream.str();
-	return dest;
+	return AddAssignNumberToString(f, dest);
 }
 
 static string &AssignFloatToString(float f, string &dest)
 {
-	ostringstream stream;
-	stream << f;
-	dest = stream.str();
-	return dest;
+	return AssignNumberToString(f, dest);
 }
 
 static string &AddAssignFloatToString(float f, string &dest)
 {
-	ostringstream stream;
-	stream << f;
-	dest += stream.str();
-	return dest;
+	return AddAssignNumberToString(f, dest);
 }
 
 static string &AssignBoolToString(bool b, string &dest)
 {
-	ostringstream stream;
-	stream << (b ? "true" : "false");
-	dest = stream.str();
-	return dest;
+	return AssignNumberToString(b, dest);
 }
 
 static string &AddAssignBoolToString(bool b, string &dest)
 {
-	ostringstream stream;
-	stream << (b ? "true" : "false");
-	dest += stream.str();
-	return dest;
+	return AddAssignNumberToString(b, dest);
+}
+
+// AngelScript signature:
+// string string::opAdd(const string &in) const
+static string AddStrings(const string &a, const string &b)
+{
+	string ret = NewConcatResult(a.length() + b.length());
+	ret.append(a).append(b);
+	return ret;
 }
 
 static string AddStringDouble(const string &str, double f)
 {
-	ostringstream stream;
-	stream << f;
-	return str + stream.str();
+	return AddStringNumber(str, f);
 }
 
 static string AddDoubleString(double f, const string &str)
 {
-	ostringstream stream;
-	stream << f;
-	return stream.str() + str;
+	return AddNumberString(f, str);
 }
 
 static string AddStringFloat(const string &str, float f)
 {
-	ostringstream stream;
-	stream << f;
-	return str + stream.str();
+	return AddStringNumber(str, f);
 }
 
 static string AddFloatString(float f, const string &str)
 {
-	ostringstream stream;
-	stream << f;
-	return stream.str() + str;
+	return AddNumberString(f, str);
 }
 
 static string AddStringBool(const string &str, bool b)
 {
-	ostringstream stream;
-	stream << (b ? "true" : "false");
-	return str + stream.str();
+	return AddStringNumber(str, b);
 }
 
 static string AddBoolString(bool b, const string &str)
 {
-	ostringstream stream;
-	stream << (b ? "true" : "false");
-	return stream.str() + str;
+	return AddNumberString(b, str);
 }
 
 static char *StringCharAt(unsigned int i, string &str)
@@ -363,7 +894,7 @@ static int StringCmp(const string &a, const string &b)
 static int StringFindFirst(const string &sub, asUINT start, const string &str)
 {
 	// We don't register the method directly because the argument types change between 32bit and 64bit platforms
-	return (int)str.find(sub, (size_t)(start < 0 ? string::npos : start));
+	return (int)StringSearchFind(str.data(), str.length(), sub.data(), sub.length(), (size_t)(start < 0 ? string::npos : start));
 }
 
 // This function returns the index of the first position where the one of the bytes in substring
@@ -375,7 +906,7 @@ static int StringFindFirst(const string &sub, asUINT start, const string &str)
 static int StringFindFirstOf(const string &sub, asUINT start, const string &str)
 {
 	// We don't register the method directly because the argument types change between 32bit and 64bit platforms
-	return (int)str.find_first_of(sub, (size_t)(start < 0 ? string::npos : start));
+	return (int)StringSearchFindFirstOf(str.data(), str.length(), sub.data(), sub.length(), (size_t)(start < 0 ? string::npos : start));
 }
 
 // This function returns the index of the last position where the one of the bytes in substring
@@ -387,7 +918,7 @@ static int StringFindFirstOf(const string &sub, asUINT start, const string &str)
 static int StringFindLastOf(const string &sub, asUINT start, const string &str)
 {
 	// We don't register the method directly because the argument types change between 32bit and 64bit platforms
-	return (int)str.find_last_of(sub, (size_t)(start < 0 ? string::npos : start));
+	return (int)StringSearchFindLastOf(str.data(), str.length(), sub.data(), sub.length(), (size_t)(start < 0 ? string::npos : start));
 }
 
 // This function returns the index of the first position where a byte other than those in substring
@@ -398,7 +929,7 @@ static int StringFindLastOf(const string &sub, asUINT start, const string &str)
 static int StringFindFirstNotOf(const string &sub, asUINT start, const string &str)
 {
 	// We don't register the method directly because the argument types change between 32bit and 64bit platforms
-	return (int)str.find_first_not_of(sub, (size_t)(start < 0 ? string::npos : start));
+	return (int)StringSearchFindFirstNotOf(str.data(), str.length(), sub.data(), sub.length(), (size_t)(start < 0 ? string::npos : start));
 }
 
 // This function returns the index of the last position where a byte other than those in substring
@@ -409,7 +940,7 @@ static int StringFindFirstNotOf(const string &sub, asUINT start, const string &s
 static int StringFindLastNotOf(const string &sub, asUINT start, const string &str)
 {
 	// We don't register the method directly because the argument types change between 32bit and 64bit platforms
-	return (int)str.find_last_not_of(sub, (size_t)(start < 0 ? string::npos : start));
+	return (int)StringSearchFindLastNotOf(str.data(), str.length(), sub.data(), sub.length(), (size_t)(start < 0 ? string::npos : start));
 }
 
 // This function returns the index of the last position where the substring
@@ -421,7 +952,7 @@ static int StringFindLastNotOf(const string &sub, asUINT start, const string &st
 static int StringFindLast(const string &sub, int start, const string &str)
 {
 	// We don't register the method directly because the argument types change between 32bit and 64bit platforms
-	return (int)str.rfind(sub, (size_t)(start < 0 ? string::npos : start));
+	return (int)StringSearchFindLast(str.data(), str.length(), sub.data(), sub.length(), (size_t)(start < 0 ? string::npos : start));
 }
 
 // AngelScript signature:
@@ -458,133 +989,256 @@ static void StringResize(asUINT l, string &str)
 	str.resize(l);
 }
 
+// The flags of the `options` argument of formatInt(), formatUInt() and formatFloat().
+// The output is the same as when the flags were translated into a printf format string.
+enum EFormatFlags
+{
+	FORMAT_LEFT_JUSTIFY  = 0x01, // 'l', printf's '-'
+	FORMAT_PAD_WITH_ZERO = 0x02, // '0'
+	FORMAT_ALWAYS_SIGN   = 0x04, // '+'
+	FORMAT_SPACE_ON_SIGN = 0x08, // ' '
+	FORMAT_HEX_SMALL     = 0x10, // 'h'
+	FORMAT_HEX_LARGE     = 0x20, // 'H'
+	FORMAT_EXP_SMALL     = 0x40, // 'e'
+	FORMAT_EXP_LARGE     = 0x80  // 'E'
+};
+
+// The options are short, so a single pass over them is cheaper than caching the result
+static asUINT ParseFormatOptions(const string &options)
+{
+	asUINT flags = 0;
+	for( size_t n = 0; n < options.length(); n++ )
+	{
+		switch( options[n] )
+		{
+		case 'l': flags |= FORMAT_LEFT_JUSTIFY;  break;
+		case '0': flags |= FORMAT_PAD_WITH_ZERO; break;
+		case '+': flags |= FORMAT_ALWAYS_SIGN;   break;
+		case ' ': flags |= FORMAT_SPACE_ON_SIGN; break;
+		case 'h': flags |= FORMAT_HEX_SMALL;     break;
+		case 'H': flags |= FORMAT_HEX_LARGE;     break;
+		case 'e': flags |= FORMAT_EXP_SMALL;     break;
+		case 'E': flags |= FORMAT_EXP_LARGE;     break;
+		}
+	}
+	return flags;
+}
+
+static void FormatToUpper(char *first, char *last)
+{
+	for( ; first != last; first++ )
+	{
+		if( *first >= 'a' && *first <= 'z' )
+			*first -= 'a' - 'A';
+	}
+}
+
+// Applies sign, width and justification to the formatted digits `[first, last)`.
+// The digits may start with a '-', which is moved in front of any zero padding.
+static string FormatPadded(const char *first, const char *last, asUINT flags, asUINT width, bool allowSign, bool allowZeroPad)
+{
+	// printf receives the width as an int, where negative means left justified
+	if( int(width) < 0 )
+	{
+		flags |= FORMAT_LEFT_JUSTIFY;
+		width = 0u - width;
+	}
+
+	char sign = 0;
+	if( first != last && *first == '-' )
+		sign = *first++;
+	else if( allowSign && (flags & FORMAT_ALWAYS_SIGN) )
+		sign = '+';
+	else if( allowSign && (flags & FORMAT_SPACE_ON_SIGN) )
+		sign = ' ';
+
+	size_t length = size_t(last - first) + (sign ? 1 : 0);
+	size_t padding = width > length ? width - length : 0;
+
+	string buf;
+	buf.reserve(length + padding);
+	if( flags & FORMAT_LEFT_JUSTIFY )
+	{
+		if( sign ) buf += sign;
+		buf.append(first, last);
+		buf.append(padding, ' ');
+	}
+	else if( (flags & FORMAT_PAD_WITH_ZERO) && allowZeroPad )
+	{
+		if( sign ) buf += sign;
+		buf.append(padding, '0');
+		buf.append(first, last);
+	}
+	else
+	{
+		buf.append(padding, ' ');
+		if( sign ) buf += sign;
+		buf.append(first, last);
+	}
+	return buf;
+}
+
 // AngelScript signature:
 // string formatInt(int64 val, const string &in options, uint width)
 static string formatInt(asINT64 value, const string &options, asUINT width)
 {
-	bool leftJustify = options.find("l") != string::npos;
-	bool padWithZero = options.find("0") != string::npos;
-	bool alwaysSign  = options.find("+") != string::npos;
-	bool spaceOnSign = options.find(" ") != string::npos;
-	bool hexSmall    = options.find("h") != string::npos;
-	bool hexLarge    = options.find("H") != string::npos;
-
-	string fmt = "%";
-	if( leftJustify ) fmt += "-";
-	if( alwaysSign ) fmt += "+";
-	if( spaceOnSign ) fmt += " ";
-	if( padWithZero ) fmt += "0";
-
-#ifdef _WIN32
-	fmt += "*I64";
-#else
-#ifdef _LP64
-	fmt += "*l";
-#else
-	fmt += "*ll";
-#endif
-#endif
-
-	if( hexSmall ) fmt += "x";
-	else if( hexLarge ) fmt += "X";
-	else fmt += "d";
+	asUINT flags = ParseFormatOptions(options);
 
-	string buf;
-	buf.resize(width+30);
-#if _MSC_VER >= 1400 && !defined(__S3E__)
-	// MSVC 8.0 / 2005 or newer
-	sprintf_s(&buf[0], buf.size(), fmt.c_str(), width, value);
-#else
-	sprintf(&buf[0], fmt.c_str(), width, value);
-#endif
-	buf.resize(strlen(&buf[0]));
+	char buf[STRING_NUMBER_BUFFER_SIZE];
+	char *end;
+	if( flags & (FORMAT_HEX_SMALL | FORMAT_HEX_LARGE) )
+	{
+		// Negative values are shown in two's complement, and hex is never signed
+		end = to_chars(buf, buf + STRING_NUMBER_BUFFER_SIZE, asQWORD(value), 16).ptr;
+		if( !(flags & FORMAT_HEX_SMALL) )
+			FormatToUpper(buf, end);
+		return FormatPadded(buf, end, flags, width, false, true);
+	}
 
-	return buf;
+	end = to_chars(buf, buf + STRING_NUMBER_BUFFER_SIZE, value).ptr;
+	return FormatPadded(buf, end, flags, width, true, true);
 }
 
 // AngelScript signature:
 // string formatUInt(uint64 val, const string &in options, uint width)
 static string formatUInt(asQWORD value, const string &options, asUINT width)
 {
-	bool leftJustify = options.find("l") != string::npos;
-	bool padWithZero = options.find("0") != string::npos;
-	bool alwaysSign  = options.find("+") != string::npos;
-	bool spaceOnSign = options.find(" ") != string::npos;
-	bool hexSmall    = options.find("h") != string::npos;
-	bool hexLarge    = options.find("H") != string::npos;
-
-	string fmt = "%";
-	if( leftJustify ) fmt += "-";
-	if( alwaysSign ) fmt += "+";
-	if( spaceOnSign ) fmt += " ";
-	if( padWithZero ) fmt += "0";
-
-#ifdef _WIN32
-	fmt += "*I64";
-#else
-#ifdef _LP64
-	fmt += "*l";
-#else
-	fmt += "*ll";
-#endif
-#endif
-
-	if( hexSmall ) fmt += "x";
-	else if( hexLarge ) fmt += "X";
-	else fmt += "u";
+	asUINT flags = ParseFormatOptions(options);
 
-	string buf;
-	buf.resize(width+30);
-#if _MSC_VER >= 1400 && !defined(__S3E__)
-	// MSVC 8.0 / 2005 or newer
-	sprintf_s(&buf[0], buf.size(), fmt.c_str(), width, value);
-#else
-	sprintf(&buf[0], fmt.c_str(), width, value);
-#endif
-	buf.resize(strlen(&buf[0]));
+	char buf[STRING_NUMBER_BUFFER_SIZE];
+	char *end;
+	if( flags & (FORMAT_HEX_SMALL | FORMAT_HEX_LARGE) )
+	{
+		end = to_chars(buf, buf + STRING_NUMBER_BUFFER_SIZE, value, 16).ptr;
+		if( !(flags & FORMAT_HEX_SMALL) )
+			FormatToUpper(buf, end);
+	}
+	else
+		end = to_chars(buf, buf + STRING_NUMBER_BUFFER_SIZE, value).ptr;
 
-	return buf;
+	// '+' and ' ' only apply to signed conversions
+	return FormatPadded(buf, end, flags, width, false, true);
 }
 
 // AngelScript signature:
 // string formatFloat(double val, const string &in options, uint width, uint precision)
 static string formatFloat(double value, const string &options, asUINT width, asUINT precision)
 {
-	bool leftJustify = options.find("l") != string::npos;
-	bool padWithZero = options.find("0") != string::npos;
-	bool alwaysSign  = options.find("+") != string::npos;
-	bool spaceOnSign = options.find(" ") != string::npos;
-	bool expSmall    = options.find("e") != string::npos;
-	bool expLarge    = options.find("E") != string::npos;
-
-	string fmt = "%";
-	if( leftJustify ) fmt += "-";
-	if( alwaysSign ) fmt += "+";
-	if( spaceOnSign ) fmt += " ";
-	if( padWithZero ) fmt += "0";
+	asUINT flags = ParseFormatOptions(options);
 
-	fmt += "*.*";
+	// printf receives the precision as an int, where negative means the default
+	if( int(precision) < 0 )
+		precision = 6;
 
-	if( expSmall ) fmt += "e";
-	else if( expLarge ) fmt += "E";
-	else fmt += "f";
+	// Sign, up to 309 integer digits, point, decimals and exponent
+	const size_t STACK_BUFFER_SIZE = 512;
+	size_t size = size_t(precision) + 320;
+	char stackBuf[STACK_BUFFER_SIZE];
+	vector<char> heapBuf;
+	char *buf = stackBuf;
+	if( size > STACK_BUFFER_SIZE )
+	{
+		heapBuf.resize(size);
+		buf = &heapBuf[0];
+	}
 
-	string buf;
-	buf.resize(width+precision+50);
-#if _MSC_VER >= 1400 && !defined(__S3E__)
-	// MSVC 8.0 / 2005 or newer
-	sprintf_s(&buf[0], buf.size(), fmt.c_str(), width, precision, value);
+	bool exponent = (flags & (FORMAT_EXP_SMALL | FORMAT_EXP_LARGE)) != 0;
+	char *end;
+#ifdef __cpp_lib_to_chars
+	end = to_chars(buf, buf + size, value, exponent ? chars_format::scientific : chars_format::fixed, int(precision)).ptr;
 #else
-	sprintf(&buf[0], fmt.c_str(), width, precision, value);
+	end = buf + snprintf(buf, size, exponent ? "%.*e" : "%.*f", int(precision), value);
 #endif
-	buf.resize(strlen(&buf[0]));
+	if( exponent && !(flags & FORMAT_EXP_SMALL) )
+		FormatToUpper(buf, end); // Includes "INF" and "NAN", as printf does
 
-	return buf;
+	// Infinity and NaN are padded with spaces even with the '0' flag
+	return FormatPadded(buf, end, flags, width, true, isfinite(value) != 0);
 }
 
-// AngelScript signature:
-// int64 parseInt(const string &in val, uint base = 10, uint &out byteCount = 0)
-static asINT64 parseInt(const string &val, asUINT base, asUINT *byteCount)
+// Number parsing for parseInt(), parseUInt() and parseFloat(), and for other
+// string types through StringParseInt() etc. None of it allocates or depends
+// on the locale, so it is safe to call from any thread.
+//
+// On overflow the integers wrap around, as the original digit loops did, and
+// the byte count always covers the whole run of digits.
+
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define AS_PARSE_EIGHT_DIGITS 1
+#endif
+
+#ifdef AS_PARSE_EIGHT_DIGITS
+// Long runs of decimal digits are converted 8 at a time, with the 8 characters
+// loaded into one 64 bit integer and combined by multiplication (as in fast_float).
+static bool IsEightDigits(asQWORD chunk)
+{
+	return ((chunk & 0xF0F0F0F0F0F0F0F0ull) | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+static asQWORD EightDigitsValue(asQWORD chunk)
+{
+	chunk -= 0x3030303030303030ull;
+	chunk = chunk * 10 + (chunk >> 8);
+	return (((chunk & 0x000000FF000000FFull) * 0x000F424000000064ull) + (((chunk >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull)) >> 32;
+}
+#endif
+
+static int DigitValue(char c)
+{
+	if( c >= '0' && c <= '9' ) return c - '0';
+	if( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+	if( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+	return 99;
+}
+
+// Parses the run of digits at `first`, with wrap around on overflow.
+// Returns the end of the run; `first` if there are no digits.
+static const char *ParseDigits(const char *first, const char *last, asUINT base, asQWORD &value)
+{
+	value = 0;
+	const char *p = first;
+
+#ifdef AS_PARSE_EIGHT_DIGITS
+	if( base == 10 && last - p >= 8 )
+	{
+		asQWORD chunk;
+		memcpy(&chunk, p, 8);
+		if( IsEightDigits(chunk) )
+		{
+			// Unsigned arithmetic wraps the same as adding one digit at a time
+			do
+			{
+				value = value * 100000000 + EightDigitsValue(chunk);
+				p += 8;
+				if( last - p < 8 )
+					break;
+				memcpy(&chunk, p, 8);
+			} while( IsEightDigits(chunk) );
+
+			for( ; p != last && *p >= '0' && *p <= '9'; p++ )
+				value = value * 10 + asQWORD(*p - '0');
+			return p;
+		}
+	}
+#endif
+
+	// Short runs, and hexadecimal. from_chars would have to be redone here on
+	// overflow anyway, and its range checks make it slower for short numbers.
+	// The text isn't necessarily null terminated, e.g. for a string_slice.
+	if( base == 10 )
+	{
+		for( ; p != last && *p >= '0' && *p <= '9'; p++ )
+			value = value * 10 + asQWORD(*p - '0');
+	}
+	else
+	{
+		for( int digit; p != last && (digit = DigitValue(*p)) < int(base); p++ )
+			value = value * base + asQWORD(digit);
+	}
+	return p;
+}
+
+asINT64 StringParseInt(const char *str, size_t length, asUINT base, asUINT *byteCount)
 {
 	// Only accept base 10 and 16
 	if( base != 10 && base != 16 )
@@ -593,55 +1247,41 @@ static asINT64 parseInt(const string &val, asUINT base, asUINT *byteCount)
 		return 0;
 	}
 
-	const char *end = &val[0];
+	const char *first = str;
+	const char *last = first + length;
+	const char *end = first;
 
 	// Determine the sign
 	bool sign = false;
-	if( *end == '-' )
+	if( end != last && *end == '-' )
 	{
 		sign = true;
 		end++;
 	}
-	else if( *end == '+' )
+	else if( end != last && *end == '+' )
 		end++;
 
-	asINT64 res = 0;
-	if( base == 10 )
-	{
-		while( *end >= '0' && *end <= '9' )
-		{
-			res *= 10;
-			res += *end++ - '0';
-		}
-	}
-	else if( base == 16 )
-	{
-		while( (*end >= '0' && *end <= '9') ||
-		       (*end >= 'a' && *end <= 'f') ||
-		       (*end >= 'A' && *end <= 'F') )
-		{
-			res *= 16;
-			if( *end >= '0' && *end <= '9' )
-				res += *end++ - '0';
-			else if( *end >= 'a' && *end <= 'f' )
-				res += *end++ - 'a' + 10;
-			else if( *end >= 'A' && *end <= 'F' )
-				res += *end++ - 'A' + 10;
-		}
-	}
+	// The sign is included in the byte count even if no digits follow
+	asQWORD res;
+	end = ParseDigits(end, last, base, res);
 
 	if( byteCount )
-		*byteCount = asUINT(size_t(end - val.c_str()));
+		*byteCount = asUINT(size_t(end - first));
 
 	if( sign )
-		res = -res;
+		res = 0 - res;
 
-	return res;
+	return asINT64(res);
 }
 
 // AngelScript signature:
-// uint64 parseUInt(const string &in val, uint base = 10, uint &out byteCount = 0)
-static asQWORD parseUInt(const string &val, asUINT base, asUINT *byteCount)
+// int64 parseInt(const string &in val, uint base = 10, uint &out byteCount = 0)
+static asINT64 parseInt(const string &val, asUINT base, asUINT *byteCount)
+{
+	return StringParseInt(val.data(), val.length(), base, byteCount);
+}
+
+asQWORD StringParseUInt(const char *str, size_t length, asUINT base, asUINT *byteCount)
 {
 	// Only accept base 10 and 16
 	if (base != 10 && base != 16)
@@ -650,43 +1290,79 @@ static asQWORD parseUInt(const string &val, asUINT base, asUINT *byteCount)
 		return 0;
 	}
 
-	const char *end = &val[0];
-
-	asQWORD res = 0;
-	if (base == 10)
-	{
-		while (*end >= '0' && *end <= '9')
-		{
-			res *= 10;
-			res += *end++ - '0';
-		}
-	}
-	else if (base == 16)
-	{
-		while ((*end >= '0' && *end <= '9') ||
-			(*end >= 'a' && *end <= 'f') ||
-			(*end >= 'A' && *end <= 'F'))
-		{
-			res *= 16;
-			if (*end >= '0' && *end <= '9')
-				res += *end++ - '0';
-			else if (*end >= 'a' && *end <= 'f')
-				res += *end++ - 'a' + 10;
-			else if (*end >= 'A' && *end <= 'F')
-				res += *end++ - 'A' + 10;
-		}
-	}
+	asQWORD res;
+	const char *end = ParseDigits(str, str + length, base, res);
 
 	if (byteCount)
-		*byteCount = asUINT(size_t(end - val.c_str()));
+		*byteCount = asUINT(size_t(end - str));
 
 	return res;
 }
 
 // AngelScript signature:
-// double parseFloat(const string &in val, uint &out byteCount = 0)
-double parseFloat(const string &val, asUINT *byteCount)
+// uint64 parseUInt(const string &in val, uint base = 10, uint &out byteCount = 0)
+static asQWORD parseUInt(const string &val, asUINT base, asUINT *byteCount)
+{
+	return StringParseUInt(val.data(), val.length(), base, byteCount);
+}
+
+#ifdef __cpp_lib_to_chars
+// Values beyond the range of double, which from_chars rejects but strtod returns
+// as HUGE_VAL, 0 or a denormal. The text was already validated by from_chars,
+// only the decimal point has to be adapted to the C locale for strtod.
+static double ParseFloatOutOfRange(const char *first, const char *last)
+{
+	string text(first, last);
+#ifndef __psp2__
+	const char *point = localeconv()->decimal_point;
+	if( point && point[0] && point[0] != '.' )
+	{
+		size_t pos = text.find('.');
+		if( pos != string::npos )
+			text.replace(pos, 1, point);
+	}
+#endif
+	return strtod(text.c_str(), 0);
+}
+#endif
+
+double StringParseFloat(const char *str, size_t length, asUINT *byteCount)
 {
+#ifdef __cpp_lib_to_chars
+	// Accepts the same input as strtod in the C locale
+	const char *first = str;
+	const char *last = first + length;
+	const char *p = first;
+
+	while( p != last && (*p == ' ' || (*p >= '\t' && *p <= '\r')) )
+		p++;
+
+	bool sign = false;
+	if( p != last && (*p == '-' || *p == '+') )
+		sign = *p++ == '-';
+
+	double res = 0;
+	const char *end = first;
+	if( p != last && *p != '-' && *p != '+' )
+	{
+		// strtod also takes hexadecimal floats, from_chars wants them without the prefix
+		from_chars_result r = { p, errc::invalid_argument };
+		if( last - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && (DigitValue(p[2]) < 16 || p[2] == '.') )
+			r = from_chars(p + 2, last, res, chars_format::hex);
+		if( r.ec == errc::invalid_argument )
+			r = from_chars(p, last, res, chars_format::general);
+
+		if( r.ec == errc::result_out_of_range )
+			res = ParseFloatOutOfRange(p, r.ptr);
+
+		if( r.ec != errc::invalid_argument )
+		{
+			end = r.ptr;
+			if( sign )
+				res = -res;
+		}
+	}
+#else
 	char *end;
 
 	// WinCE doesn't have setlocale. Some quick testing on my current platform
@@ -699,19 +1375,30 @@ double parseFloat(const string &val, asUINT *byteCount)
 	setlocale(LC_NUMERIC, "C");
 #endif
 
-	double res = strtod(val.c_str(), &end);
+	// strtod needs a null terminated copy
+	string text(str, length);
+	const char *first = text.c_str();
+	double res = strtod(first, &end);
 
 #if !defined(_WIN32_WCE) && !defined(ANDROID) && !defined(__psp2__)
 	// Restore the locale
 	setlocale(LC_NUMERIC, orig.c_str());
+#endif
 #endif
 
 	if( byteCount )
-		*byteCount = asUINT(size_t(end - val.c_str()));
+		*byteCount = asUINT(size_t(end - first));
 
 	return res;
 }
 
+// AngelScript signature:
+// double parseFloat(const string &in val, uint &out byteCount = 0)
+static double parseFloat(const string &val, asUINT *byteCount)
+{
+	return StringParseFloat(val.data(), val.length(), byteCount);
+}
+
 // This function returns a string containing the substring of the input string
 // determined by the starting index and count of characters.
 //
@@ -765,7 +1452,7 @@ void RegisterStdString_Native(asIScriptEngine *engine)
 	// Need to use a wrapper for operator== otherwise gcc 4.7 fails to compile
 	r = engine->RegisterObjectMethod("string", "bool opEquals(const string &in) const", asFUNCTIONPR(StringEquals, (const string &, const string &), bool), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
 	r = engine->RegisterObjectMethod("string", "int opCmp(const string &in) const", asFUNCTION(StringCmp), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
-	r = engine->RegisterObjectMethod("string", "string opAdd(const string &in) const", asFUNCTIONPR(operator +, (const string &, const string &), string), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string", "string opAdd(const string &in) const", asFUNCTION(AddStrings), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
 
 	// The string length can be accessed through methods or through virtual property
 	// TODO: Register as size() for consistency with other types
@@ -863,6 +1550,7 @@ static void CopyConstructStringGeneric(asIScriptGeneric * gen)
 static void DestructStringGeneric(asIScriptGeneric * gen)
 {
 	string * ptr = static_cast<string *>(gen->GetObject());
+	RecycleStringBuffer(*ptr);
 	ptr->~string();
 }
 
@@ -905,8 +1593,7 @@ static void StringAddGeneric(asIScriptGeneric * gen)
 {
 	string * a = static_cast<string *>(gen->GetObject());
 	string * b = static_cast<string *>(gen->GetArgAddress(0));
-	string ret_val = *a + *b;
-	gen->SetReturnObject(&ret_val);
+	new(gen->GetAddressOfReturnLocation()) string(AddStrings(*a, *b));
 }
 
 static void StringLengthGeneric(asIScriptGeneric * gen)
@@ -1062,200 +1749,140 @@ static void AssignInt2StringGeneric(asIScriptGeneric *gen)
 {
 	asINT64 *a = static_cast<asINT64*>(gen->GetAddressOfArg(0));
 	string *self = static_cast<string*>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << *a;
-	*self = sstr.str();
-	gen->SetReturnAddress(self);
+	gen->SetReturnAddress(&AssignNumberToString(*a, *self));
 }
 
 static void AssignUInt2StringGeneric(asIScriptGeneric *gen)
 {
 	asQWORD *a = static_cast<asQWORD*>(gen->GetAddressOfArg(0));
 	string *self = static_cast<string*>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << *a;
-	*self = sstr.str();
-	gen->SetReturnAddress(self);
+	gen->SetReturnAddress(&AssignNumberToString(*a, *self));
 }
 
 static void AssignDouble2StringGeneric(asIScriptGeneric *gen)
 {
 	double *a = static_cast<double*>(gen->GetAddressOfArg(0));
 	string *self = static_cast<string*>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << *a;
-	*self = sstr.str();
-	gen->SetReturnAddress(self);
+	gen->SetReturnAddress(&AssignNumberToString(*a, *self));
 }
 
 static void AssignFloat2StringGeneric(asIScriptGeneric *gen)
 {
 	float *a = static_cast<float*>(gen->GetAddressOfArg(0));
 	string *self = static_cast<string*>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << *a;
-	*self = sstr.str();
-	gen->SetReturnAddress(self);
+	gen->SetReturnAddress(&AssignNumberToString(*a, *self));
 }
 
 static void AssignBool2StringGeneric(asIScriptGeneric *gen)
 {
 	bool *a = static_cast<bool*>(gen->GetAddressOfArg(0));
 	string *self = static_cast<string*>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << (*a ? "true" : "false");
-	*self = sstr.str();
-	gen->SetReturnAddress(self);
+	gen->SetReturnAddress(&AssignNumberToString(*a, *self));
 }
 
-static void AddAssignDouble2StringGeneric(asIScriptGeneric * gen)
+static void AddAssignDouble2StringGeneric(asIScriptGeneric *gen)
 {
-	double * a = static_cast<double *>(gen->GetAddressOfArg(0));
-	string * self = static_cast<string *>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << *a;
-	*self += sstr.str();
-	gen->SetReturnAddress(self);
+	double *a = static_cast<double*>(gen->GetAddressOfArg(0));
+	string *self = static_cast<string*>(gen->GetObject());
+	gen->SetReturnAddress(&AddAssignNumberToString(*a, *self));
 }
 
-static void AddAssignFloat2StringGeneric(asIScriptGeneric * gen)
+static void AddAssignFloat2StringGeneric(asIScriptGeneric *gen)
 {
-	float * a = static_cast<float *>(gen->GetAddressOfArg(0));
-	string * self = static_cast<string *>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << *a;
-	*self += sstr.str();
-	gen->SetReturnAddress(self);
+	float *a = static_cast<float*>(gen->GetAddressOfArg(0));
+	string *self = static_cast<string*>(gen->GetObject());
+	gen->SetReturnAddress(&AddAssignNumberToString(*a, *self));
 }
 
-static void AddAssignInt2StringGeneric(asIScriptGeneric * gen)
+static void AddAssignInt2StringGeneric(asIScriptGeneric *gen)
 {
-	asINT64 * a = static_cast<asINT64 *>(gen->GetAddressOfArg(0));
-	string * self = static_cast<string *>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << *a;
-	*self += sstr.str();
-	gen->SetReturnAddress(self);
+	asINT64 *a = static_cast<asINT64*>(gen->GetAddressOfArg(0));
+	string *self = static_cast<string*>(gen->GetObject());
+	gen->SetReturnAddress(&AddAssignNumberToString(*a, *self));
 }
 
-static void AddAssignUInt2StringGeneric(asIScriptGeneric * gen)
+static void AddAssignUInt2StringGeneric(asIScriptGeneric *gen)
 {
-	asQWORD * a = static_cast<asQWORD *>(gen->GetAddressOfArg(0));
-	string * self = static_cast<string *>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << *a;
-	*self += sstr.str();
-	gen->SetReturnAddress(self);
+	asQWORD *a = static_cast<asQWORD*>(gen->GetAddressOfArg(0));
+	string *self = static_cast<string*>(gen->GetObject());
+	gen->SetReturnAddress(&AddAssignNumberToString(*a, *self));
 }
 
-static void AddAssignBool2StringGeneric(asIScriptGeneric * gen)
+static void AddAssignBool2StringGeneric(asIScriptGeneric *gen)
 {
-	bool * a = static_cast<bool *>(gen->GetAddressOfArg(0));
-	string * self = static_cast<string *>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << (*a ? "true" : "false");
-	*self += sstr.str();
-	gen->SetReturnAddress(self);
+	bool *a = static_cast<bool*>(gen->GetAddressOfArg(0));
+	string *self = static_cast<string*>(gen->GetObject());
+	gen->SetReturnAddress(&AddAssignNumberToString(*a, *self));
 }
 
-static void AddString2DoubleGeneric(asIScriptGeneric * gen)
+static void AddString2DoubleGeneric(asIScriptGeneric *gen)
 {
-	string * a = static_cast<string *>(gen->GetObject());
-	double * b = static_cast<double *>(gen->GetAddressOfArg(0));
-	std::stringstream sstr;
-	sstr << *a << *b;
-	std::string ret_val = sstr.str();
-	gen->SetReturnObject(&ret_val);
+	string *a = static_cast<string*>(gen->GetObject());
+	double *b = static_cast<double*>(gen->GetAddressOfArg(0));
+	new(gen->GetAddressOfReturnLocation()) string(AddStringNumber(*a, *b));
 }
 
-static void AddString2FloatGeneric(asIScriptGeneric * gen)
+static void AddString2FloatGeneric(asIScriptGeneric *gen)
 {
-	string * a = static_cast<string *>(gen->GetObject());
-	float * b = static_cast<float *>(gen->GetAddressOfArg(0));
-	std::stringstream sstr;
-	sstr << *a << *b;
-	std::string ret_val = sstr.str();
-	gen->SetReturnObject(&ret_val);
+	string *a = static_cast<string*>(gen->GetObject());
+	float *b = static_cast<float*>(gen->GetAddressOfArg(0));
+	new(gen->GetAddressOfReturnLocation()) string(AddStringNumber(*a, *b));
 }
 
-static void AddString2IntGeneric(asIScriptGeneric * gen)
+static void AddString2IntGeneric(asIScriptGeneric *gen)
 {
-	string * a = static_cast<string *>(gen->GetObject());
-	asINT64 * b = static_cast<asINT64 *>(gen->GetAddressOfArg(0));
-	std::stringstream sstr;
-	sstr << *a << *b;
-	std::string ret_val = sstr.str();
-	gen->SetReturnObject(&ret_val);
+	string *a = static_cast<string*>(gen->GetObject());
+	asINT64 *b = static_cast<asINT64*>(gen->GetAddressOfArg(0));
+	new(gen->GetAddressOfReturnLocation()) string(AddStringNumber(*a, *b));
 }
 
-static void AddString2UIntGeneric(asIScriptGeneric * gen)
+static void AddString2UIntGeneric(asIScriptGeneric *gen)
 {
-	string * a = static_cast<string *>(gen->GetObject());
-	asQWORD * b = static_cast<asQWORD *>(gen->GetAddressOfArg(0));
-	std::stringstream sstr;
-	sstr << *a << *b;
-	std::string ret_val = sstr.str();
-	gen->SetReturnObject(&ret_val);
+	string *a = static_cast<string*>(gen->GetObject());
+	asQWORD *b = static_cast<asQWORD*>(gen->GetAddressOfArg(0));
+	new(gen->GetAddressOfReturnLocation()) string(AddStringNumber(*a, *b));
 }
 
-static void AddString2BoolGeneric(asIScriptGeneric * gen)
+static void AddString2BoolGeneric(asIScriptGeneric *gen)
 {
-	string * a = static_cast<string *>(gen->GetObject());
-	bool * b = static_cast<bool *>(gen->GetAddressOfArg(0));
-	std::stringstream sstr;
-	sstr << *a << (*b ? "true" : "false");
-	std::string ret_val = sstr.str();
-	gen->SetReturnObject(&ret_val);
+	string *a = static_cast<string*>(gen->GetObject());
+	bool *b = static_cast<bool*>(gen->GetAddressOfArg(0));
+	new(gen->GetAddressOfReturnLocation()) string(AddStringNumber(*a, *b));
 }
 
-static void AddDouble2StringGeneric(asIScriptGeneric * gen)
+static void AddDouble2StringGeneric(asIScriptGeneric *gen)
 {
-	double* a = static_cast<double *>(gen->GetAddressOfArg(0));
-	string * b = static_cast<string *>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << *a << *b;
-	std::string ret_val = sstr.str();
-	gen->SetReturnObject(&ret_val);
+	double *a = static_cast<double*>(gen->GetAddressOfArg(0));
+	string *b = static_cast<string*>(gen->GetObject());
+	new(gen->GetAddressOfReturnLocation()) string(AddNumberString(*a, *b));
 }
 
-static void AddFloat2StringGeneric(asIScriptGeneric * gen)
+static void AddFloat2StringGeneric(asIScriptGeneric *gen)
 {
-	float* a = static_cast<float *>(gen->GetAddressOfArg(0));
-	string * b = static_cast<string *>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << *a << *b;
-	std::string ret_val = sstr.str();
-	gen->SetReturnObject(&ret_val);
+	float *a = static_cast<float*>(gen->GetAddressOfArg(0));
+	string *b = static_cast<string*>(gen->GetObject());
+	new(gen->GetAddressOfReturnLocation()) string(AddNumberString(*a, *b));
 }
 
-static void AddInt2StringGeneric(asIScriptGeneric * gen)
+static void AddInt2StringGeneric(asIScriptGeneric *gen)
 {
-	asINT64* a = static_cast<asINT64 *>(gen->GetAddressOfArg(0));
-	string * b = static_cast<string *>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << *a << *b;
-	std::string ret_val = sstr.str();
-	gen->SetReturnObject(&ret_val);
+	asINT64 *a = static_cast<asINT64*>(gen->GetAddressOfArg(0));
+	string *b = static_cast<string*>(gen->GetObject());
+	new(gen->GetAddressOfReturnLocation()) string(AddNumberString(*a, *b));
 }
 
-static void AddUInt2StringGeneric(asIScriptGeneric * gen)
+static void AddUInt2StringGeneric(asIScriptGeneric *gen)
 {
-	asQWORD* a = static_cast<asQWORD *>(gen->GetAddressOfArg(0));
-	string * b = static_cast<string *>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << *a << *b;
-	std::string ret_val = sstr.str();
-	gen->SetReturnObject(&ret_val);
+	asQWORD *a = static_cast<asQWORD*>(gen->GetAddressOfArg(0));
+	string *b = static_cast<string*>(gen->GetObject());
+	new(gen->GetAddressOfReturnLocation()) string(AddNumberString(*a, *b));
 }
 
-static void AddBool2StringGeneric(asIScriptGeneric * gen)
+static void AddBool2StringGeneric(asIScriptGeneric *gen)
 {
-	bool* a = static_cast<bool *>(gen->GetAddressOfArg(0));
-	string * b = static_cast<string *>(gen->GetObject());
-	std::stringstream sstr;
-	sstr << (*a ? "true" : "false") << *b;
-	std::string ret_val = sstr.str();
-	gen->SetReturnObject(&ret_val);
+	bool *a = static_cast<bool*>(gen->GetAddressOfArg(0));
+	string *b = static_cast<string*>(gen->GetObject());
+	new(gen->GetAddressOfReturnLocation()) string(AddNumberString(*a, *b));
 }
 
 static void StringSubString_Generic(asIScriptGeneric *gen)
@@ -1358,6 +1985,36 @@ void RegisterStdString(asIScriptEngine * engine)
 		RegisterStdString_Native(engine);
 }
 
+static void GetStdStringCacheStats_Generic(asIScriptGeneric *gen)
+{
+	SStdStringCacheStats stats = GetStdStringCacheStats();
+	gen->SetReturnObject(&stats);
+}
+
+void RegisterStdStringCacheStats(asIScriptEngine *engine)
+{
+	int r = 0;
+	UNUSED_VAR(r);
+
+	r = engine->RegisterObjectType("string_cache_stats", sizeof(SStdStringCacheStats), asOBJ_VALUE | asOBJ_POD | asOBJ_APP_CLASS_ALLINTS | asGetTypeTraits<SStdStringCacheStats>()); assert( r >= 0 );
+	r = engine->RegisterObjectProperty("string_cache_stats", "uint64 entries", asOFFSET(SStdStringCacheStats, entries)); assert( r >= 0 );
+	r = engine->RegisterObjectProperty("string_cache_stats", "uint64 stringBytes", asOFFSET(SStdStringCacheStats, stringBytes)); assert( r >= 0 );
+	r = engine->RegisterObjectProperty("string_cache_stats", "uint64 memoryUsage", asOFFSET(SStdStringCacheStats, memoryUsage)); assert( r >= 0 );
+	r = engine->RegisterObjectProperty("string_cache_stats", "uint64 hits", asOFFSET(SStdStringCacheStats, hits)); assert( r >= 0 );
+	r = engine->RegisterObjectProperty("string_cache_stats", "uint64 misses", asOFFSET(SStdStringCacheStats, misses)); assert( r >= 0 );
+	r = engine->RegisterObjectProperty("string_cache_stats", "uint64 contendedLocks", asOFFSET(SStdStringCacheStats, contendedLocks)); assert( r >= 0 );
+	r = engine->RegisterObjectProperty("string_cache_stats", "uint64 lockWaitNs", asOFFSET(SStdStringCacheStats, lockWaitNs)); assert( r >= 0 );
+
+	if (strstr(asGetLibraryOptions(), "AS_MAX_PORTABILITY"))
+	{
+		r = engine->RegisterGlobalFunction("string_cache_stats getStringCacheStats()", asFUNCTION(GetStdStringCacheStats_Generic), asCALL_GENERIC); assert( r >= 0 );
+	}
+	else
+	{
+		r = engine->RegisterGlobalFunction("string_cache_stats getStringCacheStats()", asFUNCTION(GetStdStringCacheStats), asCALL_CDECL); assert( r >= 0 );
+	}
+}
+
 END_AS_NAMESPACE
 
 
@@ -16,7 +16,9 @@
 #include <angelscript.h>
 #endif
 
+#include <stdint.h> // uintptr_t
 #include <string>
+#include <vector>
 
 //---------------------------
 // Compilation settings
@@ -43,6 +45,136 @@ BEGIN_AS_NAMESPACE
 void RegisterStdString(asIScriptEngine *engine);
 void RegisterStdStringUtils(asIScriptEngine *engine);
 
+// The string factory registered by RegisterStdString(). Other string types can
+// build their constants on it to share the cache of string constants.
+asIStringFactory *GetStdStringFactory();
+
+// Statistics of the string constant cache behind GetStdStringFactory(), shared
+// by all engines. The counters accumulate until ResetStdStringCacheCounters().
+struct SStdStringCacheStats
+{
+	asQWORD entries;        // Distinct constants currently cached
+	asQWORD stringBytes;    // Sum of their lengths
+	asQWORD memoryUsage;    // Bytes held by the cache: tables, entries and heap allocated characters
+	asQWORD hits;           // Constants requested which were already cached
+	asQWORD misses;         // Constants requested which had to be added
+	asQWORD contendedLocks; // Lock acquisitions which had to wait for another thread
+	asQWORD lockWaitNs;     // Total time spent waiting for those locks
+};
+
+struct SStdStringCacheEntry
+{
+	std::string str;
+	asUINT      refCount;
+};
+
+SStdStringCacheStats              GetStdStringCacheStats();
+// The `count` constants with the most references, most referenced first
+std::vector<SStdStringCacheEntry> GetStdStringCacheTopEntries(asUINT count);
+void                              ResetStdStringCacheCounters();
+
+// Interns the characters in the string constant cache. While referenced, the
+// same characters always give the same std::string, which is also the one the
+// scripts get for string literals, so interned strings can be compared by
+// address. Each InternStdString(), successful FindInternedStdString() and
+// AddRefInternedStdString() must be matched by a ReleaseInternedStdString().
+const std::string *InternStdString(const char *data, asUINT length);
+// The interned string with these characters, or null if there is none
+const std::string *FindInternedStdString(const char *data, asUINT length);
+void               AddRefInternedStdString(const std::string *str);
+void               ReleaseInternedStdString(const std::string *str);
+
+// Values by the address of string literals, for functions that are mostly
+// called with literals and want to skip work they did for the same literal
+// before. Each slot holds a reference to its literal in the constant cache, so
+// no other string can be at that address while the slot is in use. Slots are
+// shared by addresses that map to the same index; a newer literal replaces the
+// older one. Not thread safe: declare the tables `thread_local`.
+template<class VALUE> class CStdStringLiteralTable
+{
+public:
+	static const size_t SIZE = 64; // Must be a power of 2
+
+	CStdStringLiteralTable()
+	{
+		for( size_t n = 0; n < SIZE; n++ )
+			m_slots[n].constant = 0;
+	}
+
+	~CStdStringLiteralTable()
+	{
+		for( size_t n = 0; n < SIZE; n++ )
+			if( m_slots[n].constant )
+				ReleaseInternedStdString(m_slots[n].constant);
+	}
+
+	// The value stored for `str`, or null if `str` has no slot. A string that
+	// has one is an entry of the constant cache.
+	VALUE *Find(const std::string &str)
+	{
+		SSlot &slot = m_slots[Slot(&str)];
+		return slot.constant == &str ? &slot.value : 0;
+	}
+
+	// Gives `str` the slot for its address if it is a string literal, i.e. an
+	// entry of the constant cache. Returns the value to fill in, which still
+	// holds whatever the slot held before, or null if `str` isn't a literal.
+	VALUE *Insert(const std::string &str)
+	{
+		const std::string *constant = FindInternedStdString(str.data(), asUINT(str.length()));
+		if( constant != &str )
+		{
+			if( constant )
+				ReleaseInternedStdString(constant);
+			return 0;
+		}
+
+		// Keeps the reference from the lookup
+		SSlot &slot = m_slots[Slot(&str)];
+		if( slot.constant )
+			ReleaseInternedStdString(slot.constant);
+		slot.constant = constant;
+		return &slot.value;
+	}
+
+private:
+	CStdStringLiteralTable(const CStdStringLiteralTable &);
+	CStdStringLiteralTable &operator=(const CStdStringLiteralTable &);
+
+	struct SSlot
+	{
+		const std::string *constant;
+		VALUE              value;
+	};
+
+	static size_t Slot(const std::string *str)
+	{
+		// The entries of the constant cache are at least 16 bytes apart
+		return (size_t(uintptr_t(str)) >> 4) & (SIZE - 1);
+	}
+
+	SSlot m_slots[SIZE];
+};
+
+// Registers `string_cache_stats getStringCacheStats()` and the value type with
+// the same members as SStdStringCacheStats, for scripts that report on the cache.
+void RegisterStdStringCacheStats(asIScriptEngine *engine);
+
+// Writes `value` as the string conversions do, e.g. `"x: " + 1.5`, to `buf`,
+// which must have room for STRING_NUMBER_BUFFER_SIZE chars. Returns the length.
+const size_t STRING_NUMBER_BUFFER_SIZE = 32; // "-1.79769e+308", "-9223372036854775808"
+size_t StringNumberToChars(char *buf, asINT64 value);
+size_t StringNumberToChars(char *buf, asQWORD value);
+size_t StringNumberToChars(char *buf, double value);
+size_t StringNumberToChars(char *buf, float value);
+size_t StringNumberToChars(char *buf, bool value);
+
+// Parses the number at the start of the `length` chars at `str` as parseInt(),
+// parseUInt() and parseFloat() do. The text doesn't need to be null terminated.
+asINT64 StringParseInt(const char *str, size_t length, asUINT base, asUINT *byteCount);
+asQWORD StringParseUInt(const char *str, size_t length, asUINT base, asUINT *byteCount);
+double  StringParseFloat(const char *str, size_t length, asUINT *byteCount);
+
 END_AS_NAMESPACE
 
 #endif
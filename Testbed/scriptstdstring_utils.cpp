@@ -0,0 +1,327 @@
+#include <assert.h>
+#include "scriptstdstring.h"
+#include "scriptstringsearch.h"
+#include "scriptstringslice.h"
+// The array add-on of the AngelScript SDK (add_on/scriptarray), which must be
+// on the include path and linked in to use these functions
+#include "scriptarray.h"
+#include <string.h> // strstr()
+#include <new>      // placement new
+
+using namespace std;
+
+// This macro is used to avoid warnings about unused variables.
+// Usually where the variables are only used in debug mode.
+#define UNUSED_VAR(x) (void)(x)
+
+BEGIN_AS_NAMESPACE
+
+// Engine user data slot holding the `array<string>` type, looked up once at registration
+const asPWORD STRINGUTILS_ARRAYTYPE_UDATA = 2002;
+
+static asITypeInfo *GetStringArrayType()
+{
+	asIScriptEngine *engine = asGetActiveContext()->GetEngine();
+	return reinterpret_cast<asITypeInfo*>(engine->GetUserData(STRINGUTILS_ARRAYTYPE_UDATA));
+}
+
+// This function takes an input string and splits it into parts by looking
+// for a specified delimiter. Example:
+//
+// string str = "A|B||D";
+// array<string>@ array = str.split("|");
+//
+// The resulting array has the following elements:
+//
+// {"A", "B", "", "D"}
+//
+// The delimiters are counted first, so the array is created with its final
+// size instead of growing by one element per part.
+//
+// AngelScript signature:
+// array<string>@ string::split(const string &in delim) const
+static CScriptArray *StringSplit(const string &delim, const string &str)
+{
+	const char *s = str.data();
+	const size_t length = str.length();
+
+	// An empty delimiter would match everywhere, the whole string is the only part
+	asUINT count = 1;
+	if (!delim.empty())
+	{
+		for (size_t pos = 0; (pos = StringSearchFind(s, length, delim.data(), delim.length(), pos)) != string::npos; pos += delim.length())
+			count++;
+	}
+
+	CScriptArray *array = CScriptArray::Create(GetStringArrayType(), count);
+
+	size_t prev = 0;
+	for (asUINT n = 0; n + 1 < count; n++)
+	{
+		size_t pos = StringSearchFind(s, length, delim.data(), delim.length(), prev);
+		static_cast<string*>(array->At(n))->assign(s + prev, pos - prev);
+		prev = pos + delim.length();
+	}
+	static_cast<string*>(array->At(count - 1))->assign(s + prev, length - prev);
+
+	return array;
+}
+
+static void StringSplit_Generic(asIScriptGeneric *gen)
+{
+	// Get the arguments
+	string *str   = (string*)gen->GetObject();
+	string *delim = *(string**)gen->GetAddressOfArg(0);
+
+	// Return the array by handle
+	*(CScriptArray**)gen->GetAddressOfReturnLocation() = StringSplit(*delim, *str);
+}
+
+// This function takes as input an array of string handles as well as a
+// delimiter and concatenates the array elements into one delimited string.
+// Example:
+//
+// array<string> array = {"A", "B", "", "D"};
+// string str = join(array, "|");
+//
+// The resulting string is:
+//
+// "A|B||D"
+//
+// The total length is computed first, so the result is allocated only once.
+//
+// AngelScript signature:
+// string join(const array<string> &in array, const string &in delim)
+static string StringJoin(const CScriptArray &array, const string &delim)
+{
+	string str;
+	const asUINT count = array.GetSize();
+	if (count == 0)
+		return str;
+
+	size_t length = delim.length() * (count - 1);
+	for (asUINT n = 0; n < count; n++)
+		length += static_cast<const string*>(array.At(n))->length();
+	str.reserve(length);
+
+	str += *static_cast<const string*>(array.At(0));
+	for (asUINT n = 1; n < count; n++)
+	{
+		str += delim;
+		str += *static_cast<const string*>(array.At(n));
+	}
+	return str;
+}
+
+static void StringJoin_Generic(asIScriptGeneric *gen)
+{
+	// Get the arguments
+	CScriptArray  *array = *(CScriptArray**)gen->GetAddressOfArg(0);
+	string        *delim = *(string**)gen->GetAddressOfArg(1);
+
+	// Return the string
+	new(gen->GetAddressOfReturnLocation()) string(StringJoin(*array, *delim));
+}
+
+// Iterates over the parts that split() would return, one at a time, so the
+// parts don't have to be stored all at once. Example:
+//
+// split_iterator it(text, ",");
+// while (it.next())
+//     Print(it.part + "\n");
+//
+// The iterator keeps the input as a string_slice. A `string` is copied into it
+// once, as the script may modify the string while iterating; a `string_slice`
+// is shared without copying, and copying the iterator copies no characters.
+// `offset` and `length` give the position of the current part, and, when
+// string_slice is registered, `slice` returns the part without allocating.
+// Only `part` creates a new string.
+//
+// split_iterator it(string_slice(text), ",");
+// while (it.next())
+//     total += parseInt(it.slice);
+class CScriptSplitIterator
+{
+public:
+	CScriptSplitIterator(const CScriptStringSlice &str, const string &delim)
+		: m_str(str)
+		, m_delim(delim)
+		, m_next(0)
+		, m_offset(0)
+		, m_length(0)
+		, m_done(false)
+	{
+	}
+
+	bool Next()
+	{
+		if (m_done)
+			return false;
+
+		size_t pos = m_delim.empty() ? string::npos : StringSearchFind(m_str.data(), m_str.length(), m_delim.data(), m_delim.length(), m_next);
+		m_offset = m_next;
+		if (pos == string::npos)
+		{
+			// The remainder is the last part
+			m_length = m_str.length() - m_next;
+			m_done = true;
+		}
+		else
+		{
+			m_length = pos - m_next;
+			m_next = pos + m_delim.length();
+		}
+		return true;
+	}
+
+	string             GetPart() const  { return string(m_str.data() + m_offset, m_length); }
+	CScriptStringSlice GetSlice() const { return m_str.Slice(asUINT(m_offset), int(m_length)); }
+	asUINT             GetOffset() const { return asUINT(m_offset); }
+	asUINT             GetLength() const { return asUINT(m_length); }
+
+protected:
+	CScriptStringSlice m_str;
+	string             m_delim;
+	size_t             m_next;   // Where the part after the current one starts
+	size_t             m_offset; // Current part
+	size_t             m_length;
+	bool               m_done;
+};
+
+static void ConstructSplitIterator(const string &str, const string &delim, CScriptSplitIterator *thisPointer)
+{
+	new(thisPointer) CScriptSplitIterator(CScriptStringSlice(str), delim);
+}
+
+static void ConstructSplitIteratorFromSlice(const CScriptStringSlice &str, const string &delim, CScriptSplitIterator *thisPointer)
+{
+	new(thisPointer) CScriptSplitIterator(str, delim);
+}
+
+static void CopyConstructSplitIterator(const CScriptSplitIterator &other, CScriptSplitIterator *thisPointer)
+{
+	new(thisPointer) CScriptSplitIterator(other);
+}
+
+static void DestructSplitIterator(CScriptSplitIterator *thisPointer)
+{
+	thisPointer->~CScriptSplitIterator();
+}
+
+static void ConstructSplitIterator_Generic(asIScriptGeneric *gen)
+{
+	string *str   = *(string**)gen->GetAddressOfArg(0);
+	string *delim = *(string**)gen->GetAddressOfArg(1);
+	new(gen->GetObject()) CScriptSplitIterator(CScriptStringSlice(*str), *delim);
+}
+
+static void ConstructSplitIteratorFromSlice_Generic(asIScriptGeneric *gen)
+{
+	CScriptStringSlice *str = *(CScriptStringSlice**)gen->GetAddressOfArg(0);
+	string *delim = *(string**)gen->GetAddressOfArg(1);
+	new(gen->GetObject()) CScriptSplitIterator(*str, *delim);
+}
+
+static void CopyConstructSplitIterator_Generic(asIScriptGeneric *gen)
+{
+	CScriptSplitIterator *other = (CScriptSplitIterator*)gen->GetArgObject(0);
+	new(gen->GetObject()) CScriptSplitIterator(*other);
+}
+
+static void DestructSplitIterator_Generic(asIScriptGeneric *gen)
+{
+	((CScriptSplitIterator*)gen->GetObject())->~CScriptSplitIterator();
+}
+
+static void AssignSplitIterator_Generic(asIScriptGeneric *gen)
+{
+	CScriptSplitIterator *other = (CScriptSplitIterator*)gen->GetArgObject(0);
+	CScriptSplitIterator *self = (CScriptSplitIterator*)gen->GetObject();
+	*self = *other;
+	gen->SetReturnAddress(self);
+}
+
+static void SplitIteratorNext_Generic(asIScriptGeneric *gen)
+{
+	gen->SetReturnByte(((CScriptSplitIterator*)gen->GetObject())->Next());
+}
+
+static void SplitIteratorGetPart_Generic(asIScriptGeneric *gen)
+{
+	new(gen->GetAddressOfReturnLocation()) string(((CScriptSplitIterator*)gen->GetObject())->GetPart());
+}
+
+static void SplitIteratorGetSlice_Generic(asIScriptGeneric *gen)
+{
+	new(gen->GetAddressOfReturnLocation()) CScriptStringSlice(((CScriptSplitIterator*)gen->GetObject())->GetSlice());
+}
+
+static void SplitIteratorGetOffset_Generic(asIScriptGeneric *gen)
+{
+	gen->SetReturnDWord(((CScriptSplitIterator*)gen->GetObject())->GetOffset());
+}
+
+static void SplitIteratorGetLength_Generic(asIScriptGeneric *gen)
+{
+	gen->SetReturnDWord(((CScriptSplitIterator*)gen->GetObject())->GetLength());
+}
+
+// This is where the utility functions are registered.
+// The string type must have been registered first, as well as the array
+// add-on with RegisterScriptArray(). If string_slice is registered too
+// (RegisterStringSlice()), split_iterator can take and return slices.
+void RegisterStdStringUtils(asIScriptEngine *engine)
+{
+	int r = 0;
+	UNUSED_VAR(r);
+
+	bool withSlices = engine->GetTypeInfoByName("string_slice") != 0;
+
+	r = engine->RegisterObjectType("split_iterator", sizeof(CScriptSplitIterator), asOBJ_VALUE | asOBJ_APP_CLASS_CDAK); assert( r >= 0 );
+
+	if (strstr(asGetLibraryOptions(), "AS_MAX_PORTABILITY"))
+	{
+		r = engine->RegisterObjectMethod("string", "array<string>@ split(const string &in) const", asFUNCTION(StringSplit_Generic), asCALL_GENERIC); assert( r >= 0 );
+		r = engine->RegisterGlobalFunction("string join(const array<string> &in, const string &in)", asFUNCTION(StringJoin_Generic), asCALL_GENERIC); assert( r >= 0 );
+
+		r = engine->RegisterObjectBehaviour("split_iterator", asBEHAVE_CONSTRUCT, "void f(const string &in, const string &in)", asFUNCTION(ConstructSplitIterator_Generic), asCALL_GENERIC); assert( r >= 0 );
+		r = engine->RegisterObjectBehaviour("split_iterator", asBEHAVE_CONSTRUCT, "void f(const split_iterator &in)", asFUNCTION(CopyConstructSplitIterator_Generic), asCALL_GENERIC); assert( r >= 0 );
+		r = engine->RegisterObjectBehaviour("split_iterator", asBEHAVE_DESTRUCT, "void f()", asFUNCTION(DestructSplitIterator_Generic), asCALL_GENERIC); assert( r >= 0 );
+		r = engine->RegisterObjectMethod("split_iterator", "split_iterator &opAssign(const split_iterator &in)", asFUNCTION(AssignSplitIterator_Generic), asCALL_GENERIC); assert( r >= 0 );
+		r = engine->RegisterObjectMethod("split_iterator", "bool next()", asFUNCTION(SplitIteratorNext_Generic), asCALL_GENERIC); assert( r >= 0 );
+		r = engine->RegisterObjectMethod("split_iterator", "string get_part() const property", asFUNCTION(SplitIteratorGetPart_Generic), asCALL_GENERIC); assert( r >= 0 );
+		r = engine->RegisterObjectMethod("split_iterator", "uint get_offset() const property", asFUNCTION(SplitIteratorGetOffset_Generic), asCALL_GENERIC); assert( r >= 0 );
+		r = engine->RegisterObjectMethod("split_iterator", "uint get_length() const property", asFUNCTION(SplitIteratorGetLength_Generic), asCALL_GENERIC); assert( r >= 0 );
+
+		if (withSlices)
+		{
+			r = engine->RegisterObjectBehaviour("split_iterator", asBEHAVE_CONSTRUCT, "void f(const string_slice &in, const string &in)", asFUNCTION(ConstructSplitIteratorFromSlice_Generic), asCALL_GENERIC); assert( r >= 0 );
+			r = engine->RegisterObjectMethod("split_iterator", "string_slice get_slice() const property", asFUNCTION(SplitIteratorGetSlice_Generic), asCALL_GENERIC); assert( r >= 0 );
+		}
+	}
+	else
+	{
+		r = engine->RegisterObjectMethod("string", "array<string>@ split(const string &in) const", asFUNCTION(StringSplit), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+		r = engine->RegisterGlobalFunction("string join(const array<string> &in, const string &in)", asFUNCTION(StringJoin), asCALL_CDECL); assert( r >= 0 );
+
+		r = engine->RegisterObjectBehaviour("split_iterator", asBEHAVE_CONSTRUCT, "void f(const string &in, const string &in)", asFUNCTION(ConstructSplitIterator), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+		r = engine->RegisterObjectBehaviour("split_iterator", asBEHAVE_CONSTRUCT, "void f(const split_iterator &in)", asFUNCTION(CopyConstructSplitIterator), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+		r = engine->RegisterObjectBehaviour("split_iterator", asBEHAVE_DESTRUCT, "void f()", asFUNCTION(DestructSplitIterator), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+		r = engine->RegisterObjectMethod("split_iterator", "split_iterator &opAssign(const split_iterator &in)", asMETHODPR(CScriptSplitIterator, operator=, (const CScriptSplitIterator &), CScriptSplitIterator &), asCALL_THISCALL); assert( r >= 0 );
+		r = engine->RegisterObjectMethod("split_iterator", "bool next()", asMETHOD(CScriptSplitIterator, Next), asCALL_THISCALL); assert( r >= 0 );
+		r = engine->RegisterObjectMethod("split_iterator", "string get_part() const property", asMETHOD(CScriptSplitIterator, GetPart), asCALL_THISCALL); assert( r >= 0 );
+		r = engine->RegisterObjectMethod("split_iterator", "uint get_offset() const property", asMETHOD(CScriptSplitIterator, GetOffset), asCALL_THISCALL); assert( r >= 0 );
+		r = engine->RegisterObjectMethod("split_iterator", "uint get_length() const property", asMETHOD(CScriptSplitIterator, GetLength), asCALL_THISCALL); assert( r >= 0 );
+
+		if (withSlices)
+		{
+			r = engine->RegisterObjectBehaviour("split_iterator", asBEHAVE_CONSTRUCT, "void f(const string_slice &in, const string &in)", asFUNCTION(ConstructSplitIteratorFromSlice), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+			r = engine->RegisterObjectMethod("split_iterator", "string_slice get_slice() const property", asMETHOD(CScriptSplitIterator, GetSlice), asCALL_THISCALL); assert( r >= 0 );
+		}
+	}
+
+	// The template instance is held by split() registered above, so it stays valid
+	engine->SetUserData(engine->GetTypeInfoByDecl("array<string>"), STRINGUTILS_ARRAYTYPE_UDATA);
+}
+
+END_AS_NAMESPACE
@@ -0,0 +1,108 @@
+#include "scriptstringbuilder.h"
+#include "scriptstdstring.h"
+#include <assert.h> // assert()
+#include <new>      // placement new
+
+using namespace std;
+
+// This macro is used to avoid warnings about unused variables.
+// Usually where the variables are only used in debug mode.
+#define UNUSED_VAR(x) (void)(x)
+
+BEGIN_AS_NAMESPACE
+
+// The number is written to the stack first, as StringNumberToChars() needs
+// room for the longest number, and then appended without a temporary string
+template<class T>
+static void AppendNumber(string &buffer, T value)
+{
+	char buf[STRING_NUMBER_BUFFER_SIZE];
+	buffer.append(buf, StringNumberToChars(buf, value));
+}
+
+CScriptStringBuilder &CScriptStringBuilder::Append(asINT64 value)
+{
+	AppendNumber(m_buffer, value);
+	return *this;
+}
+
+CScriptStringBuilder &CScriptStringBuilder::Append(asQWORD value)
+{
+	AppendNumber(m_buffer, value);
+	return *this;
+}
+
+CScriptStringBuilder &CScriptStringBuilder::Append(double value)
+{
+	AppendNumber(m_buffer, value);
+	return *this;
+}
+
+CScriptStringBuilder &CScriptStringBuilder::Append(float value)
+{
+	AppendNumber(m_buffer, value);
+	return *this;
+}
+
+CScriptStringBuilder &CScriptStringBuilder::Append(bool value)
+{
+	AppendNumber(m_buffer, value);
+	return *this;
+}
+
+static void ConstructStringBuilder(CScriptStringBuilder *thisPointer)
+{
+	new(thisPointer) CScriptStringBuilder();
+}
+
+static void ConstructStringBuilderWithCapacity(asUINT capacity, CScriptStringBuilder *thisPointer)
+{
+	new(thisPointer) CScriptStringBuilder(capacity);
+}
+
+static void CopyConstructStringBuilder(const CScriptStringBuilder &other, CScriptStringBuilder *thisPointer)
+{
+	new(thisPointer) CScriptStringBuilder(other);
+}
+
+static void DestructStringBuilder(CScriptStringBuilder *thisPointer)
+{
+	thisPointer->~CScriptStringBuilder();
+}
+
+static string StringBuilderStr(const CScriptStringBuilder &builder)
+{
+	return builder.Str();
+}
+
+void RegisterScriptStringBuilder(asIScriptEngine *engine)
+{
+	int r = 0;
+	UNUSED_VAR(r);
+
+	r = engine->RegisterObjectType("StringBuilder", sizeof(CScriptStringBuilder), asOBJ_VALUE | asOBJ_APP_CLASS_CDAK); assert( r >= 0 );
+
+	r = engine->RegisterObjectBehaviour("StringBuilder", asBEHAVE_CONSTRUCT, "void f()", asFUNCTION(ConstructStringBuilder), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectBehaviour("StringBuilder", asBEHAVE_CONSTRUCT, "void f(uint capacity) explicit", asFUNCTION(ConstructStringBuilderWithCapacity), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectBehaviour("StringBuilder", asBEHAVE_CONSTRUCT, "void f(const StringBuilder &in)", asFUNCTION(CopyConstructStringBuilder), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectBehaviour("StringBuilder", asBEHAVE_DESTRUCT, "void f()", asFUNCTION(DestructStringBuilder), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("StringBuilder", "StringBuilder &opAssign(const StringBuilder &in)", asMETHODPR(CScriptStringBuilder, operator=, (const CScriptStringBuilder &), CScriptStringBuilder &), asCALL_THISCALL); assert( r >= 0 );
+
+	r = engine->RegisterObjectMethod("StringBuilder", "void reserve(uint capacity)", asMETHOD(CScriptStringBuilder, Reserve), asCALL_THISCALL); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("StringBuilder", "void clear()", asMETHOD(CScriptStringBuilder, Clear), asCALL_THISCALL); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("StringBuilder", "uint length() const", asMETHOD(CScriptStringBuilder, Length), asCALL_THISCALL); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("StringBuilder", "uint capacity() const", asMETHOD(CScriptStringBuilder, Capacity), asCALL_THISCALL); assert( r >= 0 );
+
+	// Returns a copy, the only place where the built string is allocated
+	r = engine->RegisterObjectMethod("StringBuilder", "string str() const", asFUNCTION(StringBuilderStr), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+
+	// The appends return the builder for chaining, same overloads as the string operators
+	r = engine->RegisterObjectMethod("StringBuilder", "StringBuilder &append(const string &in)", asMETHODPR(CScriptStringBuilder, Append, (const string &), CScriptStringBuilder &), asCALL_THISCALL); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("StringBuilder", "StringBuilder &append(int64)", asMETHODPR(CScriptStringBuilder, Append, (asINT64), CScriptStringBuilder &), asCALL_THISCALL); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("StringBuilder", "StringBuilder &append(uint64)", asMETHODPR(CScriptStringBuilder, Append, (asQWORD), CScriptStringBuilder &), asCALL_THISCALL); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("StringBuilder", "StringBuilder &append(double)", asMETHODPR(CScriptStringBuilder, Append, (double), CScriptStringBuilder &), asCALL_THISCALL); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("StringBuilder", "StringBuilder &append(float)", asMETHODPR(CScriptStringBuilder, Append, (float), CScriptStringBuilder &), asCALL_THISCALL); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("StringBuilder", "StringBuilder &append(bool)", asMETHODPR(CScriptStringBuilder, Append, (bool), CScriptStringBuilder &), asCALL_THISCALL); assert( r >= 0 );
+}
+
+END_AS_NAMESPACE
@@ -0,0 +1,60 @@
+//
+// Script string builder
+//
+// Every `a + b + c` in script creates a temporary string per operator, so a
+// line like `"x: " + x + ", y: " + y + "\n"` allocates several strings that
+// are thrown away right after. The StringBuilder collects the pieces in one
+// growing buffer instead, writing numbers directly into it, and materializes
+// the result once with str():
+//
+//   StringBuilder sb;
+//   sb.reserve(64);
+//   sb.append("x: ").append(x).append(", y: ").append(y).append("\n");
+//   Print(sb.str());
+//
+// Numbers and bools are written the same way as by the string operators.
+// clear() keeps the buffer, so a builder can be reused without allocating.
+// The `string` type must be registered first.
+//
+
+#ifndef SCRIPTSTRINGBUILDER_H
+#define SCRIPTSTRINGBUILDER_H
+
+#ifndef ANGELSCRIPT_H
+// Avoid having to inform include path if header is already include before
+#include <angelscript.h>
+#endif
+
+#include <string>
+
+BEGIN_AS_NAMESPACE
+
+class CScriptStringBuilder
+{
+public:
+	CScriptStringBuilder() {}
+	explicit CScriptStringBuilder(asUINT capacity) { m_buffer.reserve(capacity); }
+
+	void Reserve(asUINT capacity) { m_buffer.reserve(capacity); }
+	void Clear() { m_buffer.clear(); }
+
+	CScriptStringBuilder &Append(const std::string &str) { m_buffer += str; return *this; }
+	CScriptStringBuilder &Append(asINT64 value);
+	CScriptStringBuilder &Append(asQWORD value);
+	CScriptStringBuilder &Append(double value);
+	CScriptStringBuilder &Append(float value);
+	CScriptStringBuilder &Append(bool value);
+
+	asUINT             Length() const { return asUINT(m_buffer.length()); }
+	asUINT             Capacity() const { return asUINT(m_buffer.capacity()); }
+	const std::string &Str() const { return m_buffer; }
+
+protected:
+	std::string m_buffer;
+};
+
+void RegisterScriptStringBuilder(asIScriptEngine *engine);
+
+END_AS_NAMESPACE
+
+#endif
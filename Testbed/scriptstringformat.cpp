@@ -0,0 +1,271 @@
+#include "scriptstringformat.h"
+#include "scriptstdstring.h"
+#include <assert.h> // assert()
+#include <stdint.h> // uintptr_t
+#include <string.h> // strlen()
+#include <charconv> // std::to_chars()
+#include <new>      // placement new
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// This macro is used to avoid warnings about unused variables.
+// Usually where the variables are only used in debug mode.
+#define UNUSED_VAR(x) (void)(x)
+
+BEGIN_AS_NAMESPACE
+
+// Engine user data slot holding the type id of `string`, looked up once at registration
+const asPWORD STRINGFORMAT_TYPEID_UDATA = 2003;
+
+// A run of the format string followed by a placeholder
+struct SFormatSegment
+{
+	asUINT literalStart;
+	asUINT literalLength;
+	int    arg; // Index of the argument, or -1 if the run isn't followed by one
+};
+
+struct SParsedFormat
+{
+	vector<SFormatSegment> segments;
+	asUINT                 argCount; // Highest argument index referred to + 1
+	const char            *error;    // Null if the format string is valid
+};
+
+static void ParseFormat(const char *fmt, size_t length, SParsedFormat &parsed)
+{
+	parsed.segments.clear();
+	parsed.argCount = 0;
+	parsed.error = 0;
+
+	asUINT nextArg = 0;
+	size_t literalStart = 0;
+	size_t n = 0;
+	while( n < length )
+	{
+		char c = fmt[n];
+		if( c != '{' && c != '}' )
+		{
+			n++;
+			continue;
+		}
+
+		if( n + 1 < length && fmt[n + 1] == c )
+		{
+			// An escaped brace, the run ends with the first of the two
+			SFormatSegment segment = { asUINT(literalStart), asUINT(n + 1 - literalStart), -1 };
+			parsed.segments.push_back(segment);
+			n += 2;
+			literalStart = n;
+			continue;
+		}
+
+		if( c == '}' )
+		{
+			parsed.error = "Unmatched '}' in format string";
+			return;
+		}
+
+		// A placeholder, with or without an index
+		size_t close = n + 1;
+		asUINT index = 0;
+		for( ; close < length && fmt[close] >= '0' && fmt[close] <= '9'; close++ )
+		{
+			index = index * 10 + asUINT(fmt[close] - '0');
+			if( index >= FORMAT_MAX_ARGS )
+			{
+				parsed.error = "Argument index out of range in format string";
+				return;
+			}
+		}
+		if( close >= length || fmt[close] != '}' )
+		{
+			parsed.error = "Invalid placeholder in format string";
+			return;
+		}
+		if( close == n + 1 )
+			index = nextArg++;
+
+		SFormatSegment segment = { asUINT(literalStart), asUINT(n - literalStart), int(index) };
+		parsed.segments.push_back(segment);
+		if( index + 1 > parsed.argCount )
+			parsed.argCount = index + 1;
+
+		n = close + 1;
+		literalStart = n;
+	}
+
+	if( literalStart < length )
+	{
+		SFormatSegment segment = { asUINT(literalStart), asUINT(length - literalStart), -1 };
+		parsed.segments.push_back(segment);
+	}
+}
+
+// Parsed format strings by the address of the string literal. Per thread, so
+// the lookups need no lock.
+static thread_local CStdStringLiteralTable<SParsedFormat> formatCache;
+
+// Returns the cached parse if `fmt` is a string literal, otherwise parses it into `uncached`
+static const SParsedFormat &GetParsedFormat(const string &fmt, SParsedFormat &uncached)
+{
+	SParsedFormat *parsed = formatCache.Find(fmt);
+	if( parsed )
+		return *parsed;
+
+	parsed = formatCache.Insert(fmt);
+	if( parsed == 0 )
+		parsed = &uncached;
+
+	// Reuses the segments of the format that had the slot before
+	ParseFormat(fmt.data(), fmt.length(), *parsed);
+	return *parsed;
+}
+
+// The text of one argument: the type name of objects followed by `data`
+struct SFormatArg
+{
+	const char *prefix;
+	size_t      prefixLength;
+	const char *data;
+	size_t      length;
+	char        buf[STRING_NUMBER_BUFFER_SIZE];
+};
+
+static void FormatArg(asIScriptEngine *engine, int stringTypeId, int typeId, const void *ref, SFormatArg &arg)
+{
+	arg.prefix = "";
+	arg.prefixLength = 0;
+	arg.data = arg.buf;
+
+	switch( typeId )
+	{
+	case asTYPEID_BOOL:   arg.length = StringNumberToChars(arg.buf, *static_cast<const bool*>(ref)); return;
+	case asTYPEID_INT8:   arg.length = StringNumberToChars(arg.buf, asINT64(*static_cast<const signed char*>(ref))); return;
+	case asTYPEID_INT16:  arg.length = StringNumberToChars(arg.buf, asINT64(*static_cast<const short*>(ref))); return;
+	case asTYPEID_INT32:  arg.length = StringNumberToChars(arg.buf, asINT64(*static_cast<const int*>(ref))); return;
+	case asTYPEID_INT64:  arg.length = StringNumberToChars(arg.buf, *static_cast<const asINT64*>(ref)); return;
+	case asTYPEID_UINT8:  arg.length = StringNumberToChars(arg.buf, asQWORD(*static_cast<const unsigned char*>(ref))); return;
+	case asTYPEID_UINT16: arg.length = StringNumberToChars(arg.buf, asQWORD(*static_cast<const unsigned short*>(ref))); return;
+	case asTYPEID_UINT32: arg.length = StringNumberToChars(arg.buf, asQWORD(*static_cast<const unsigned int*>(ref))); return;
+	case asTYPEID_UINT64: arg.length = StringNumberToChars(arg.buf, *static_cast<const asQWORD*>(ref)); return;
+	case asTYPEID_FLOAT:  arg.length = StringNumberToChars(arg.buf, *static_cast<const float*>(ref)); return;
+	case asTYPEID_DOUBLE: arg.length = StringNumberToChars(arg.buf, *static_cast<const double*>(ref)); return;
+	}
+
+	if( typeId == stringTypeId )
+	{
+		const string *str = static_cast<const string*>(ref);
+		arg.data = str->data();
+		arg.length = str->length();
+		return;
+	}
+
+	if( !(typeId & asTYPEID_MASK_OBJECT) )
+	{
+		// The other primitives are enums
+		arg.length = StringNumberToChars(arg.buf, asINT64(*static_cast<const int*>(ref)));
+		return;
+	}
+
+	// Handles, e.g. of the RefCountingObject types, and other objects
+	asITypeInfo *type = engine->GetTypeInfoById(typeId);
+	const void *obj = (typeId & asTYPEID_OBJHANDLE) ? *static_cast<void* const*>(ref) : ref;
+	if( type && (type->GetFlags() & asOBJ_ASHANDLE) )
+	{
+		// A value type standing in for a handle, e.g. RefCountingObjectPtr, arrives
+		// as the wrapper itself. Its first member is the pointer to the object, and
+		// its opImplCast() returns a handle of the object's type.
+		obj = *static_cast<void* const*>(ref);
+		asIScriptFunction *cast = type->GetMethodByName("opImplCast");
+		asITypeInfo *objType = cast ? engine->GetTypeInfoById(cast->GetReturnTypeId()) : 0;
+		if( objType )
+			type = objType;
+	}
+	if( obj == 0 )
+	{
+		arg.data = "null";
+		arg.length = 4;
+		return;
+	}
+
+	arg.prefix = type ? type->GetName() : "";
+	arg.prefixLength = strlen(arg.prefix);
+	arg.buf[0] = '@';
+	arg.buf[1] = '0';
+	arg.buf[2] = 'x';
+	arg.length = size_t(to_chars(arg.buf + 3, arg.buf + STRING_NUMBER_BUFFER_SIZE, asQWORD(uintptr_t(obj)), 16).ptr - arg.buf);
+}
+
+// AngelScript signature:
+// string format(const string &in fmt, const ?&in ...)
+static void StringFormat_Generic(asIScriptGeneric *gen)
+{
+	const string &fmt = **static_cast<string**>(gen->GetAddressOfArg(0));
+	asUINT argCount = asUINT(gen->GetArgCount()) - 1;
+
+	// Constructed first, so there is a return value in case of an exception
+	string *result = new(gen->GetAddressOfReturnLocation()) string();
+
+	SParsedFormat uncached;
+	const SParsedFormat &parsed = GetParsedFormat(fmt, uncached);
+	if( parsed.error || parsed.argCount > argCount )
+	{
+		asIScriptContext *ctx = asGetActiveContext();
+		if( ctx )
+			ctx->SetException(parsed.error ? parsed.error : "Too few arguments for format string");
+		return;
+	}
+
+	asIScriptEngine *engine = gen->GetEngine();
+	int stringTypeId = int(asPWORD(engine->GetUserData(STRINGFORMAT_TYPEID_UDATA)));
+
+	// Arguments that aren't referred to are ignored
+	SFormatArg args[FORMAT_MAX_ARGS];
+	for( asUINT n = 0; n < parsed.argCount; n++ )
+		FormatArg(engine, stringTypeId, gen->GetArgTypeId(n + 1), *static_cast<void**>(gen->GetAddressOfArg(n + 1)), args[n]);
+
+	size_t length = 0;
+	for( size_t n = 0; n < parsed.segments.size(); n++ )
+	{
+		const SFormatSegment &segment = parsed.segments[n];
+		length += segment.literalLength;
+		if( segment.arg >= 0 )
+			length += args[segment.arg].prefixLength + args[segment.arg].length;
+	}
+
+	result->reserve(length);
+	for( size_t n = 0; n < parsed.segments.size(); n++ )
+	{
+		const SFormatSegment &segment = parsed.segments[n];
+		result->append(fmt.data() + segment.literalStart, segment.literalLength);
+		if( segment.arg >= 0 )
+		{
+			const SFormatArg &arg = args[segment.arg];
+			result->append(arg.prefix, arg.prefixLength).append(arg.data, arg.length);
+		}
+	}
+}
+
+void RegisterStringFormat(asIScriptEngine *engine)
+{
+	int r = 0;
+	UNUSED_VAR(r);
+
+	int stringTypeId = engine->GetTypeIdByDecl("string");
+	assert( stringTypeId >= 0 );
+	engine->SetUserData(reinterpret_cast<void*>(asPWORD(stringTypeId)), STRINGFORMAT_TYPEID_UDATA);
+
+	// The generic calling convention is used on all platforms, as only it can
+	// tell the number of arguments
+	string decl = "string format(const string &in fmt";
+	for( asUINT n = 0; n <= FORMAT_MAX_ARGS; n++ )
+	{
+		r = engine->RegisterGlobalFunction((decl + ")").c_str(), asFUNCTION(StringFormat_Generic), asCALL_GENERIC); assert( r >= 0 );
+		decl += ", const ?&in";
+	}
+}
+
+END_AS_NAMESPACE
@@ -0,0 +1,44 @@
+//
+// Script string format
+//
+// `string format(const string &in fmt, const ?&in ...)` builds a string such
+// as a log line in one go, instead of a `+` chain or formatInt() calls that
+// each create a string of their own:
+//
+// Print(format("{} took {} ms, {} items\n", name, ms, count));
+//
+// `{}` is replaced with the next argument, `{n}` with argument n (from 0),
+// `{{` and `}}` are literal braces. Numbers and bools are written as by the
+// string conversions, e.g. `"x: " + 1.5`, enums as their value, strings as
+// they are, and handles and other objects as their type and address, e.g.
+// `Horse@0x55d0c3a8e2b0`, or `null`. Types registered with asOBJ_ASHANDLE, such
+// as `HorsePtr` of RefCountingObjectPtr, are written as the handle they hold;
+// they must keep the object pointer as their first member.
+//
+// The arguments are written to small buffers on the stack first, so the
+// result is allocated once with its final size. The parse of the format string
+// is cached per thread when it's a string literal; format strings built at
+// runtime are parsed on each call. Invalid format strings, and fewer arguments
+// than the placeholders refer to, raise a script exception.
+//
+// AngelScript has no variadic functions, so format() is registered with up to
+// FORMAT_MAX_ARGS arguments. Requires `string` from RegisterStdString().
+//
+
+#ifndef SCRIPTSTRINGFORMAT_H
+#define SCRIPTSTRINGFORMAT_H
+
+#ifndef ANGELSCRIPT_H
+// Avoid having to inform include path if header is already include before
+#include <angelscript.h>
+#endif
+
+BEGIN_AS_NAMESPACE
+
+const asUINT FORMAT_MAX_ARGS = 16;
+
+void RegisterStringFormat(asIScriptEngine *engine);
+
+END_AS_NAMESPACE
+
+#endif
@@ -0,0 +1,534 @@
+#include "scriptstringsearch.h"
+#include <string.h>    // memchr(), memcmp(), memset()
+#include <atomic>      // std::atomic
+#include <string_view> // std::string_view
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define AS_STRING_SEARCH_X86
+	#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+	#include <intrin.h> // __cpuid(), _BitScanForward()
+#endif
+
+// GCC and Clang only emit the SSE2/AVX2 instructions in functions marked for them,
+// which keeps the rest of the file runnable on any CPU. MSVC doesn't need it.
+#if defined(__GNUC__) || defined(__clang__)
+	#define AS_TARGET(isa) __attribute__((target(isa)))
+#else
+	#define AS_TARGET(isa)
+#endif
+
+using namespace std;
+
+BEGIN_AS_NAMESPACE
+
+static const size_t NPOS = string_view::npos;
+
+// Byte sets up to this size are compared byte by byte with SSE2, which has no
+// shuffle for the bitmap lookup; larger ones are scanned with the scalar bitmap.
+static const size_t SSE2_SET_COMPARE_MAX = 8;
+
+static inline unsigned LowestBit(asUINT mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+static inline unsigned HighestBit(asUINT mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index;
+	_BitScanReverse(&index, mask);
+	return index;
+#else
+	return 31 - __builtin_clz(mask);
+#endif
+}
+
+// 256 bit membership bitmap, built in O(setLength)
+struct SByteSet
+{
+	SByteSet(const char *set, size_t length)
+	{
+		memset(bits, 0, sizeof(bits));
+		for (size_t n = 0; n < length; n++)
+		{
+			unsigned char c = (unsigned char)set[n];
+			bits[c >> 3] |= (unsigned char)(1 << (c & 7));
+		}
+	}
+
+	bool Contains(unsigned char c) const { return ((bits[c >> 3] >> (c & 7)) & 1) != 0; }
+
+	unsigned char bits[32];
+};
+
+// Returns the first position from `i` on whose membership is IN_SET
+template<bool IN_SET>
+static size_t ScanFirst(const unsigned char *s, size_t length, const SByteSet &set, size_t i)
+{
+	for (; i < length; i++)
+		if (set.Contains(s[i]) == IN_SET)
+			return i;
+	return NPOS;
+}
+
+// Returns the last position from `i` down, `i` being NPOS when there's nothing left
+template<bool IN_SET>
+static size_t ScanLast(const unsigned char *s, const SByteSet &set, size_t i)
+{
+	for (; i != NPOS; i--)
+		if (set.Contains(s[i]) == IN_SET)
+			return i;
+	return NPOS;
+}
+
+#ifdef AS_STRING_SEARCH_X86
+
+//--------------------------------------------------------------------------
+// SSE2
+
+AS_TARGET("sse2")
+static size_t FindSse2(const char *s, size_t length, const char *sub, size_t subLength, size_t i)
+{
+	// Candidates have the right first and last byte, only those are compared fully
+	const __m128i first = _mm_set1_epi8(sub[0]);
+	const __m128i last = _mm_set1_epi8(sub[subLength - 1]);
+	const size_t middle = subLength > 2 ? subLength - 2 : 0;
+	for (; i + subLength + 15 <= length; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(s + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(s + i + subLength - 1));
+		asUINT mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		while (mask)
+		{
+			unsigned bit = LowestBit(mask);
+			if (memcmp(s + i + bit + 1, sub + 1, middle) == 0)
+				return i + bit;
+			mask &= mask - 1;
+		}
+	}
+	return string_view(s, length).find(string_view(sub, subLength), i);
+}
+
+// `i` is the last candidate position
+AS_TARGET("sse2")
+static size_t FindLastSse2(const char *s, size_t length, const char *sub, size_t subLength, size_t i)
+{
+	const __m128i first = _mm_set1_epi8(sub[0]);
+	const __m128i last = _mm_set1_epi8(sub[subLength - 1]);
+	const size_t middle = subLength > 2 ? subLength - 2 : 0;
+	while (i != NPOS && i >= 15)
+	{
+		size_t block = i - 15;
+		__m128i a = _mm_loadu_si128((const __m128i*)(s + block));
+		__m128i b = _mm_loadu_si128((const __m128i*)(s + block + subLength - 1));
+		asUINT mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		while (mask)
+		{
+			unsigned bit = HighestBit(mask);
+			if (memcmp(s + block + bit + 1, sub + 1, middle) == 0)
+				return block + bit;
+			mask &= ~(1u << bit);
+		}
+		i = block - 1;
+	}
+	return i == NPOS ? NPOS : string_view(s, length).rfind(string_view(sub, subLength), i);
+}
+
+AS_TARGET("sse2")
+static inline asUINT MatchSetSse2(const unsigned char *p, const __m128i *chars, size_t count)
+{
+	__m128i x = _mm_loadu_si128((const __m128i*)p);
+	__m128i match = _mm_cmpeq_epi8(x, chars[0]);
+	for (size_t n = 1; n < count; n++)
+		match = _mm_or_si128(match, _mm_cmpeq_epi8(x, chars[n]));
+	return _mm_movemask_epi8(match);
+}
+
+template<bool IN_SET>
+AS_TARGET("sse2")
+static size_t FindFirstInSetSse2(const unsigned char *s, size_t length, const char *set, size_t setLength, const SByteSet &bits, size_t i)
+{
+	__m128i chars[SSE2_SET_COMPARE_MAX];
+	for (size_t n = 0; n < setLength; n++)
+		chars[n] = _mm_set1_epi8(set[n]);
+
+	for (; i + 16 <= length; i += 16)
+	{
+		asUINT mask = MatchSetSse2(s + i, chars, setLength);
+		if (!IN_SET)
+			mask = ~mask & 0xFFFF;
+		if (mask)
+			return i + LowestBit(mask);
+	}
+	return ScanFirst<IN_SET>(s, length, bits, i);
+}
+
+template<bool IN_SET>
+AS_TARGET("sse2")
+static size_t FindLastInSetSse2(const unsigned char *s, const char *set, size_t setLength, const SByteSet &bits, size_t i)
+{
+	__m128i chars[SSE2_SET_COMPARE_MAX];
+	for (size_t n = 0; n < setLength; n++)
+		chars[n] = _mm_set1_epi8(set[n]);
+
+	while (i != NPOS && i >= 15)
+	{
+		size_t block = i - 15;
+		asUINT mask = MatchSetSse2(s + block, chars, setLength);
+		if (!IN_SET)
+			mask = ~mask & 0xFFFF;
+		if (mask)
+			return block + HighestBit(mask);
+		i = block - 1;
+	}
+	return ScanLast<IN_SET>(s, bits, i);
+}
+
+//--------------------------------------------------------------------------
+// AVX2
+
+AS_TARGET("avx2")
+static size_t FindAvx2(const char *s, size_t length, const char *sub, size_t subLength, size_t i)
+{
+	const __m256i first = _mm256_set1_epi8(sub[0]);
+	const __m256i last = _mm256_set1_epi8(sub[subLength - 1]);
+	const size_t middle = subLength > 2 ? subLength - 2 : 0;
+	for (; i + subLength + 31 <= length; i += 32)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(s + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(s + i + subLength - 1));
+		asUINT mask = (asUINT)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+		while (mask)
+		{
+			unsigned bit = LowestBit(mask);
+			if (memcmp(s + i + bit + 1, sub + 1, middle) == 0)
+				return i + bit;
+			mask &= mask - 1;
+		}
+	}
+	return string_view(s, length).find(string_view(sub, subLength), i);
+}
+
+AS_TARGET("avx2")
+static size_t FindLastAvx2(const char *s, size_t length, const char *sub, size_t subLength, size_t i)
+{
+	const __m256i first = _mm256_set1_epi8(sub[0]);
+	const __m256i last = _mm256_set1_epi8(sub[subLength - 1]);
+	const size_t middle = subLength > 2 ? subLength - 2 : 0;
+	while (i != NPOS && i >= 31)
+	{
+		size_t block = i - 31;
+		__m256i a = _mm256_loadu_si256((const __m256i*)(s + block));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(s + block + subLength - 1));
+		asUINT mask = (asUINT)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+		while (mask)
+		{
+			unsigned bit = HighestBit(mask);
+			if (memcmp(s + block + bit + 1, sub + 1, middle) == 0)
+				return block + bit;
+			mask &= ~(1u << bit);
+		}
+		i = block - 1;
+	}
+	return i == NPOS ? NPOS : string_view(s, length).rfind(string_view(sub, subLength), i);
+}
+
+// The bitmap split by nibbles: the row for a byte is picked by its low nibble,
+// from `low` for high nibbles 0-7 and from `high` for 8-15, and the high
+// nibble selects the bit within the row. Both are looked up with a shuffle.
+struct SNibbleTables
+{
+	SNibbleTables(const char *set, size_t length)
+	{
+		memset(low, 0, sizeof(low));
+		memset(high, 0, sizeof(high));
+		for (size_t n = 0; n < length; n++)
+		{
+			unsigned char c = (unsigned char)set[n];
+			(c < 0x80 ? low : high)[c & 0x0F] |= (unsigned char)(1 << ((c >> 4) & 7));
+		}
+	}
+
+	unsigned char low[16];
+	unsigned char high[16];
+};
+
+AS_TARGET("avx2")
+static inline asUINT MatchSetAvx2(const unsigned char *p, __m256i low, __m256i high, __m256i bitTable)
+{
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	__m256i x = _mm256_loadu_si256((const __m256i*)p);
+	__m256i lo = _mm256_and_si256(x, nibble);
+	__m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble);
+	// The sign bit of each byte, i.e. high nibble >= 8, chooses the row table
+	__m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(low, lo), _mm256_shuffle_epi8(high, lo), x);
+	__m256i bit = _mm256_shuffle_epi8(bitTable, hi);
+	return (asUINT)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit));
+}
+
+#define AS_AVX2_SET_TABLES(set, setLength) \
+	SNibbleTables tables(set, setLength); \
+	const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables.low)); \
+	const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables.high)); \
+	const __m256i bitTable = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, \
+	                                          1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128)
+
+template<bool IN_SET>
+AS_TARGET("avx2")
+static size_t FindFirstInSetAvx2(const unsigned char *s, size_t length, const char *set, size_t setLength, const SByteSet &bits, size_t i)
+{
+	AS_AVX2_SET_TABLES(set, setLength);
+	for (; i + 32 <= length; i += 32)
+	{
+		asUINT mask = MatchSetAvx2(s + i, low, high, bitTable);
+		if (!IN_SET)
+			mask = ~mask;
+		if (mask)
+			return i + LowestBit(mask);
+	}
+	return ScanFirst<IN_SET>(s, length, bits, i);
+}
+
+template<bool IN_SET>
+AS_TARGET("avx2")
+static size_t FindLastInSetAvx2(const unsigned char *s, const char *set, size_t setLength, const SByteSet &bits, size_t i)
+{
+	AS_AVX2_SET_TABLES(set, setLength);
+	while (i != NPOS && i >= 31)
+	{
+		size_t block = i - 31;
+		asUINT mask = MatchSetAvx2(s + block, low, high, bitTable);
+		if (!IN_SET)
+			mask = ~mask;
+		if (mask)
+			return block + HighestBit(mask);
+		i = block - 1;
+	}
+	return ScanLast<IN_SET>(s, bits, i);
+}
+
+#undef AS_AVX2_SET_TABLES
+
+#endif // AS_STRING_SEARCH_X86
+
+//--------------------------------------------------------------------------
+// Dispatch
+
+static EStringSearchLevel DetectStringSearchLevel()
+{
+#if defined(AS_STRING_SEARCH_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	// AVX2 also needs the OS to save the YMM registers
+	bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osAvx)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+	if (avx2)
+		return STRING_SEARCH_AVX2;
+	if (sse2)
+		return STRING_SEARCH_SSE2;
+#elif defined(AS_STRING_SEARCH_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return STRING_SEARCH_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return STRING_SEARCH_SSE2;
+#endif
+	return STRING_SEARCH_SCALAR;
+}
+
+// -1 until first used
+static atomic<int> g_searchLevel(-1);
+
+static EStringSearchLevel SearchLevel()
+{
+	int level = g_searchLevel.load(memory_order_relaxed);
+	if (level < 0)
+	{
+		level = GetSupportedStringSearchLevel();
+		g_searchLevel.store(level, memory_order_relaxed);
+	}
+	return EStringSearchLevel(level);
+}
+
+EStringSearchLevel GetSupportedStringSearchLevel()
+{
+	static const EStringSearchLevel supported = DetectStringSearchLevel();
+	return supported;
+}
+
+void SetStringSearchLevel(EStringSearchLevel level)
+{
+	EStringSearchLevel supported = GetSupportedStringSearchLevel();
+	g_searchLevel.store(level < supported ? level : supported, memory_order_relaxed);
+}
+
+EStringSearchLevel GetStringSearchLevel()
+{
+	return SearchLevel();
+}
+
+// Tokenizers mostly find the next byte within a few positions, where setting
+// up the vector registers costs more than it saves, so these are scanned first
+static const size_t SCALAR_PREFIX_LENGTH = 16;
+
+template<bool IN_SET>
+static size_t FindFirstInSet(const char *str, size_t length, const char *set, size_t setLength, size_t start)
+{
+	const unsigned char *s = (const unsigned char*)str;
+	SByteSet bits(set, setLength);
+#ifdef AS_STRING_SEARCH_X86
+	if (length - start > SCALAR_PREFIX_LENGTH)
+	{
+		for (size_t end = start + SCALAR_PREFIX_LENGTH; start < end; start++)
+			if (bits.Contains(s[start]) == IN_SET)
+				return start;
+	}
+	switch (SearchLevel())
+	{
+	case STRING_SEARCH_AVX2:
+		if (length - start >= 32)
+			return FindFirstInSetAvx2<IN_SET>(s, length, set, setLength, bits, start);
+		break;
+	case STRING_SEARCH_SSE2:
+		if (length - start >= 16 && setLength <= SSE2_SET_COMPARE_MAX)
+			return FindFirstInSetSse2<IN_SET>(s, length, set, setLength, bits, start);
+		break;
+	default:
+		break;
+	}
+#endif
+	return ScanFirst<IN_SET>(s, length, bits, start);
+}
+
+// `last` is the last position to look at
+template<bool IN_SET>
+static size_t FindLastInSet(const char *str, const char *set, size_t setLength, size_t last)
+{
+	const unsigned char *s = (const unsigned char*)str;
+	SByteSet bits(set, setLength);
+#ifdef AS_STRING_SEARCH_X86
+	if (last >= SCALAR_PREFIX_LENGTH)
+	{
+		for (size_t end = last - SCALAR_PREFIX_LENGTH; last > end; last--)
+			if (bits.Contains(s[last]) == IN_SET)
+				return last;
+	}
+	switch (SearchLevel())
+	{
+	case STRING_SEARCH_AVX2:
+		if (last >= 31)
+			return FindLastInSetAvx2<IN_SET>(s, set, setLength, bits, last);
+		break;
+	case STRING_SEARCH_SSE2:
+		if (last >= 15 && setLength <= SSE2_SET_COMPARE_MAX)
+			return FindLastInSetSse2<IN_SET>(s, set, setLength, bits, last);
+		break;
+	default:
+		break;
+	}
+#endif
+	return ScanLast<IN_SET>(s, bits, last);
+}
+
+size_t StringSearchFind(const char *str, size_t length, const char *sub, size_t subLength, size_t start)
+{
+	if (start > length)
+		return NPOS;
+	if (subLength == 0)
+		return start;
+	if (subLength > length - start)
+		return NPOS;
+	if (subLength == 1)
+	{
+		// The C library's memchr() is already vectorized
+		const void *found = memchr(str + start, sub[0], length - start);
+		return found ? (const char*)found - str : NPOS;
+	}
+
+#ifdef AS_STRING_SEARCH_X86
+	switch (SearchLevel())
+	{
+	case STRING_SEARCH_AVX2: return FindAvx2(str, length, sub, subLength, start);
+	case STRING_SEARCH_SSE2: return FindSse2(str, length, sub, subLength, start);
+	default: break;
+	}
+#endif
+	return string_view(str, length).find(string_view(sub, subLength), start);
+}
+
+size_t StringSearchFindLast(const char *str, size_t length, const char *sub, size_t subLength, size_t start)
+{
+	if (subLength > length)
+		return NPOS;
+	size_t last = length - subLength;
+	if (start < last)
+		last = start;
+	if (subLength == 0)
+		return last;
+
+#ifdef AS_STRING_SEARCH_X86
+	switch (SearchLevel())
+	{
+	case STRING_SEARCH_AVX2: return FindLastAvx2(str, length, sub, subLength, last);
+	case STRING_SEARCH_SSE2: return FindLastSse2(str, length, sub, subLength, last);
+	default: break;
+	}
+#endif
+	return string_view(str, length).rfind(string_view(sub, subLength), last);
+}
+
+size_t StringSearchFindFirstOf(const char *str, size_t length, const char *set, size_t setLength, size_t start)
+{
+	if (start >= length || setLength == 0)
+		return NPOS;
+	if (setLength == 1)
+	{
+		const void *found = memchr(str + start, set[0], length - start);
+		return found ? (const char*)found - str : NPOS;
+	}
+	return FindFirstInSet<true>(str, length, set, setLength, start);
+}
+
+size_t StringSearchFindFirstNotOf(const char *str, size_t length, const char *set, size_t setLength, size_t start)
+{
+	if (start >= length)
+		return NPOS;
+	if (setLength == 0)
+		return start;
+	return FindFirstInSet<false>(str, length, set, setLength, start);
+}
+
+size_t StringSearchFindLastOf(const char *str, size_t length, const char *set, size_t setLength, size_t start)
+{
+	if (length == 0 || setLength == 0)
+		return NPOS;
+	return FindLastInSet<true>(str, set, setLength, start < length - 1 ? start : length - 1);
+}
+
+size_t StringSearchFindLastNotOf(const char *str, size_t length, const char *set, size_t setLength, size_t start)
+{
+	if (length == 0)
+		return NPOS;
+	size_t last = start < length - 1 ? start : length - 1;
+	if (setLength == 0)
+		return last;
+	return FindLastInSet<false>(str, set, setLength, last);
+}
+
+END_AS_NAMESPACE
@@ -0,0 +1,58 @@
+//
+// String search
+//
+// The search functions behind the find family of the `string` add-on
+// (findFirst(), findLast(), findFirstOf(), findFirstNotOf(), findLastOf() and
+// findLastNotOf()). The results are the same as those of std::string::find(),
+// rfind(), find_first_of() etc, including npos when nothing is found.
+//
+// On x86 the haystack is scanned 16 (SSE2) or 32 (AVX2) bytes at a time, the
+// best level supported by the CPU is chosen at runtime. Substrings are found by
+// comparing their first and last byte at each position at once, and verifying
+// the candidates. Byte sets are turned into a bitmap, which AVX2 looks up for
+// whole blocks with nibble shuffles; SSE2 compares small sets byte by byte.
+// Other platforms use the scalar bitmap and std::string_view.
+//
+
+#ifndef SCRIPTSTRINGSEARCH_H
+#define SCRIPTSTRINGSEARCH_H
+
+#ifndef ANGELSCRIPT_H
+// Avoid having to inform include path if header is already include before
+#include <angelscript.h>
+#endif
+
+#include <stddef.h>
+
+BEGIN_AS_NAMESPACE
+
+enum EStringSearchLevel
+{
+	STRING_SEARCH_SCALAR = 0,
+	STRING_SEARCH_SSE2   = 1,
+	STRING_SEARCH_AVX2   = 2
+};
+
+// The highest level the CPU supports, which is used unless set otherwise
+EStringSearchLevel GetSupportedStringSearchLevel();
+
+// Selects the implementation, e.g. to compare them. Levels the CPU doesn't
+// support are lowered to the supported one. Not meant to be called while
+// other threads are searching.
+void               SetStringSearchLevel(EStringSearchLevel level);
+EStringSearchLevel GetStringSearchLevel();
+
+// Like std::string::find(sub, start)
+size_t StringSearchFind(const char *str, size_t length, const char *sub, size_t subLength, size_t start);
+// Like std::string::rfind(sub, start)
+size_t StringSearchFindLast(const char *str, size_t length, const char *sub, size_t subLength, size_t start);
+// Like std::string::find_first_of(set, start) and find_first_not_of(set, start)
+size_t StringSearchFindFirstOf(const char *str, size_t length, const char *set, size_t setLength, size_t start);
+size_t StringSearchFindFirstNotOf(const char *str, size_t length, const char *set, size_t setLength, size_t start);
+// Like std::string::find_last_of(set, start) and find_last_not_of(set, start)
+size_t StringSearchFindLastOf(const char *str, size_t length, const char *set, size_t setLength, size_t start);
+size_t StringSearchFindLastNotOf(const char *str, size_t length, const char *set, size_t setLength, size_t start);
+
+END_AS_NAMESPACE
+
+#endif
@@ -0,0 +1,272 @@
+#include "scriptstringslice.h"
+#include "scriptstdstring.h"
+#include "scriptstringsearch.h"
+#include <assert.h> // assert()
+#include <string.h> // memcmp()
+#include <new>      // placement new
+
+using namespace std;
+
+// This macro is used to avoid warnings about unused variables.
+// Usually where the variables are only used in debug mode.
+#define UNUSED_VAR(x) (void)(x)
+
+BEGIN_AS_NAMESPACE
+
+// Clamps `start` and `count` to `length` as string::substr() does
+static void ClampRange(asUINT length, asUINT &start, int count, asUINT &sliceLength)
+{
+	if( start >= length || count == 0 )
+	{
+		start = 0;
+		sliceLength = 0;
+		return;
+	}
+	sliceLength = length - start;
+	if( count > 0 && asUINT(count) < sliceLength )
+		sliceLength = asUINT(count);
+}
+
+CScriptStringSlice::CScriptStringSlice()
+	: m_start(0), m_length(0)
+{
+}
+
+CScriptStringSlice::CScriptStringSlice(const CImmutableString &parent, asUINT start, int count)
+	: m_parent(parent), m_start(start)
+{
+	ClampRange(m_parent.length(), m_start, count, m_length);
+}
+
+CScriptStringSlice::CScriptStringSlice(const string &parent, asUINT start, int count)
+	: m_start(start)
+{
+	ClampRange(asUINT(parent.length()), m_start, count, m_length);
+
+	// Only the characters of the slice are copied
+	m_parent = CImmutableString(parent.data() + m_start, m_length);
+	m_start = 0;
+}
+
+CScriptStringSlice CScriptStringSlice::Slice(asUINT start, int count) const
+{
+	CScriptStringSlice slice(*this);
+	ClampRange(m_length, start, count, slice.m_length);
+	slice.m_start = m_start + start;
+	return slice;
+}
+
+int CScriptStringSlice::Compare(const char *str, size_t length) const
+{
+	// The same order as std::string::compare()
+	int r = memcmp(data(), str, m_length < length ? m_length : length);
+	if( r != 0 )
+		return r < 0 ? -1 : 1;
+	if( m_length != length )
+		return m_length < length ? -1 : 1;
+	return 0;
+}
+
+//--------------------------------------------------------------------------
+// Script interface
+
+static int FindResult(size_t pos)
+{
+	return pos == string::npos ? -1 : int(pos);
+}
+
+static void ConstructStringSlice(CScriptStringSlice *thisPointer)
+{
+	new(thisPointer) CScriptStringSlice();
+}
+
+static void CopyConstructStringSlice(const CScriptStringSlice &other, CScriptStringSlice *thisPointer)
+{
+	new(thisPointer) CScriptStringSlice(other);
+}
+
+static void ConstructStringSliceFromString(const string &parent, CScriptStringSlice *thisPointer)
+{
+	new(thisPointer) CScriptStringSlice(parent);
+}
+
+static void ConstructStringSliceFromStringRange(const string &parent, asUINT start, int count, CScriptStringSlice *thisPointer)
+{
+	new(thisPointer) CScriptStringSlice(parent, start, count);
+}
+
+static void ConstructStringSliceFromImmutableString(const CImmutableString &parent, CScriptStringSlice *thisPointer)
+{
+	new(thisPointer) CScriptStringSlice(parent);
+}
+
+static void ConstructStringSliceFromImmutableStringRange(const CImmutableString &parent, asUINT start, int count, CScriptStringSlice *thisPointer)
+{
+	new(thisPointer) CScriptStringSlice(parent, start, count);
+}
+
+static void DestructStringSlice(CScriptStringSlice *thisPointer)
+{
+	thisPointer->~CScriptStringSlice();
+}
+
+static string StringSliceToString(const CScriptStringSlice &slice)
+{
+	return slice.str();
+}
+
+static bool StringSliceEquals(const CScriptStringSlice &a, const CScriptStringSlice &b)
+{
+	return a.length() == b.length() && memcmp(a.data(), b.data(), a.length()) == 0;
+}
+
+static bool StringSliceEqualsString(const CScriptStringSlice &a, const string &b)
+{
+	return a.length() == b.length() && memcmp(a.data(), b.data(), a.length()) == 0;
+}
+
+static int StringSliceCmp(const CScriptStringSlice &a, const CScriptStringSlice &b)
+{
+	return a.Compare(b.data(), b.length());
+}
+
+static int StringSliceCmpString(const CScriptStringSlice &a, const string &b)
+{
+	return a.Compare(b.data(), b.length());
+}
+
+static asUINT StringSliceLength(const CScriptStringSlice &slice)
+{
+	return slice.length();
+}
+
+static bool StringSliceIsEmpty(const CScriptStringSlice &slice)
+{
+	return slice.empty();
+}
+
+static const char *StringSliceCharAt(asUINT i, const CScriptStringSlice &slice)
+{
+	if( i >= slice.length() )
+	{
+		// Set a script exception
+		asIScriptContext *ctx = asGetActiveContext();
+		ctx->SetException("Out of range");
+
+		// Return a null pointer
+		return 0;
+	}
+
+	return slice.data() + i;
+}
+
+// AngelScript signature:
+// string_slice string_slice::substr(uint start = 0, int count = -1) const
+static CScriptStringSlice StringSliceSubString(asUINT start, int count, const CScriptStringSlice &slice)
+{
+	return slice.Slice(start, count);
+}
+
+static int StringSliceFindFirst(const string &sub, asUINT start, const CScriptStringSlice &slice)
+{
+	return FindResult(StringSearchFind(slice.data(), slice.length(), sub.data(), sub.length(), start));
+}
+
+static int StringSliceFindFirstOf(const string &sub, asUINT start, const CScriptStringSlice &slice)
+{
+	return FindResult(StringSearchFindFirstOf(slice.data(), slice.length(), sub.data(), sub.length(), start));
+}
+
+static int StringSliceFindFirstNotOf(const string &sub, asUINT start, const CScriptStringSlice &slice)
+{
+	return FindResult(StringSearchFindFirstNotOf(slice.data(), slice.length(), sub.data(), sub.length(), start));
+}
+
+static int StringSliceFindLast(const string &sub, int start, const CScriptStringSlice &slice)
+{
+	return FindResult(StringSearchFindLast(slice.data(), slice.length(), sub.data(), sub.length(), start < 0 ? string::npos : size_t(start)));
+}
+
+static int StringSliceFindLastOf(const string &sub, int start, const CScriptStringSlice &slice)
+{
+	return FindResult(StringSearchFindLastOf(slice.data(), slice.length(), sub.data(), sub.length(), start < 0 ? string::npos : size_t(start)));
+}
+
+static int StringSliceFindLastNotOf(const string &sub, int start, const CScriptStringSlice &slice)
+{
+	return FindResult(StringSearchFindLastNotOf(slice.data(), slice.length(), sub.data(), sub.length(), start < 0 ? string::npos : size_t(start)));
+}
+
+// AngelScript signature:
+// int64 parseInt(const string_slice &in val, uint base = 10, uint &out byteCount = 0)
+static asINT64 StringSliceParseInt(const CScriptStringSlice &val, asUINT base, asUINT *byteCount)
+{
+	return StringParseInt(val.data(), val.length(), base, byteCount);
+}
+
+// AngelScript signature:
+// uint64 parseUInt(const string_slice &in val, uint base = 10, uint &out byteCount = 0)
+static asQWORD StringSliceParseUInt(const CScriptStringSlice &val, asUINT base, asUINT *byteCount)
+{
+	return StringParseUInt(val.data(), val.length(), base, byteCount);
+}
+
+// AngelScript signature:
+// double parseFloat(const string_slice &in val, uint &out byteCount = 0)
+static double StringSliceParseFloat(const CScriptStringSlice &val, asUINT *byteCount)
+{
+	return StringParseFloat(val.data(), val.length(), byteCount);
+}
+
+void RegisterStringSlice(asIScriptEngine *engine)
+{
+	int r = 0;
+	UNUSED_VAR(r);
+
+	// The parent is shared between copies, so the object can be moved around freely
+	r = engine->RegisterObjectType("string_slice", sizeof(CScriptStringSlice), asOBJ_VALUE | asOBJ_APP_CLASS_CDAK); assert( r >= 0 );
+
+	r = engine->RegisterObjectBehaviour("string_slice", asBEHAVE_CONSTRUCT, "void f()", asFUNCTION(ConstructStringSlice), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectBehaviour("string_slice", asBEHAVE_CONSTRUCT, "void f(const string_slice &in)", asFUNCTION(CopyConstructStringSlice), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	// Also the implicit conversion, so functions taking a slice accept strings
+	r = engine->RegisterObjectBehaviour("string_slice", asBEHAVE_CONSTRUCT, "void f(const string &in)", asFUNCTION(ConstructStringSliceFromString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectBehaviour("string_slice", asBEHAVE_CONSTRUCT, "void f(const string &in, uint start, int count = -1)", asFUNCTION(ConstructStringSliceFromStringRange), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectBehaviour("string_slice", asBEHAVE_DESTRUCT, "void f()", asFUNCTION(DestructStringSlice), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+
+	if( engine->GetTypeInfoByName("istring") )
+	{
+		r = engine->RegisterObjectBehaviour("string_slice", asBEHAVE_CONSTRUCT, "void f(const istring &in)", asFUNCTION(ConstructStringSliceFromImmutableString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+		r = engine->RegisterObjectBehaviour("string_slice", asBEHAVE_CONSTRUCT, "void f(const istring &in, uint start, int count = -1)", asFUNCTION(ConstructStringSliceFromImmutableStringRange), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	}
+
+	r = engine->RegisterObjectMethod("string_slice", "string_slice &opAssign(const string_slice &in)", asMETHODPR(CScriptStringSlice, operator=, (const CScriptStringSlice &), CScriptStringSlice &), asCALL_THISCALL); assert( r >= 0 );
+
+	// Strings are compared without converting them to a slice first
+	r = engine->RegisterObjectMethod("string_slice", "bool opEquals(const string_slice &in) const", asFUNCTION(StringSliceEquals), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string_slice", "bool opEquals(const string &in) const", asFUNCTION(StringSliceEqualsString), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string_slice", "int opCmp(const string_slice &in) const", asFUNCTION(StringSliceCmp), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string_slice", "int opCmp(const string &in) const", asFUNCTION(StringSliceCmpString), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+
+	// The only ways to get a string, which copy the characters
+	r = engine->RegisterObjectMethod("string_slice", "string str() const", asFUNCTION(StringSliceToString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string_slice", "string opConv() const", asFUNCTION(StringSliceToString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+
+	r = engine->RegisterObjectMethod("string_slice", "uint length() const", asFUNCTION(StringSliceLength), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string_slice", "bool isEmpty() const", asFUNCTION(StringSliceIsEmpty), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string_slice", "const uint8 &opIndex(uint) const", asFUNCTION(StringSliceCharAt), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+
+	r = engine->RegisterObjectMethod("string_slice", "string_slice substr(uint start = 0, int count = -1) const", asFUNCTION(StringSliceSubString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string_slice", "int findFirst(const string &in, uint start = 0) const", asFUNCTION(StringSliceFindFirst), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string_slice", "int findFirstOf(const string &in, uint start = 0) const", asFUNCTION(StringSliceFindFirstOf), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string_slice", "int findFirstNotOf(const string &in, uint start = 0) const", asFUNCTION(StringSliceFindFirstNotOf), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string_slice", "int findLast(const string &in, int start = -1) const", asFUNCTION(StringSliceFindLast), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string_slice", "int findLastOf(const string &in, int start = -1) const", asFUNCTION(StringSliceFindLastOf), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("string_slice", "int findLastNotOf(const string &in, int start = -1) const", asFUNCTION(StringSliceFindLastNotOf), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+
+	// Overloads of the functions registered by RegisterStdString()
+	r = engine->RegisterGlobalFunction("int64 parseInt(const string_slice &in, uint base = 10, uint &out byteCount = 0)", asFUNCTION(StringSliceParseInt), asCALL_CDECL); assert( r >= 0 );
+	r = engine->RegisterGlobalFunction("uint64 parseUInt(const string_slice &in, uint base = 10, uint &out byteCount = 0)", asFUNCTION(StringSliceParseUInt), asCALL_CDECL); assert( r >= 0 );
+	r = engine->RegisterGlobalFunction("double parseFloat(const string_slice &in, uint &out byteCount = 0)", asFUNCTION(StringSliceParseFloat), asCALL_CDECL); assert( r >= 0 );
+}
+
+END_AS_NAMESPACE
@@ -0,0 +1,68 @@
+//
+// Script string slice
+//
+// `string_slice` is a value type for a range of characters of another string,
+// for parsing scripts that would otherwise call substr() in tight loops, with
+// a new string for every field. Taking a slice of a slice, copying it, and
+// comparing, searching or parsing numbers in it never allocates.
+//
+// A slice keeps its parent alive itself, so it stays valid when the script
+// string it was taken from is modified or goes out of scope. The characters
+// are kept in a CImmutableString: constructing a slice from a `string` copies
+// the string once (into the inline storage if it is short), and all slices
+// taken from that slice share the copy. Constructing a slice from an `istring`
+// shares its buffer without copying.
+//
+// string_slice line(text);          // Copies `text` once
+// string_slice key = line.substr(0, 3);
+// int64 value = parseInt(line.substr(4));
+// if (key == "abc") Print(key.str()); // Only str() creates a string
+//
+// Requires `string` from RegisterStdString(). If `istring` is registered
+// (RegisterImmutableString(engine)), slices can also be taken from it.
+//
+
+#ifndef SCRIPTSTRINGSLICE_H
+#define SCRIPTSTRINGSLICE_H
+
+#ifndef ANGELSCRIPT_H
+// Avoid having to inform include path if header is already include before
+#include <angelscript.h>
+#endif
+
+#include "scriptimmutablestring.h"
+
+#include <string>
+
+BEGIN_AS_NAMESPACE
+
+class CScriptStringSlice
+{
+public:
+	CScriptStringSlice();
+	// The range is clamped to the parent as string::substr() does
+	CScriptStringSlice(const CImmutableString &parent, asUINT start = 0, int count = -1);
+	CScriptStringSlice(const std::string &parent, asUINT start = 0, int count = -1);
+
+	const char *data() const { return m_parent.c_str() + m_start; }
+	asUINT      length() const { return m_length; }
+	bool        empty() const { return m_length == 0; }
+	std::string str() const { return std::string(data(), m_length); }
+
+	// A slice of this slice, clamped as string::substr() does
+	CScriptStringSlice Slice(asUINT start, int count) const;
+
+	int Compare(const char *str, size_t length) const;
+
+protected:
+	CImmutableString m_parent;
+	asUINT           m_start;
+	asUINT           m_length;
+};
+
+// Registers `string_slice` and the parseInt(), parseUInt() and parseFloat() overloads for it
+void RegisterStringSlice(asIScriptEngine *engine);
+
+END_AS_NAMESPACE
+
+#endif
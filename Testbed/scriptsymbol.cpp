@@ -0,0 +1,172 @@
+#include "scriptsymbol.h"
+#include "scriptstdstring.h"
+#include <assert.h> // assert()
+#include <stdint.h> // uintptr_t
+#include <string.h> // strlen()
+#include <new>      // placement new
+
+using namespace std;
+
+// This macro is used to avoid warnings about unused variables.
+// Usually where the variables are only used in debug mode.
+#define UNUSED_VAR(x) (void)(x)
+
+BEGIN_AS_NAMESPACE
+
+// Entries of the cache which were converted from themselves, i.e. script
+// literals. A string found here is an entry, so it needs no lookup. Per
+// thread, so the lookups need no lock.
+static thread_local CStdStringLiteralTable<bool> literalTable;
+
+CScriptSymbol::CScriptSymbol(const char *name)
+	: m_str(0)
+{
+	size_t length = strlen(name);
+	if( length )
+		m_str = InternStdString(name, asUINT(length));
+}
+
+CScriptSymbol::CScriptSymbol(const char *name, asUINT length)
+	: m_str(length ? InternStdString(name, length) : 0)
+{
+}
+
+CScriptSymbol::CScriptSymbol(const string &name)
+	: m_str(name.empty() ? 0 : InternStdString(name.data(), asUINT(name.length())))
+{
+}
+
+CScriptSymbol::CScriptSymbol(const CScriptSymbol &other)
+	: m_str(other.m_str)
+{
+	if( m_str )
+		AddRefInternedStdString(m_str);
+}
+
+CScriptSymbol::~CScriptSymbol()
+{
+	if( m_str )
+		ReleaseInternedStdString(m_str);
+}
+
+CScriptSymbol &CScriptSymbol::operator=(const CScriptSymbol &other)
+{
+	if( m_str != other.m_str )
+	{
+		if( other.m_str )
+			AddRefInternedStdString(other.m_str);
+		if( m_str )
+			ReleaseInternedStdString(m_str);
+		m_str = other.m_str;
+	}
+	return *this;
+}
+
+const string &CScriptSymbol::str() const
+{
+	static const string empty;
+	return m_str ? *m_str : empty;
+}
+
+size_t CScriptSymbol::Hash() const
+{
+	// The low bits of the address are the same for all entries
+	size_t h = size_t(uintptr_t(m_str)) >> 4;
+	return h ^ (h >> 16);
+}
+
+CScriptSymbol CScriptSymbol::FromString(const string &str)
+{
+	CScriptSymbol symbol;
+	if( str.empty() )
+		return symbol;
+
+	if( literalTable.Find(str) )
+	{
+		AddRefInternedStdString(&str);
+		symbol.m_str = &str;
+		return symbol;
+	}
+
+	symbol.m_str = InternStdString(str.data(), asUINT(str.length()));
+	if( symbol.m_str == &str )
+	{
+		// The string is the entry itself, so the next conversion can skip the lookup
+		literalTable.Insert(str);
+	}
+	return symbol;
+}
+
+//--------------------------------------------------------------------------
+// Script interface
+
+static void ConstructSymbol(CScriptSymbol *thisPointer)
+{
+	new(thisPointer) CScriptSymbol();
+}
+
+static void CopyConstructSymbol(const CScriptSymbol &other, CScriptSymbol *thisPointer)
+{
+	new(thisPointer) CScriptSymbol(other);
+}
+
+static void ConstructSymbolFromString(const string &str, CScriptSymbol *thisPointer)
+{
+	new(thisPointer) CScriptSymbol(CScriptSymbol::FromString(str));
+}
+
+static void DestructSymbol(CScriptSymbol *thisPointer)
+{
+	thisPointer->~CScriptSymbol();
+}
+
+static bool SymbolEquals(const CScriptSymbol &a, const CScriptSymbol &b)
+{
+	return a == b;
+}
+
+static string SymbolToString(const CScriptSymbol &symbol)
+{
+	return symbol.str();
+}
+
+static asUINT SymbolHash(const CScriptSymbol &symbol)
+{
+	return asUINT(symbol.Hash());
+}
+
+static asUINT SymbolLength(const CScriptSymbol &symbol)
+{
+	return asUINT(symbol.str().length());
+}
+
+static bool SymbolIsEmpty(const CScriptSymbol &symbol)
+{
+	return symbol.empty();
+}
+
+void RegisterScriptSymbol(asIScriptEngine *engine)
+{
+	int r = 0;
+	UNUSED_VAR(r);
+
+	r = engine->RegisterObjectType("symbol", sizeof(CScriptSymbol), asOBJ_VALUE | asOBJ_APP_CLASS_CDAK); assert( r >= 0 );
+
+	r = engine->RegisterObjectBehaviour("symbol", asBEHAVE_CONSTRUCT, "void f()", asFUNCTION(ConstructSymbol), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectBehaviour("symbol", asBEHAVE_CONSTRUCT, "void f(const symbol &in)", asFUNCTION(CopyConstructSymbol), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	// Also the implicit conversion from strings and string literals
+	r = engine->RegisterObjectBehaviour("symbol", asBEHAVE_CONSTRUCT, "void f(const string &in)", asFUNCTION(ConstructSymbolFromString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectBehaviour("symbol", asBEHAVE_DESTRUCT, "void f()", asFUNCTION(DestructSymbol), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+
+	r = engine->RegisterObjectMethod("symbol", "symbol &opAssign(const symbol &in)", asMETHODPR(CScriptSymbol, operator=, (const CScriptSymbol &), CScriptSymbol &), asCALL_THISCALL); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("symbol", "bool opEquals(const symbol &in) const", asFUNCTION(SymbolEquals), asCALL_CDECL_OBJFIRST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("symbol", "uint hash() const", asFUNCTION(SymbolHash), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+
+	// Explicit only, an implicit conversion would make `sym == "name"` ambiguous
+	r = engine->RegisterObjectMethod("symbol", "string str() const", asFUNCTION(SymbolToString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("symbol", "string opConv() const", asFUNCTION(SymbolToString), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("symbol", "uint length() const", asFUNCTION(SymbolLength), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = engine->RegisterObjectMethod("symbol", "bool isEmpty() const", asFUNCTION(SymbolIsEmpty), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+}
+
+END_AS_NAMESPACE
@@ -0,0 +1,74 @@
+//
+// Script symbol
+//
+// `symbol` is an interned string for identifiers such as event and state
+// names, which are compared far more often than they are created. A symbol
+// refers to an entry of the string constant cache of the `string` add-on,
+// so two symbols are equal exactly if they point to the same entry: equality
+// and hash() are pointer operations instead of byte-wise comparisons.
+//
+// Strings, and string literals in particular, convert to `symbol` implicitly.
+// Script literals are entries of the same cache already, so their conversion
+// only has to look up the characters the first time; after that it is a
+// lookup by address in a small per-thread table.
+//
+// void OnEvent(symbol name)
+// {
+//     if (name == "click") ... // Compares two pointers
+// }
+//
+// The application can intern known names once and compare the symbols it
+// gets from scripts against them:
+//
+// static const CScriptSymbol CLICK("click");
+// if (sym == CLICK) ...
+//
+// Requires `string` from RegisterStdString().
+//
+
+#ifndef SCRIPTSYMBOL_H
+#define SCRIPTSYMBOL_H
+
+#ifndef ANGELSCRIPT_H
+// Avoid having to inform include path if header is already include before
+#include <angelscript.h>
+#endif
+
+#include <string>
+#include <stddef.h>
+
+BEGIN_AS_NAMESPACE
+
+class CScriptSymbol
+{
+public:
+	CScriptSymbol() : m_str(0) {}
+	explicit CScriptSymbol(const char *name);
+	CScriptSymbol(const char *name, asUINT length);
+	explicit CScriptSymbol(const std::string &name);
+	CScriptSymbol(const CScriptSymbol &other);
+	~CScriptSymbol();
+
+	CScriptSymbol &operator=(const CScriptSymbol &other);
+
+	bool operator==(const CScriptSymbol &other) const { return m_str == other.m_str; }
+	bool operator!=(const CScriptSymbol &other) const { return m_str != other.m_str; }
+
+	// The interned string; the empty symbol doesn't hold an entry
+	const std::string &str() const;
+	bool               empty() const { return m_str == 0; }
+	size_t             Hash() const;
+
+	// Converts a string as the script conversion does, which is cheap for
+	// strings that are entries of the cache themselves, e.g. script literals
+	static CScriptSymbol FromString(const std::string &str);
+
+protected:
+	const std::string *m_str; // Entry of the string constant cache, or null if empty
+};
+
+void RegisterScriptSymbol(asIScriptEngine *engine);
+
+END_AS_NAMESPACE
+
+#endif
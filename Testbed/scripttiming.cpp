@@ -0,0 +1,306 @@
+#include "scripttiming.h"
+#include "scriptstdstring.h"
+#include <assert.h>  // assert()
+#include <algorithm> // std::sort()
+#include <chrono>    // std::chrono::steady_clock
+#include <iomanip>   // std::setw()
+#include <new>       // placement new
+
+using namespace std;
+
+// This macro is used to avoid warnings about unused variables.
+// Usually where the variables are only used in debug mode.
+#define UNUSED_VAR(x) (void)(x)
+
+BEGIN_AS_NAMESPACE
+
+//--------------------------------------------------------------------------
+// CScriptHistogram
+
+CScriptHistogram::CScriptHistogram()
+{
+	for (asUINT n = 0; n < BUCKET_COUNT; n++)
+		m_buckets[n] = 0;
+	m_count = 0;
+	m_sum = 0;
+	m_min = ~asQWORD(0);
+	m_max = 0;
+}
+
+asUINT CScriptHistogram::BucketIndex(asQWORD value)
+{
+	if (value < SUB_BUCKETS)
+		return asUINT(value);
+
+	// Position of the highest bit, at least 4
+	asUINT bit = 0;
+	for (asUINT step = 32; step > 0; step >>= 1)
+		if (value >> (bit + step))
+			bit += step;
+
+	// The 4 bits below the highest one pick the bucket within the power of two
+	asUINT shift = bit - 4;
+	return (shift + 1) * SUB_BUCKETS + asUINT(value >> shift) - SUB_BUCKETS;
+}
+
+asQWORD CScriptHistogram::BucketUpperBound(asUINT index)
+{
+	if (index < SUB_BUCKETS)
+		return index;
+
+	asUINT shift = index / SUB_BUCKETS - 1;
+	asQWORD top = SUB_BUCKETS + index % SUB_BUCKETS;
+	return ((top + 1) << shift) - 1;
+}
+
+void CScriptHistogram::Record(asQWORD value)
+{
+	m_buckets[BucketIndex(value)].fetch_add(1, memory_order_relaxed);
+	m_count.fetch_add(1, memory_order_relaxed);
+	m_sum.fetch_add(value, memory_order_relaxed);
+
+	// Usually no exchange at all once the extremes are known
+	asQWORD prev = m_min.load(memory_order_relaxed);
+	while (value < prev && !m_min.compare_exchange_weak(prev, value, memory_order_relaxed)) {}
+	prev = m_max.load(memory_order_relaxed);
+	while (value > prev && !m_max.compare_exchange_weak(prev, value, memory_order_relaxed)) {}
+}
+
+void CScriptHistogram::Reset()
+{
+	for (asUINT n = 0; n < BUCKET_COUNT; n++)
+		m_buckets[n].store(0, memory_order_relaxed);
+	m_count.store(0, memory_order_relaxed);
+	m_sum.store(0, memory_order_relaxed);
+	m_min.store(~asQWORD(0), memory_order_relaxed);
+	m_max.store(0, memory_order_relaxed);
+}
+
+asQWORD CScriptHistogram::GetMin() const
+{
+	asQWORD min = m_min.load(memory_order_relaxed);
+	return min == ~asQWORD(0) ? 0 : min;
+}
+
+asQWORD CScriptHistogram::GetPercentile(double percentile) const
+{
+	// Counted from the buckets rather than m_count, which concurrent records may have run ahead of
+	asQWORD total = 0;
+	for (asUINT n = 0; n < BUCKET_COUNT; n++)
+		total += m_buckets[n].load(memory_order_relaxed);
+	if (total == 0)
+		return 0;
+
+	asQWORD rank = asQWORD(percentile / 100.0 * double(total) + 0.5);
+	if (rank < 1)
+		rank = 1;
+	if (rank > total)
+		rank = total;
+
+	asQWORD seen = 0;
+	asUINT n = 0;
+	for (; n < BUCKET_COUNT - 1; n++)
+	{
+		seen += m_buckets[n].load(memory_order_relaxed);
+		if (seen >= rank)
+			break;
+	}
+
+	asQWORD value = BucketUpperBound(n);
+	asQWORD min = GetMin(), max = GetMax();
+	return value < min ? min : value > max ? max : value;
+}
+
+//--------------------------------------------------------------------------
+// CScriptScopedTimer
+
+CScriptScopedTimer::CScriptScopedTimer(CScriptHistogram *histogram)
+	: m_histogram(histogram)
+	, m_start(CScriptTiming::NowNs())
+{
+}
+
+CScriptScopedTimer::~CScriptScopedTimer()
+{
+	Stop();
+}
+
+asQWORD CScriptScopedTimer::ElapsedNs() const
+{
+	return CScriptTiming::NowNs() - m_start;
+}
+
+void CScriptScopedTimer::Stop()
+{
+	if (m_histogram)
+	{
+		m_histogram->Record(ElapsedNs());
+		m_histogram = 0;
+	}
+}
+
+static void DestructScopedTimer(CScriptScopedTimer *thisPointer)
+{
+	thisPointer->~CScriptScopedTimer();
+}
+
+//--------------------------------------------------------------------------
+// CScriptTiming
+
+// Never reused, so the per-thread lookup can't return a histogram of a destroyed instance
+static atomic<asUINT> nextTimingId(1);
+
+// A histogram of one CScriptTiming
+struct STimingLiteral
+{
+	asUINT            timingId;
+	CScriptHistogram *histogram;
+};
+
+// Histograms by the address of the string literal naming them. Per thread, so
+// the lookups need no lock.
+static thread_local CStdStringLiteralTable<STimingLiteral> timingLiterals;
+
+CScriptTiming::CScriptTiming(asIScriptEngine *engine)
+	: m_engine(engine)
+	, m_id(nextTimingId++)
+{
+}
+
+CScriptTiming::~CScriptTiming()
+{
+	lock_guard<mutex> lock(m_histogramsMutex);
+	for (map<string, CScriptHistogram*>::iterator it = m_histograms.begin(); it != m_histograms.end(); ++it)
+		delete it->second;
+	m_histograms.clear();
+}
+
+void CScriptTiming::RegisterInterface()
+{
+	int r = 0;
+	UNUSED_VAR(r);
+
+	r = m_engine->RegisterGlobalFunction("uint64 GetTimeNs()", asFUNCTION(CScriptTiming::NowNs), asCALL_CDECL); assert( r >= 0 );
+	r = m_engine->RegisterGlobalFunction("void RecordTiming(const string &in name, uint64 ns)", asMETHOD(CScriptTiming, RecordTiming), asCALL_THISCALL_ASGLOBAL, this); assert( r >= 0 );
+
+	// No copy constructor or opAssign, so a timer can't be copied and record twice
+	r = m_engine->RegisterObjectType("ScopedTimer", sizeof(CScriptScopedTimer), asOBJ_VALUE | asOBJ_APP_CLASS_CD); assert( r >= 0 );
+	r = m_engine->RegisterObjectBehaviour("ScopedTimer", asBEHAVE_CONSTRUCT, "void f(const string &in name)", asMETHOD(CScriptTiming, ConstructTimer), asCALL_THISCALL_OBJLAST, this); assert( r >= 0 );
+	r = m_engine->RegisterObjectBehaviour("ScopedTimer", asBEHAVE_DESTRUCT, "void f()", asFUNCTION(DestructScopedTimer), asCALL_CDECL_OBJLAST); assert( r >= 0 );
+	r = m_engine->RegisterObjectMethod("ScopedTimer", "uint64 elapsedNs() const", asMETHOD(CScriptScopedTimer, ElapsedNs), asCALL_THISCALL); assert( r >= 0 );
+	r = m_engine->RegisterObjectMethod("ScopedTimer", "void stop()", asMETHOD(CScriptScopedTimer, Stop), asCALL_THISCALL); assert( r >= 0 );
+}
+
+asQWORD CScriptTiming::NowNs()
+{
+	return asQWORD(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+CScriptHistogram *CScriptTiming::GetHistogram(const string &name)
+{
+	lock_guard<mutex> lock(m_histogramsMutex);
+	CScriptHistogram *&histogram = m_histograms[name];
+	if (histogram == 0)
+		histogram = new CScriptHistogram();
+	return histogram;
+}
+
+CScriptHistogram *CScriptTiming::GetHistogramForScript(const string &name)
+{
+	STimingLiteral *literal = timingLiterals.Find(name);
+	if (literal && literal->timingId == m_id)
+		return literal->histogram;
+
+	CScriptHistogram *histogram = GetHistogram(name);
+
+	// If the name is a literal, the next lookup can be by address
+	literal = timingLiterals.Insert(name);
+	if (literal)
+	{
+		literal->timingId = m_id;
+		literal->histogram = histogram;
+	}
+
+	return histogram;
+}
+
+void CScriptTiming::ConstructTimer(const string &name, CScriptScopedTimer *thisPointer)
+{
+	new(thisPointer) CScriptScopedTimer(GetHistogramForScript(name));
+}
+
+void CScriptTiming::RecordTiming(const string &name, asQWORD ns)
+{
+	GetHistogramForScript(name)->Record(ns);
+}
+
+static bool TimingSummaryMoreTime(const SScriptTimingSummary &a, const SScriptTimingSummary &b)
+{
+	return a.totalNs > b.totalNs;
+}
+
+vector<SScriptTimingSummary> CScriptTiming::GetSummaries() const
+{
+	vector<SScriptTimingSummary> result;
+
+	lock_guard<mutex> lock(m_histogramsMutex);
+	for (map<string, CScriptHistogram*>::const_iterator it = m_histograms.begin(); it != m_histograms.end(); ++it)
+	{
+		const CScriptHistogram *histogram = it->second;
+		if (histogram->GetCount() == 0)
+			continue;
+
+		SScriptTimingSummary summary;
+		summary.name = it->first;
+		summary.count = histogram->GetCount();
+		summary.totalNs = histogram->GetSum();
+		summary.minNs = histogram->GetMin();
+		summary.p50Ns = histogram->GetPercentile(50);
+		summary.p90Ns = histogram->GetPercentile(90);
+		summary.p99Ns = histogram->GetPercentile(99);
+		summary.p999Ns = histogram->GetPercentile(99.9);
+		summary.maxNs = histogram->GetMax();
+		result.push_back(summary);
+	}
+
+	sort(result.begin(), result.end(), TimingSummaryMoreTime);
+	return result;
+}
+
+void CScriptTiming::WriteSummaries(ostream &out) const
+{
+	vector<SScriptTimingSummary> summaries = GetSummaries();
+
+	size_t nameWidth = 4;
+	for (size_t n = 0; n < summaries.size(); n++)
+		nameWidth = max(nameWidth, summaries[n].name.length());
+
+	ios_base::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << fixed << setprecision(1);
+
+	out << left << setw(int(nameWidth)) << "name" << right
+		<< setw(10) << "count" << setw(12) << "total ms"
+		<< setw(10) << "min us" << setw(10) << "p50 us" << setw(10) << "p90 us"
+		<< setw(10) << "p99 us" << setw(10) << "p99.9 us" << setw(10) << "max us" << "\n";
+	for (size_t n = 0; n < summaries.size(); n++)
+	{
+		const SScriptTimingSummary &s = summaries[n];
+		out << left << setw(int(nameWidth)) << s.name << right
+			<< setw(10) << s.count << setw(12) << double(s.totalNs) / 1e6
+			<< setw(10) << double(s.minNs) / 1e3 << setw(10) << double(s.p50Ns) / 1e3 << setw(10) << double(s.p90Ns) / 1e3
+			<< setw(10) << double(s.p99Ns) / 1e3 << setw(10) << double(s.p999Ns) / 1e3 << setw(10) << double(s.maxNs) / 1e3 << "\n";
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void CScriptTiming::Reset()
+{
+	lock_guard<mutex> lock(m_histogramsMutex);
+	for (map<string, CScriptHistogram*>::iterator it = m_histograms.begin(); it != m_histograms.end(); ++it)
+		it->second->Reset();
+}
+
+END_AS_NAMESPACE
@@ -0,0 +1,151 @@
+//
+// Script timing
+//
+// A monotonic nanosecond clock for scripts, and named histograms that scripts
+// record durations into, for profiling the hot paths of a script in production.
+// GetSystemTime() in Testbed's main.cpp is a millisecond wall clock, which is
+// too coarse for anything but whole frames.
+//
+// Script interface:
+//
+//   uint64 GetTimeNs()                             - monotonic clock, in nanoseconds
+//   void RecordTiming(const string &in name, uint64 ns) - records a duration measured by the script
+//   ScopedTimer(const string &in name)             - records the time until it goes out of scope
+//   uint64 ScopedTimer::elapsedNs() const
+//   void ScopedTimer::stop()                       - records now instead, e.g. before a return
+//
+//   void Update()
+//   {
+//       ScopedTimer t("Update");
+//       ...
+//   }
+//
+// Timers can't be copied, so each records once. The histogram is found by name
+// when the timer is created; for string literals the lookup is by address in a
+// small per-thread table after the first time, other names take a lock.
+//
+// Histograms are log-linear, 16 buckets per power of two, so percentiles are
+// accurate to about 6%. Recording is a few relaxed atomic adds, from any thread.
+// The application reads the summaries with GetSummaries() or WriteSummaries().
+//
+
+#ifndef SCRIPTTIMING_H
+#define SCRIPTTIMING_H
+
+#ifndef ANGELSCRIPT_H
+// Avoid having to inform include path if header is already include before
+#include <angelscript.h>
+#endif
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+BEGIN_AS_NAMESPACE
+
+class CScriptHistogram
+{
+public:
+	// Values below 16 have a bucket each, then 16 buckets per power of two up to 2^64
+	static const asUINT SUB_BUCKETS = 16;
+	static const asUINT BUCKET_COUNT = 61 * SUB_BUCKETS;
+
+	CScriptHistogram();
+
+	void Record(asQWORD value);
+	void Reset();
+
+	asQWORD GetCount() const { return m_count.load(std::memory_order_relaxed); }
+	asQWORD GetSum() const   { return m_sum.load(std::memory_order_relaxed); }
+	asQWORD GetMin() const;
+	asQWORD GetMax() const   { return m_max.load(std::memory_order_relaxed); }
+
+	// `percentile` from 0 to 100; the upper bound of the bucket, clamped to min/max
+	asQWORD GetPercentile(double percentile) const;
+
+	static asUINT  BucketIndex(asQWORD value);
+	static asQWORD BucketUpperBound(asUINT index);
+
+protected:
+	std::atomic<asQWORD> m_buckets[BUCKET_COUNT];
+	std::atomic<asQWORD> m_count;
+	std::atomic<asQWORD> m_sum;
+	std::atomic<asQWORD> m_min;
+	std::atomic<asQWORD> m_max;
+};
+
+struct SScriptTimingSummary
+{
+	std::string name;
+	asQWORD     count;
+	asQWORD     totalNs;
+	asQWORD     minNs;
+	asQWORD     p50Ns;
+	asQWORD     p90Ns;
+	asQWORD     p99Ns;
+	asQWORD     p999Ns;
+	asQWORD     maxNs;
+};
+
+// The script side of ScopedTimer
+class CScriptScopedTimer
+{
+public:
+	CScriptScopedTimer(CScriptHistogram *histogram);
+	~CScriptScopedTimer();
+
+	asQWORD ElapsedNs() const;
+	void    Stop();
+
+protected:
+	CScriptHistogram *m_histogram; // Null once stopped
+	asQWORD           m_start;
+
+private:
+	CScriptScopedTimer(const CScriptScopedTimer &);
+	CScriptScopedTimer &operator=(const CScriptScopedTimer &);
+};
+
+class CScriptTiming
+{
+public:
+	CScriptTiming(asIScriptEngine *engine);
+	~CScriptTiming();
+
+	// Registers the script interface described at the top of this file.
+	void RegisterInterface();
+
+	// Monotonic, in nanoseconds from an arbitrary point
+	static asQWORD NowNs();
+
+	// Created on first use; stays valid until the CScriptTiming is destroyed
+	CScriptHistogram *GetHistogram(const std::string &name);
+
+	// Sorted by total time, highest first. Histograms without records are left out.
+	std::vector<SScriptTimingSummary> GetSummaries() const;
+	// A table of the summaries, in microseconds
+	void WriteSummaries(std::ostream &out) const;
+	// Clears the records; the histograms stay
+	void Reset();
+
+protected:
+	CScriptHistogram *GetHistogramForScript(const std::string &name);
+
+	// Script interface
+	void ConstructTimer(const std::string &name, CScriptScopedTimer *thisPointer);
+	void RecordTiming(const std::string &name, asQWORD ns);
+
+	asIScriptEngine                           *m_engine;
+	asUINT                                     m_id; // Identifies this instance in the per-thread lookup
+
+	// Guards the map, not the histograms
+	mutable std::mutex                         m_histogramsMutex;
+	std::map<std::string, CScriptHistogram*>   m_histograms;
+};
+
+END_AS_NAMESPACE
+
+#endif